@@ -0,0 +1,71 @@
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include "crosstime.h"
+#endif
+
+#define BENCH_NUM_POSITIONS 7
+
+/**
+ * @breif The standard perft positions shared by all of the benchmarks.
+ */
+extern const char *const BENCH_POSITIONS[BENCH_NUM_POSITIONS];
+
+/**
+ * @breif Depths and node counts for the quick perft suite.
+ */
+extern const int BENCH_SHORT_DEPTHS[BENCH_NUM_POSITIONS];
+extern const uint64_t BENCH_SHORT_RESULTS[BENCH_NUM_POSITIONS];
+
+/**
+ * @breif Depths and node counts for the full perft suite.
+ */
+extern const int BENCH_FULL_DEPTHS[BENCH_NUM_POSITIONS];
+extern const uint64_t BENCH_FULL_RESULTS[BENCH_NUM_POSITIONS];
+
+/**
+ * @breif Sink for benchmark results so that the compiler cannot discard the work.
+ */
+extern volatile uint64_t bench_sink;
+
+/**
+ * @breif Pins the calling thread to a single cpu.
+ * @param cpu The cpu to pin to, or a negative number to stay on the current cpu.
+ * @return The cpu that the thread was pinned to, or -1 if pinning is not supported.
+ */
+int bench_pin_thread(int cpu);
+
+/**
+ * @breif Tells the compiler that the memory at p is read and written by something it can't see.
+ */
+static inline void bench_escape(const void *p)
+{
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
+
+/**
+ * @breif Reads a serialized cycle counter.
+ *
+ * Uses the time stamp counter fenced on both sides where it is available and falls back to
+ * nanoseconds from crosstime.h elsewhere.
+ */
+static inline uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t tsc;
+    _mm_lfence();
+    tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+#else
+    return time_ns();
+#endif
+}
+
+#endif /* BENCH_H */
@@ -15,6 +15,7 @@ extern const uint16_t HIST_ENP_AVAILABLE;
 extern const uint16_t HIST_ENP_ALL;
 extern const uint16_t HIST_HALFMOVE_CLOCK;
 extern const uint16_t HIST_HALFMOVE_FIFTY;
+extern const uint16_t HIST_CASTLE_KEEP[64];
 
 extern const uint8_t M_WHITE_KING_START;
 extern const uint8_t M_WHITE_KING_SIDE_ROOK_START;
@@ -69,6 +70,7 @@ extern const uint16_t CB_MV_FROM_MASK;
 extern const uint16_t CB_MV_FLAG_MASK;
 
 extern const cb_move_t CB_INVALID_MOVE;
+extern const cb_move_t CB_NULL_MOVE;
 extern const cb_hist_ele_t CB_INIT_STATE;
 
 # endif /* CB_CONST */
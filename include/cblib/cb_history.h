@@ -19,18 +19,21 @@
  */
 
 /**
- * Sets the size of *hist to hist->count + CB_STACK_INIT_SIZE elements.
+ * Grows *hist to at least hist->count + added_depth elements, with CB_STACK_INIT_SIZE to spare.
  */
 static inline int cb_hist_stack_reserve(cb_hist_stack_t *hist, uint32_t added_depth)
 {
+    cb_hist_ele_t *data;
+    int size;
+
     if (hist->count + added_depth < hist->size)
         return 0;
 
-    hist->data = (cb_hist_ele_t *)realloc(hist->data,
-            (hist->count + added_depth) * sizeof(cb_hist_ele_t));
-    if (hist->data == NULL)
+    size = hist->count + added_depth + CB_STACK_INIT_SIZE;
+    if ((data = (cb_hist_ele_t *)realloc(hist->data, size * sizeof(cb_hist_ele_t))) == NULL)
         return ENOMEM;
-    hist->size += CB_STACK_INIT_SIZE;
+    hist->data = data;
+    hist->size = size;
     return 0;
 }
 
@@ -188,7 +191,7 @@ static inline cb_ptype_t cb_hist_get_captured_piece(cb_history_t *hist)
  */
 static inline bool cb_hist_halfmove_clk_done(cb_history_t hist)
 {
-    return (hist & HIST_HALFMOVE_CLOCK) == HIST_HALFMOVE_FIFTY;
+    return (hist & HIST_HALFMOVE_CLOCK) >= HIST_HALFMOVE_FIFTY;
 }
 
 /**
@@ -200,11 +203,20 @@ static inline void cb_hist_reset_halfmove_clk(cb_history_t *hist)
 }
 
 /**
- * Increments the halfmove clock.
+ * Increments the halfmove clock. It stops at its largest value rather than wrapping to zero.
  */
 static inline void cb_hist_inc_halfmove_clk(cb_history_t *hist)
 {
-    *hist += UINT16_C(1) << 8;
+    if ((*hist & HIST_HALFMOVE_CLOCK) != HIST_HALFMOVE_CLOCK)
+        *hist += UINT16_C(1) << 8;
+}
+
+/**
+ * Returns the number of halfmoves since the last capture or pawn move.
+ */
+static inline int cb_hist_halfmove_clk(cb_history_t hist)
+{
+    return (hist & HIST_HALFMOVE_CLOCK) >> 8;
 }
 
 static inline void cb_hist_set_halfmove_clk(cb_history_t *hist, uint16_t val)
@@ -214,24 +226,13 @@ static inline void cb_hist_set_halfmove_clk(cb_history_t *hist, uint16_t val)
 }
 
 /**
- * Decays castle rights after a move.
+ * Decays castle rights after a move. Moving from or capturing on a king or rook start square
+ * clears the rights that depend on it.
  */
 static inline void cb_hist_decay_castle_rights(cb_history_t *hist, uint8_t color,
         uint8_t to, uint8_t from)
 {
-    /* Remove castling rights for moving a king or rook. */
-    *hist &= from == M_WHITE_KING_START ? ~UINT16_C(0b1100) : 0xFFFF;
-    *hist &= from == M_BLACK_KING_START ? ~UINT16_C(  0b11) : 0xFFFF;
-    *hist &= from == M_WHITE_KING_SIDE_ROOK_START ? ~UINT16_C(0b1000) : 0xFFFF;
-    *hist &= from == M_BLACK_KING_SIDE_ROOK_START ? ~UINT16_C(  0b10) : 0xFFFF;
-    *hist &= from == M_WHITE_QUEEN_SIDE_ROOK_START ? ~UINT16_C(0b100) : 0xFFFF;
-    *hist &= from == M_BLACK_QUEEN_SIDE_ROOK_START ? ~UINT16_C(  0b1) : 0xFFFF;
-
-    /* Remove castling rights for taking a rook. */
-    *hist &= to == M_WHITE_KING_SIDE_ROOK_START ? ~UINT16_C(0b1000) : 0xFFFF;
-    *hist &= to == M_BLACK_KING_SIDE_ROOK_START ? ~UINT16_C(  0b10) : 0xFFFF;
-    *hist &= to == M_WHITE_QUEEN_SIDE_ROOK_START ? ~UINT16_C(0b100) : 0xFFFF;
-    *hist &= to == M_BLACK_QUEEN_SIDE_ROOK_START ? ~UINT16_C(  0b1) : 0xFFFF;
+    *hist &= HIST_CASTLE_KEEP[from] & HIST_CASTLE_KEEP[to];
 }
 
 #endif /* CB_HISTORY_H */
@@ -24,6 +24,49 @@ cb_errno_t cb_board_init(cb_error_t *err, cb_board_t *board);
  */
 cb_errno_t cb_tables_init(cb_error_t *err);
 
+/**
+ * @breif Makes one copy of the move generation tables on every NUMA node.
+ *
+ * Called by cb_tables_init when the library is built with CB_NUMA_TABLES. On hosts with a
+ * single node no copies are made and every thread keeps reading the master copy. Copies that
+ * cannot be bound to their node with mbind are left where the kernel first touches them. Must
+ * be called after the tables are initialized and while no other thread reads a copy.
+ *
+ * @param err A pointer that will be populated with any errors.
+ * @param nodes The number of copies to make, or zero to make one per online node.
+ * @return The error code corresponding to the error in err.
+ */
+cb_errno_t cb_tables_replicate(cb_error_t *err, int nodes);
+
+/**
+ * @breif Points the table lookups of the calling thread at the copy on its NUMA node.
+ *
+ * The node is the one the thread is running on when this is called, so threads should be
+ * pinned first. Falls back to the master copy if the tables were not replicated.
+ *
+ * @return The node whose copy the thread now reads, or -1 for the master copy.
+ */
+int cb_tables_bind_thread();
+
+/**
+ * @breif Points the table lookups of the calling thread at the copy on a given node.
+ * @param node The node, or -1 for the master copy.
+ * @return The node whose copy the thread now reads, or -1 for the master copy.
+ */
+int cb_tables_bind_node(int node);
+
+/**
+ * @breif Returns the number of NUMA nodes the tables were replicated to, or zero if they were
+ * not replicated.
+ */
+int cb_tables_num_copies();
+
+/**
+ * @breif Returns true if the copy of a node was placed on that node by mbind. Copies that were
+ * not are wherever the kernel's first touch policy put them.
+ */
+bool cb_tables_copy_bound(int node);
+
 /**
  * @breif Frees a board. Note that this does not clean up move generation tables.
  * @param board A pointer to the board to be freed.
@@ -112,6 +155,68 @@ void cb_gen_board_tables(cb_state_tables_t *state, cb_board_t *board);
  */
 void cb_gen_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state);
 
+/**
+ * @breif Finds the squares from which the side to move would give check.
+ *
+ * Holds the direct check squares of each piece type and the friendly pieces that uncover a
+ * check from a slider behind them when they move off its line.
+ *
+ * @param info The check info to populate.
+ * @param board The board in question.
+ */
+void cb_gen_check_info(cb_check_info_t *info, cb_board_t *board);
+
+/**
+ * @breif Generates the moves that quiescence search looks at.
+ *
+ * Emits every capture, enpassant and promotion. With quiet_checks set it also emits the quiet
+ * moves that give check, found from the check info of the position rather than by making the
+ * moves. In check only the matching evasions are emitted.
+ *
+ * @param mvlst The movelist structure to populate.
+ * @param board The board to generate moves on.
+ * @param state The state table to reference for move generation.
+ * @param quiet_checks Also emit the quiet moves that give check.
+ */
+void cb_gen_noisy_and_checks(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state,
+                             bool quiet_checks);
+
+/**
+ * @breif Generates the reduced state table used by pseudo-legal move generation.
+ *
+ * Much cheaper than cb_gen_board_tables as the squares threatened by the opponent and the pin
+ * rays are never built. Only the checkers and the pinned pieces are found.
+ *
+ * @param pstate The state table structure to populate.
+ * @param board The board in question.
+ */
+void cb_gen_pseudo_tables(cb_pseudo_tables_t *pstate, cb_board_t *board);
+
+/**
+ * @breif Generates pseudo-legal moves.
+ *
+ * The list may contain moves that leave the king in check. Every move must be passed through
+ * cb_is_legal before it is made. Castles are only generated when the king is not in check.
+ *
+ * @param mvlst The movelist structure to populate.
+ * @param board The board to generate moves on.
+ * @param pstate The state table to reference for move generation.
+ */
+void cb_gen_pseudo_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_pseudo_tables_t *pstate);
+
+/**
+ * @breif Tests if a pseudo-legal move leaves the king of the side to move safe.
+ *
+ * Only king moves, castles and enpassant look at the attacks on the board. Every other move is
+ * resolved from the checkers and pinned pieces in pstate.
+ *
+ * @param board The board the move was generated on.
+ * @param pstate The state table the move was generated with.
+ * @param mv The pseudo-legal move to test.
+ * @return True if the move is legal.
+ */
+bool cb_is_legal(cb_board_t *board, cb_pseudo_tables_t *pstate, cb_move_t mv);
+
 /**
  * @breif Reserves space on the history stack to make at least added_depth moves.
  * @param err A pointer that will be populated with any errors.
@@ -145,4 +250,20 @@ void cb_make(cb_board_t *board, const cb_move_t mv);
  */
 void cb_unmake(cb_board_t *board);
 
+/**
+ * @breif Passes the turn without moving a piece.
+ *
+ * Pushes CB_NULL_MOVE onto the history stack with the enpassant square cleared and the halfmove
+ * clock reset. The same reservation rules as cb_make apply. Must not be called while in check.
+ *
+ * @param board The board to pass on.
+ */
+void cb_make_null(cb_board_t *board);
+
+/**
+ * @breif Takes back a move made with cb_make_null.
+ * @param board The board to take it back on.
+ */
+void cb_unmake_null(cb_board_t *board);
+
 #endif /* CBLIB_H */
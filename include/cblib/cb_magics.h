@@ -0,0 +1,414 @@
+
+/* Generated by tools/magicgen -t 1000000 -r 1 -s 0x2545f4914f6cdd1d. Do not edit. */
+
+#ifndef CB_MAGICS_H
+#define CB_MAGICS_H
+
+#include <stdint.h>
+
+/* Number of entries in the table shared by every square of both pieces. */
+#define CB_MAGIC_TABLE_LEN 106925
+
+static const uint64_t ROOK_MAGICS[64] = {
+    UINT64_C(0x0980048040002010),
+    UINT64_C(0x1280102000804000),
+    UINT64_C(0x0280100008200084),
+    UINT64_C(0x0080049002180080),
+    UINT64_C(0x018002080080a400),
+    UINT64_C(0x0900050044000248),
+    UINT64_C(0x0400054806240010),
+    UINT64_C(0x2280015420800500),
+    UINT64_C(0x0041002080004902),
+    UINT64_C(0x0084008102004402),
+    UINT64_C(0x0005002009000641),
+    UINT64_C(0x1901002100100248),
+    UINT64_C(0x3002002620020010),
+    UINT64_C(0x0200808044000200),
+    UINT64_C(0x4404000411d00088),
+    UINT64_C(0x900200006c020015),
+    UINT64_C(0x0040008000238044),
+    UINT64_C(0x048081004004a102),
+    UINT64_C(0x4800910040200100),
+    UINT64_C(0x1108008019801000),
+    UINT64_C(0x0100808008008400),
+    UINT64_C(0x8000808004000200),
+    UINT64_C(0x0001140010012812),
+    UINT64_C(0x0200120000448401),
+    UINT64_C(0x488e882280004000),
+    UINT64_C(0x0a00200040100040),
+    UINT64_C(0x0000200880100180),
+    UINT64_C(0x1450008280080010),
+    UINT64_C(0x1440040080480080),
+    UINT64_C(0x0081000b00082c00),
+    UINT64_C(0x0001004100120084),
+    UINT64_C(0x4002010a00005094),
+    UINT64_C(0x0000080038100260),
+    UINT64_C(0x0020001000400048),
+    UINT64_C(0x18c1820022004130),
+    UINT64_C(0x000052000a0020c0),
+    UINT64_C(0x4840021101001800),
+    UINT64_C(0x1000680101000400),
+    UINT64_C(0x0122000502002c08),
+    UINT64_C(0x2252000848100100),
+    UINT64_C(0x00000888c0108000),
+    UINT64_C(0x0c01008040010020),
+    UINT64_C(0x8043002000410010),
+    UINT64_C(0x0008900023010008),
+    UINT64_C(0x0069080001010010),
+    UINT64_C(0x4104000100090004),
+    UINT64_C(0x1200100088840002),
+    UINT64_C(0x0100002100620004),
+    UINT64_C(0x4000182045208200),
+    UINT64_C(0x00000208c0019570),
+    UINT64_C(0x0400020840156200),
+    UINT64_C(0x0096000222101a00),
+    UINT64_C(0x0888000104a90100),
+    UINT64_C(0x0014000100058300),
+    UINT64_C(0x0400080081910c00),
+    UINT64_C(0x06000020d04c0600),
+    UINT64_C(0x20800000402a1491),
+    UINT64_C(0x2400090022008412),
+    UINT64_C(0x0100010a0049c922),
+    UINT64_C(0x440001000a100015),
+    UINT64_C(0x01c200012002904a),
+    UINT64_C(0x4481000204000801),
+    UINT64_C(0x0010000420160185),
+    UINT64_C(0x1010000900241046)
+};
+
+static const uint8_t ROOK_SHIFTS[64] = {
+    52,
+    53,
+    53,
+    53,
+    53,
+    53,
+    53,
+    52,
+    53,
+    54,
+    54,
+    54,
+    54,
+    54,
+    54,
+    53,
+    53,
+    54,
+    54,
+    54,
+    54,
+    54,
+    54,
+    53,
+    53,
+    54,
+    54,
+    54,
+    54,
+    54,
+    54,
+    53,
+    53,
+    54,
+    54,
+    54,
+    54,
+    54,
+    54,
+    53,
+    53,
+    54,
+    54,
+    54,
+    54,
+    54,
+    54,
+    53,
+    53,
+    54,
+    54,
+    54,
+    54,
+    54,
+    54,
+    53,
+    52,
+    53,
+    53,
+    53,
+    53,
+    53,
+    53,
+    52
+};
+
+static const int32_t ROOK_OFFSETS[64] = {
+    0,
+    16366,
+    18414,
+    20462,
+    22510,
+    24558,
+    26605,
+    4096,
+    28653,
+    65473,
+    66496,
+    67520,
+    68543,
+    69567,
+    70590,
+    30700,
+    32748,
+    71614,
+    72638,
+    73662,
+    74686,
+    75710,
+    76734,
+    34796,
+    36844,
+    77758,
+    78782,
+    79806,
+    80830,
+    81854,
+    82878,
+    38892,
+    40939,
+    83902,
+    84926,
+    85950,
+    86974,
+    87997,
+    89021,
+    42987,
+    45032,
+    90045,
+    91069,
+    92093,
+    93117,
+    94137,
+    95160,
+    47079,
+    49113,
+    96165,
+    97176,
+    98197,
+    99218,
+    100238,
+    101261,
+    51159,
+    8186,
+    53204,
+    55243,
+    57287,
+    59335,
+    61380,
+    63426,
+    12271
+};
+
+static const uint64_t BISHOP_MAGICS[64] = {
+    UINT64_C(0x0804082894200840),
+    UINT64_C(0x0003094111400501),
+    UINT64_C(0x00442090a0080888),
+    UINT64_C(0x1a02820a00002000),
+    UINT64_C(0x8021868104000a20),
+    UINT64_C(0x404d8145017008c0),
+    UINT64_C(0x01210082d4000200),
+    UINT64_C(0x0410120209040140),
+    UINT64_C(0x000011024214300c),
+    UINT64_C(0x00e1201240810013),
+    UINT64_C(0x00000c00c1841008),
+    UINT64_C(0x1040038102004100),
+    UINT64_C(0x1220018602300488),
+    UINT64_C(0x090810a218020802),
+    UINT64_C(0x8004004132488044),
+    UINT64_C(0x00500080440280c0),
+    UINT64_C(0x4048010604804480),
+    UINT64_C(0x0210001821214004),
+    UINT64_C(0x0050000804801804),
+    UINT64_C(0x0408000c14200400),
+    UINT64_C(0x4001000820404000),
+    UINT64_C(0x0440800410140030),
+    UINT64_C(0x8a84000041050143),
+    UINT64_C(0x0092000061301200),
+    UINT64_C(0x10200c2221030049),
+    UINT64_C(0x080820006b840044),
+    UINT64_C(0x002090014814c00c),
+    UINT64_C(0x8004040000c01080),
+    UINT64_C(0x0204040001410048),
+    UINT64_C(0x0008006000300040),
+    UINT64_C(0x2000406004019604),
+    UINT64_C(0x0181806180380800),
+    UINT64_C(0x9220902494400800),
+    UINT64_C(0x480a090c80032090),
+    UINT64_C(0x0280081200040400),
+    UINT64_C(0x2000c00809008200),
+    UINT64_C(0x0012048400020020),
+    UINT64_C(0x0010100480510884),
+    UINT64_C(0x1000c94100060812),
+    UINT64_C(0x42000c6204008201),
+    UINT64_C(0x2310080816000801),
+    UINT64_C(0x0140068282840c00),
+    UINT64_C(0x1008041808300400),
+    UINT64_C(0x4000010040e11800),
+    UINT64_C(0x1002943004082180),
+    UINT64_C(0x0403100020300200),
+    UINT64_C(0x0000211230a00401),
+    UINT64_C(0x0000849904488100),
+    UINT64_C(0x4100008290900900),
+    UINT64_C(0x0300084424040300),
+    UINT64_C(0x0000000491442810),
+    UINT64_C(0x100002241c480008),
+    UINT64_C(0x200422822061804a),
+    UINT64_C(0x0b0001058c40c101),
+    UINT64_C(0x0181488800888a10),
+    UINT64_C(0x2000e42480484a10),
+    UINT64_C(0xc284010042024004),
+    UINT64_C(0x22022008530c0444),
+    UINT64_C(0x4810122011128820),
+    UINT64_C(0x44008002144011b8),
+    UINT64_C(0x00200011010ca280),
+    UINT64_C(0x0000022c00c280a2),
+    UINT64_C(0x5084810484152049),
+    UINT64_C(0x01002c408808c422)
+};
+
+static const uint8_t BISHOP_SHIFTS[64] = {
+    58,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    58,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    57,
+    57,
+    57,
+    57,
+    59,
+    59,
+    59,
+    59,
+    57,
+    55,
+    55,
+    57,
+    59,
+    59,
+    59,
+    59,
+    57,
+    55,
+    55,
+    57,
+    59,
+    59,
+    59,
+    59,
+    57,
+    57,
+    57,
+    57,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    58,
+    59,
+    59,
+    59,
+    59,
+    59,
+    59,
+    58
+};
+
+static const int32_t BISHOP_OFFSETS[64] = {
+    105826,
+    96321,
+    106033,
+    106063,
+    96495,
+    96839,
+    96664,
+    105874,
+    97000,
+    106087,
+    106111,
+    106143,
+    106171,
+    106192,
+    106215,
+    106230,
+    106261,
+    106283,
+    104331,
+    104458,
+    104579,
+    104706,
+    106310,
+    106336,
+    106368,
+    43064,
+    104833,
+    102284,
+    102796,
+    104953,
+    106398,
+    106422,
+    43194,
+    106454,
+    105081,
+    103308,
+    103820,
+    105208,
+    106482,
+    43321,
+    106507,
+    106527,
+    105335,
+    105460,
+    105587,
+    105713,
+    106552,
+    106577,
+    106602,
+    106611,
+    106637,
+    106669,
+    106699,
+    106720,
+    106736,
+    106758,
+    105937,
+    106781,
+    106807,
+    106829,
+    106853,
+    106874,
+    106903,
+    105975
+};
+
+#endif /* CB_MAGICS_H */
@@ -0,0 +1,153 @@
+
+#ifndef CB_POOL_H
+#define CB_POOL_H
+
+#include <stdint.h>
+
+#include "cb_types.h"
+
+/**
+ * @breif Many boards stored field by field in contiguous arrays indexed by a game id.
+ *
+ * Each bitboard of every game sits next to the same bitboard of the other games, so a pass over
+ * one field of all games (the keys, the turns, the occupancy) walks memory in order and can be
+ * vectorized. The history stacks live in one slab with a fixed number of slots per game in place
+ * of one heap allocation per board.
+ *
+ * Quiet moves and captures are made in place. Move generation and the rarer moves work on a
+ * cb_board_t gathered from the arrays, see cb_pool_view and cb_pool_sync.
+ */
+typedef struct {
+    uint64_t *color[2];         /**< color[c][id] as in cb_bitboard_t. */
+    uint64_t *piece[2][6];      /**< piece[c][ptype][id] as in cb_bitboard_t. */
+    uint64_t *occ;              /**< occ[id] as in cb_bitboard_t. */
+    cb_mailbox_t *mb;           /**< mb[id] is the mailbox of a game. */
+    cb_hist_ele_t *hist;        /**< hist_len slots per game, starting at hist[id * hist_len]. */
+    uint32_t *hist_count;       /**< The number of full history slots of each game. */
+    uint32_t *fullmove_num;     /**< The fullmove number of each game. */
+    uint8_t *turn;              /**< The side to move of each game. */
+    uint32_t count;             /**< The number of games. */
+    uint32_t hist_len;          /**< The number of history slots per game. */
+    void *mem;                  /**< The single allocation backing every array above. */
+} cb_pool_t;
+
+/**
+ * @breif Allocates a pool. Every game starts out empty and must be loaded before use.
+ * @param err A pointer that will be populated with any errors.
+ * @param pool The pool to initialize.
+ * @param count The number of games.
+ * @param hist_len The number of history slots per game. Bounds the plies a game can hold.
+ * @return The error code corresponding to the error in err.
+ */
+cb_errno_t cb_pool_init(cb_error_t *err, cb_pool_t *pool, uint32_t count, uint32_t hist_len);
+
+/**
+ * @breif Frees a pool.
+ */
+void cb_pool_free(cb_pool_t *pool);
+
+/**
+ * @breif Copies a board into a game of the pool, history included.
+ * @param err A pointer that will be populated with any errors.
+ * @param pool The pool to write to.
+ * @param id The game to overwrite.
+ * @param board The board to copy.
+ * @return The error code corresponding to the error in err.
+ */
+cb_errno_t cb_pool_load(cb_error_t *err, cb_pool_t *pool, uint32_t id, const cb_board_t *board);
+
+/**
+ * @breif Copies a game of the pool out into an initialized board, history included.
+ * @param err A pointer that will be populated with any errors.
+ * @param board The board to write to.
+ * @param pool The pool to read from.
+ * @param id The game to copy.
+ * @return The error code corresponding to the error in err.
+ */
+cb_errno_t cb_pool_store(cb_error_t *err, cb_board_t *board, const cb_pool_t *pool,
+                         uint32_t id);
+
+/**
+ * @breif Gathers a game into a board that the rest of cblib can work on.
+ *
+ * The view shares its history stack with the pool, so it must not be freed or reserved past
+ * hist_len. Changes to the pieces or the turn only reach the pool through cb_pool_sync.
+ *
+ * @param view The board to fill.
+ * @param pool The pool to read from.
+ * @param id The game to gather.
+ */
+static inline void cb_pool_view(cb_board_t *view, const cb_pool_t *pool, uint32_t id)
+{
+    int color, ptype;
+
+    for (color = 0; color < 2; color++) {
+        view->bb.color[color] = pool->color[color][id];
+        for (ptype = 0; ptype < 6; ptype++)
+            view->bb.piece[color][ptype] = pool->piece[color][ptype][id];
+    }
+    view->bb.occ = pool->occ[id];
+    view->mb = pool->mb[id];
+    view->hist.data = pool->hist + (size_t)id * pool->hist_len;
+    view->hist.count = pool->hist_count[id];
+    view->hist.size = pool->hist_len;
+    view->turn = pool->turn[id];
+    view->fullmove_num = pool->fullmove_num[id];
+}
+
+/**
+ * @breif Scatters a view made by cb_pool_view back into its game.
+ */
+static inline void cb_pool_sync(cb_pool_t *pool, uint32_t id, const cb_board_t *view)
+{
+    int color, ptype;
+
+    for (color = 0; color < 2; color++) {
+        pool->color[color][id] = view->bb.color[color];
+        for (ptype = 0; ptype < 6; ptype++)
+            pool->piece[color][ptype][id] = view->bb.piece[color][ptype];
+    }
+    pool->occ[id] = view->bb.occ;
+    pool->mb[id] = view->mb;
+    pool->hist_count[id] = view->hist.count;
+    pool->turn[id] = view->turn;
+    pool->fullmove_num[id] = view->fullmove_num;
+}
+
+/**
+ * @breif Returns the zobrist key of the current position of a game.
+ */
+static inline uint64_t cb_pool_key(const cb_pool_t *pool, uint32_t id)
+{
+    return pool->hist[(size_t)id * pool->hist_len + pool->hist_count[id] - 1].key;
+}
+
+/**
+ * @breif Makes a move on a game. The game must have a free history slot.
+ */
+void cb_pool_make(cb_pool_t *pool, uint32_t id, cb_move_t mv);
+
+/**
+ * @breif Unmakes the last move of a game.
+ */
+void cb_pool_unmake(cb_pool_t *pool, uint32_t id);
+
+/**
+ * @breif Generates the legal moves of a game.
+ * @param mvlst The movelist structure to populate.
+ * @param pool The pool to read from.
+ * @param id The game to generate moves for.
+ */
+void cb_pool_gen_moves(cb_mvlst_t *mvlst, cb_pool_t *pool, uint32_t id);
+
+/**
+ * @breif Makes one move on every game of the pool.
+ *
+ * Games are stepped in id order so the arrays are walked front to back.
+ *
+ * @param pool The pool to step.
+ * @param mvs The move for each game, or CB_INVALID_MOVE to leave a game alone.
+ */
+void cb_pool_step(cb_pool_t *pool, const cb_move_t *mvs);
+
+#endif /* CB_POOL_H */
@@ -2,6 +2,7 @@
 #ifndef CB_TABLES_H
 #define CB_TABLES_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "cb_types.h"
@@ -46,6 +47,19 @@ extern const int8_t dir_offset_mapping[8];
  */
 uint8_t cb_get_ray_direction(uint8_t sq1, uint8_t sq2);
 
+/**
+ * @breif Name of the sliding attack backend that the library was built with.
+ *
+ * The backend is picked at configure time. "magic" uses the magic bitboard tables and
+ * "tableless" computes the attacks from a few KB of line masks (CB_TABLELESS_SLIDERS).
+ */
+extern const char *const CB_SLIDER_BACKEND;
+
+/**
+ * @breif Size in bytes of the sliding attack tables of the backend.
+ */
+extern const size_t CB_SLIDER_TABLE_BYTES;
+
 /**
  * @breif Initializes the magical tables
  * @return An int containing the error code for any errors that occured.
@@ -62,6 +76,42 @@ void cb_init_normal_tables();
  */
 void cb_free_magic_tables();
 
+/*
+ * Every lookup below reads the tables through a thread local pointer that starts out on the
+ * master copy. cb_tables_bind_thread points it at a copy on the local NUMA node instead.
+ */
+
+/**
+ * @breif Size in bytes of the pawn, knight, king and to-from tables.
+ */
+extern const size_t CB_NORMAL_TABLE_BYTES;
+
+/**
+ * @breif Returns the master copy of the normal tables, CB_NORMAL_TABLE_BYTES long.
+ */
+const void *cb_normal_tables_master();
+
+/**
+ * @breif Points the lookups of the calling thread at a copy of the normal tables.
+ */
+void cb_use_normal_tables(const void *tables);
+
+/**
+ * @breif Returns the master copy of the sliding attack tables, CB_SLIDER_TABLE_BYTES long.
+ */
+const void *cb_slider_tables_master();
+
+/**
+ * @breif Points the lookups of the calling thread at a copy of the sliding attack tables.
+ */
+void cb_use_slider_tables(const void *tables);
+
+/**
+ * @breif Frees the per node copies made by cb_tables_replicate and moves the calling thread
+ * back to the master copy. Other threads must not be using a copy.
+ */
+void cb_tables_free_copies();
+
 /* Functions to perform reads on the magical tables. */
 
 /**
@@ -103,6 +103,7 @@ typedef uint16_t cb_history_t;
 typedef struct {
     cb_history_t hist;      /**< The history state at a given position. */
     cb_move_t move;         /**< The last move played at a given position. */
+    uint64_t key;           /**< The zobrist key of the position. */
 } cb_hist_ele_t;
 
 /**
@@ -124,6 +125,28 @@ typedef struct {
     uint64_t pins[10];      /**< A set of bitmasks for all active pin rays. */
 } cb_state_tables_t;
 
+/**
+ * @breif Reduced state table for pseudo-legal move generation.
+ *
+ * Only holds what cb_is_legal needs to reject the moves that leave the king in check.
+ */
+typedef struct {
+    uint64_t checks;        /**< A bitmask for all pieces that check the king. */
+    uint64_t pinned;        /**< A bitmask for all friendly pieces pinned to the king. */
+    uint8_t king_sq;        /**< The square of the king of the side to move. */
+} cb_pseudo_tables_t;
+
+/**
+ * @breif The squares from which the side to move gives check.
+ *
+ * Built once per node by cb_gen_check_info for generators that only want checking moves.
+ */
+typedef struct {
+    uint64_t check_sqs[6];  /**< Direct check squares indexed by cb_ptype_t. */
+    uint64_t discoverers;   /**< Friendly pieces that uncover a check when they leave the line. */
+    uint8_t king_sq;        /**< The square of the enemy king. */
+} cb_check_info_t;
+
 /**
  * @breif Bitboard data structure that actually stores peice data.
  *
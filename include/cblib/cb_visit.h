@@ -0,0 +1,648 @@
+
+#ifndef CB_VISIT_H
+#define CB_VISIT_H
+
+/*
+ * Visitor style legal move generation.
+ *
+ * Instead of filling a cb_mvlst_t, every generated move is handed straight to a visitor. The
+ * visitor returns true to stop the generation early, e.g. on a beta cutoff. Everything in here is
+ * forced inline, so when the visitor is a function known at compile time the compiler folds its
+ * body into the generation loops and no move list is ever written.
+ *
+ * cb_gen_moves is itself a thin wrapper that visits with a push onto a move list.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "cb_types.h"
+#include "cb_board.h"
+#include "cb_tables.h"
+#include "cb_const.h"
+#include "cb_move.h"
+#include "cb_bitutil.h"
+#include "cb_history.h"
+
+#define CB_VISIT_INLINE static inline __attribute__((always_inline))
+
+/* Hands a move to the visitor and stops the generation if the visitor asks for it. */
+#define CB_VISIT(visit, ctx, mv)            \
+    do {                                    \
+        if ((visit)((ctx), (mv)))           \
+            return true;                    \
+    } while (0)
+
+/**
+ * @breif Called once per generated move.
+ * @param ctx The context pointer that was passed to the generator.
+ * @param mv The generated move.
+ * @return True to stop generating moves.
+ */
+typedef bool (*cb_visitor_t)(void *ctx, cb_move_t mv);
+
+CB_VISIT_INLINE uint64_t cb_pawn_smear(uint64_t pawns, cb_color_t color)
+{
+    return color == CB_WHITE ?
+        (pawns >> 9 & ~BB_RIGHT_COL) | (pawns >> 7 & ~BB_LEFT_COL) :
+        (pawns << 7 & ~BB_RIGHT_COL) | (pawns << 9 & ~BB_LEFT_COL);
+}
+
+CB_VISIT_INLINE uint64_t cb_pawn_smear_left(uint64_t pawns, cb_color_t color)
+{
+    return color == CB_WHITE ?
+        (pawns >> 9 & ~BB_RIGHT_COL) :
+        (pawns << 9 & ~BB_LEFT_COL);
+}
+
+CB_VISIT_INLINE uint64_t cb_pawn_smear_forward(uint64_t pawns, cb_color_t color)
+{
+    return color == CB_WHITE ? pawns >> 8 : pawns << 8;
+}
+
+CB_VISIT_INLINE uint64_t cb_pawn_smear_right(uint64_t pawns, cb_color_t color)
+{
+    return color == CB_WHITE ?
+        (pawns >> 7 & ~BB_LEFT_COL) :
+        (pawns << 7 & ~BB_RIGHT_COL);
+}
+
+/**
+ * Visits one move per target square, from the square at target + offset.
+ */
+CB_VISIT_INLINE bool cb_visit_targets(cb_visitor_t visit, void *ctx, uint64_t targets,
+                                      int8_t offset, cb_mv_flag_t flags)
+{
+    uint8_t target;
+
+    while (targets != 0) {
+        target = pop_rbit(&targets);
+        CB_VISIT(visit, ctx, cb_mv_from_data(target + offset, target, flags));
+    }
+
+    return false;
+}
+
+/**
+ * Visits all four promotions per target square, from the square at target + offset.
+ */
+CB_VISIT_INLINE bool cb_visit_promos(cb_visitor_t visit, void *ctx, uint64_t targets,
+                                     int8_t offset, cb_mv_flag_t capture)
+{
+    uint8_t target;
+    uint8_t sq;
+
+    while (targets != 0) {
+        target = pop_rbit(&targets);
+        sq = target + offset;
+        CB_VISIT(visit, ctx, cb_mv_from_data(sq, target, CB_MV_KNIGHT_PROMO | capture));
+        CB_VISIT(visit, ctx, cb_mv_from_data(sq, target, CB_MV_BISHOP_PROMO | capture));
+        CB_VISIT(visit, ctx, cb_mv_from_data(sq, target, CB_MV_ROOK_PROMO | capture));
+        CB_VISIT(visit, ctx, cb_mv_from_data(sq, target, CB_MV_QUEEN_PROMO | capture));
+    }
+
+    return false;
+}
+
+/**
+ * @breif The target squares of every kind of legal pawn move.
+ */
+typedef struct {
+    uint64_t forward;           /**< Single pushes that do not promote. */
+    uint64_t doubles;           /**< Double pushes. */
+    uint64_t left;              /**< Left captures that do not promote. */
+    uint64_t right;             /**< Right captures that do not promote. */
+    uint64_t forward_promos;    /**< Single pushes that promote. */
+    uint64_t left_promos;       /**< Left captures that promote. */
+    uint64_t right_promos;      /**< Right captures that promote. */
+} cb_pawn_targets_t;
+
+CB_VISIT_INLINE void cb_pawn_targets(cb_pawn_targets_t *t, cb_board_t *board,
+                                     cb_state_tables_t *state)
+{
+    /* Get the mask of pawns that we want to evaluate. */
+    uint64_t pawns = board->bb.piece[board->turn][CB_PTYPE_PAWN];
+
+    /* Remove all of the pinned pawns and add back those that lie on a left ray. */
+    uint64_t left_pin_mask = state->pins[CB_DIR_DR] | state->pins[CB_DIR_UL];
+    uint64_t left_pawns = (pawns & ~state->pins[8]) | (pawns & left_pin_mask);
+
+    /* Remove all of the pinned pawns and add back those that lie on a forward ray. */
+    uint64_t forward_pin_mask = state->pins[CB_DIR_D] | state->pins[CB_DIR_U];
+    uint64_t forward_pawns = (pawns & ~state->pins[8]) | (pawns & forward_pin_mask);
+
+    /* Remove all of the pinned pawns and add back those that lie on a right ray. */
+    uint64_t right_pin_mask = state->pins[CB_DIR_DL] | state->pins[CB_DIR_UR];
+    uint64_t right_pawns = (pawns & ~state->pins[8]) | (pawns & right_pin_mask);
+
+    /* Generate masks for pawns moving left and right. */
+    uint64_t left_smear = cb_pawn_smear_left(left_pawns, board->turn);
+    uint64_t left_attacks = left_smear & board->bb.color[!board->turn];
+    uint64_t right_smear = cb_pawn_smear_right(right_pawns, board->turn);
+    uint64_t right_attacks = right_smear & board->bb.color[!board->turn];
+
+    /* Generate masks for pushing pawns. */
+    uint64_t forward_smear = cb_pawn_smear_forward(forward_pawns, board->turn);
+    uint64_t forward_moves = forward_smear & ~board->bb.occ;
+
+    /* Smear the forward moves again to get the double pushes. */
+    uint64_t double_smear = cb_pawn_smear_forward(forward_moves, board->turn);
+    uint64_t double_moves = double_smear & ~board->bb.occ;
+    double_moves &= board->turn == CB_WHITE ? BB_WHITE_PAWN_LINE : BB_BLACK_PAWN_LINE;
+
+    /* Adjust for checks. */
+    left_attacks &= state->check_blocks;
+    right_attacks &= state->check_blocks;
+    forward_moves &= state->check_blocks;
+    double_moves &= state->check_blocks;
+
+    /* Select the moves that cuase a promotion. */
+    t->left_promos = left_attacks & (BB_TOP_ROW | BB_BOTTOM_ROW);
+    t->left = left_attacks ^ t->left_promos;
+    t->right_promos = right_attacks & (BB_TOP_ROW | BB_BOTTOM_ROW);
+    t->right = right_attacks ^ t->right_promos;
+    t->forward_promos = forward_moves & (BB_TOP_ROW | BB_BOTTOM_ROW);
+    t->forward = forward_moves ^ t->forward_promos;
+    t->doubles = double_moves;
+}
+
+/**
+ * Turns the pawn target masks into moves.
+ */
+CB_VISIT_INLINE bool cb_visit_pawn_targets(cb_board_t *board, cb_pawn_targets_t *t,
+                                           cb_visitor_t visit, void *ctx)
+{
+    int8_t dir = board->turn == CB_WHITE ? 1 : -1;
+
+    return cb_visit_targets(visit, ctx, t->forward, 8 * dir, CB_MV_QUIET)
+        || cb_visit_targets(visit, ctx, t->doubles, 16 * dir, CB_MV_DOUBLE_PAWN_PUSH)
+        || cb_visit_targets(visit, ctx, t->left, 9 * dir, CB_MV_CAPTURE)
+        || cb_visit_targets(visit, ctx, t->right, 7 * dir, CB_MV_CAPTURE)
+        || cb_visit_promos(visit, ctx, t->forward_promos, 8 * dir, CB_MV_QUIET)
+        || cb_visit_promos(visit, ctx, t->left_promos, 9 * dir, CB_MV_CAPTURE)
+        || cb_visit_promos(visit, ctx, t->right_promos, 7 * dir, CB_MV_CAPTURE);
+}
+
+CB_VISIT_INLINE bool cb_visit_pawn_moves(cb_board_t *board, cb_state_tables_t *state,
+                                         cb_visitor_t visit, void *ctx)
+{
+    cb_pawn_targets_t t;
+
+    cb_pawn_targets(&t, board, state);
+    return cb_visit_pawn_targets(board, &t, visit, ctx);
+}
+
+CB_VISIT_INLINE uint64_t cb_pseudo_mv_mask(cb_ptype_t ptype, cb_color_t pcolor, uint8_t sq,
+                                           uint64_t occ)
+{
+    switch (ptype) {
+        case CB_PTYPE_PAWN:
+            return cb_read_pawn_atk_msk(sq, pcolor);
+        case CB_PTYPE_KNIGHT:
+            return cb_read_knight_atk_msk(sq);
+        case CB_PTYPE_BISHOP:
+            return cb_read_bishop_atk_msk(sq, occ);
+        case CB_PTYPE_ROOK:
+            return cb_read_rook_atk_msk(sq, occ);
+        case CB_PTYPE_QUEEN:
+            return cb_read_bishop_atk_msk(sq, occ)
+                | cb_read_rook_atk_msk(sq, occ);
+        case CB_PTYPE_KING:
+            return cb_read_king_atk_msk(sq);
+        case CB_PTYPE_EMPTY:
+            assert(false && "invalid piece type for pseudo legal move generation");
+            return 0;
+    }
+    return 0;
+}
+
+CB_VISIT_INLINE uint64_t cb_pin_adjust(cb_board_t *board, cb_state_tables_t *state, uint8_t sq,
+                                       uint64_t moves)
+{
+    uint8_t king_sq = peek_rbit(board->bb.piece[board->turn][CB_PTYPE_KING]);
+    uint8_t dir = cb_get_ray_direction(king_sq, sq);
+    return (state->pins[dir] & (UINT64_C(1) << sq)) == 0 ? moves : (moves & state->pins[dir]);
+}
+
+CB_VISIT_INLINE uint64_t cb_legal_mv_mask(cb_board_t *board, cb_state_tables_t *state,
+                                          uint8_t sq)
+{
+    /* Generate the pseudo moves. */
+    cb_ptype_t ptype = cb_ptype_at_sq(board, sq);
+    cb_color_t pcolor = cb_color_at_sq(board, sq);
+    uint64_t moves = cb_pseudo_mv_mask(ptype, pcolor, sq, board->bb.occ);
+    moves &= ~board->bb.color[board->turn];
+
+    /* Adjust moves for pins and checks. */
+    moves &= ptype == CB_PTYPE_KING ? ~state->threats : state->check_blocks;
+    moves = cb_pin_adjust(board, state, sq, moves);
+
+    return moves;
+}
+
+/**
+ * Visits the moves of one piece, flagging the ones that land on an occupied square as captures.
+ */
+CB_VISIT_INLINE bool cb_visit_mask(cb_board_t *board, uint8_t sq, uint64_t mvmsk,
+                                   cb_visitor_t visit, void *ctx)
+{
+    uint8_t target;
+    cb_mv_flag_t flags;
+
+    while (mvmsk) {
+        target = pop_rbit(&mvmsk);
+        flags = (UINT64_C(1) << target) & board->bb.occ ? CB_MV_CAPTURE : CB_MV_QUIET;
+        CB_VISIT(visit, ctx, cb_mv_from_data(sq, target, flags));
+    }
+
+    return false;
+}
+
+CB_VISIT_INLINE bool cb_visit_simple_moves(cb_board_t *board, cb_state_tables_t *state,
+                                           cb_visitor_t visit, void *ctx)
+{
+    uint8_t sq;
+    uint64_t pieces = board->bb.color[board->turn];
+
+    /* Visit the moves of every piece but the pawns. */
+    pieces ^= board->bb.piece[board->turn][CB_PTYPE_PAWN];
+    while (pieces) {
+        sq = pop_rbit(&pieces);
+        if (cb_visit_mask(board, sq, cb_legal_mv_mask(board, state, sq), visit, ctx))
+            return true;
+    }
+
+    return false;
+}
+
+CB_VISIT_INLINE bool cb_ksc_legal(cb_board_t *board, cb_state_tables_t *state)
+{
+    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
+    uint64_t occ_mask = board->turn == CB_WHITE ? BB_WHITE_KING_SIDE_CASTLE_OCCUPANCY :
+        BB_BLACK_KING_SIDE_CASTLE_OCCUPANCY;
+    uint64_t check_mask = board->turn == CB_WHITE ? BB_WHITE_KING_SIDE_CASTLE_CHECK :
+        BB_BLACK_KING_SIDE_CASTLE_CHECK;
+
+    /* If the occupancy intersects occ_mask or the threats intersect ckeck_mask. No castling. */
+    return ((board->bb.occ & occ_mask) | (state->threats & check_mask)) == 0
+        && cb_hist_has_ksc(hist, board->turn);
+}
+
+CB_VISIT_INLINE bool cb_qsc_legal(cb_board_t *board, cb_state_tables_t *state)
+{
+    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
+    uint64_t occ_mask = board->turn == CB_WHITE ? BB_WHITE_QUEEN_SIDE_CASTLE_OCCUPANCY :
+        BB_BLACK_QUEEN_SIDE_CASTLE_OCCUPANCY;
+    uint64_t check_mask = board->turn == CB_WHITE ? BB_WHITE_QUEEN_SIDE_CASTLE_CHECK :
+        BB_BLACK_QUEEN_SIDE_CASTLE_CHECK;
+
+    /* If the occupancy intersects occ_mask or the threats intersect ckeck_mask. No castling. */
+    return ((board->bb.occ & occ_mask) | (state->threats & check_mask)) == 0
+        && cb_hist_has_qsc(hist, board->turn);
+}
+
+CB_VISIT_INLINE bool cb_visit_castle_moves(cb_board_t *board, cb_state_tables_t *state,
+                                           cb_visitor_t visit, void *ctx)
+{
+    uint8_t from = board->turn == CB_WHITE ? M_WHITE_KING_START : M_BLACK_KING_START;
+    uint8_t to;
+
+    if (cb_ksc_legal(board, state)) {
+        to = board->turn == CB_WHITE ? M_WHITE_KING_SIDE_CASTLE_TARGET :
+            M_BLACK_KING_SIDE_CASTLE_TARGET;
+        CB_VISIT(visit, ctx, cb_mv_from_data(from, to, CB_MV_KING_SIDE_CASTLE));
+    }
+
+    if (cb_qsc_legal(board, state)) {
+        to = board->turn == CB_WHITE ? M_WHITE_QUEEN_SIDE_CASTLE_TARGET :
+            M_BLACK_QUEEN_SIDE_CASTLE_TARGET;
+        CB_VISIT(visit, ctx, cb_mv_from_data(from, to, CB_MV_QUEEN_SIDE_CASTLE));
+    }
+
+    return false;
+}
+
+CB_VISIT_INLINE bool cb_visit_enp_moves(cb_board_t *board, cb_state_tables_t *state,
+                                        cb_visitor_t visit, void *ctx)
+{
+    /* Takes the state tables only to match the other visitors. */
+    (void)state;
+
+    /* Exit early if there is not availiable enpassant. */
+    if (!cb_hist_enp_availiable(board->hist.data[board->hist.count - 1].hist))
+        return false;
+
+    /* Get the swares relavent to the piece that can enpassant. */
+    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
+    uint8_t enp_row_start = board->turn == CB_WHITE ? M_BLACK_MIN_ENPASSANT_TARGET :
+        M_WHITE_MIN_ENPASSANT_TARGET;
+    uint8_t enp_sq = enp_row_start + cb_hist_enp_col(hist);
+    uint8_t enemy_sq = enp_sq + (board->turn == CB_WHITE ? 8 : -8);
+
+    /* Get all of the pieces that can enpassnt. */
+    uint64_t enp_sources = cb_read_pawn_atk_msk(enp_sq, !board->turn)
+        & board->bb.piece[board->turn][CB_PTYPE_PAWN];
+
+    /* Loop through the pieces that can enpassant and generate the moves. */
+    uint8_t sq, king_sq;
+    uint64_t new_occ, bishop_threats, rook_threats;
+    while (enp_sources) {
+        sq = pop_rbit(&enp_sources);
+
+        /* Update the occupancy mask to what it will be after the move takes place. */
+        new_occ = board->bb.occ;
+        new_occ &= ~(UINT64_C(1) << sq);
+        new_occ &= ~(UINT64_C(1) << enemy_sq);
+        new_occ |= UINT64_C(1) << enp_sq;
+
+        /* Check if the king is in check after the move is made.
+         * This could be the case if some piece was pinned before the enpassant was made. */
+        king_sq = peek_rbit(board->bb.piece[board->turn][CB_PTYPE_KING]);
+
+        bishop_threats = cb_read_bishop_atk_msk(king_sq, new_occ)
+            & (board->bb.piece[!board->turn][CB_PTYPE_BISHOP]
+                | board->bb.piece[!board->turn][CB_PTYPE_QUEEN]);
+        if (bishop_threats) continue;
+
+        rook_threats = cb_read_rook_atk_msk(king_sq, new_occ)
+            & (board->bb.piece[!board->turn][CB_PTYPE_ROOK]
+                | board->bb.piece[!board->turn][CB_PTYPE_QUEEN]);
+        if (rook_threats) continue;
+
+        /* Visit the move if it doesn't cause any problems. */
+        CB_VISIT(visit, ctx, cb_mv_from_data(sq, enp_sq, CB_MV_ENPASSANT));
+    }
+
+    return false;
+}
+
+CB_VISIT_INLINE bool cb_visit_king_moves(cb_board_t *board, cb_state_tables_t *state,
+                                         cb_visitor_t visit, void *ctx)
+{
+    uint8_t sq = peek_rbit(board->bb.piece[board->turn][CB_PTYPE_KING]);
+    uint64_t mvmsk = cb_read_king_atk_msk(sq) & ~board->bb.color[board->turn] & ~state->threats;
+
+    return cb_visit_mask(board, sq, mvmsk, visit, ctx);
+}
+
+CB_VISIT_INLINE bool cb_visit_block_moves(cb_board_t *board, cb_state_tables_t *state,
+                                          cb_visitor_t visit, void *ctx)
+{
+    uint64_t *pieces = board->bb.piece[board->turn];
+    uint64_t occ = board->bb.occ;
+    uint64_t targets = state->check_blocks;
+    uint64_t attackers;
+    uint8_t target;
+    cb_mv_flag_t flags;
+
+    /* A pinned piece can never capture the checker or block the check as its pin ray and
+     * the check ray only meet on the king. */
+    uint64_t knights = pieces[CB_PTYPE_KNIGHT] & ~state->pins[CB_DIR_UNION];
+    uint64_t diagonals = (pieces[CB_PTYPE_BISHOP] | pieces[CB_PTYPE_QUEEN])
+        & ~state->pins[CB_DIR_UNION];
+    uint64_t orthogonals = (pieces[CB_PTYPE_ROOK] | pieces[CB_PTYPE_QUEEN])
+        & ~state->pins[CB_DIR_UNION];
+
+    /* Look backwards from each square on the check ray for pieces that can reach it. */
+    while (targets) {
+        target = pop_rbit(&targets);
+        flags = (UINT64_C(1) << target) & state->checks ? CB_MV_CAPTURE : CB_MV_QUIET;
+        attackers = (cb_read_knight_atk_msk(target) & knights)
+            | (cb_read_bishop_atk_msk(target, occ) & diagonals)
+            | (cb_read_rook_atk_msk(target, occ) & orthogonals);
+        while (attackers)
+            CB_VISIT(visit, ctx, cb_mv_from_data(pop_rbit(&attackers), target, flags));
+    }
+
+    return false;
+}
+
+CB_VISIT_INLINE bool cb_visit_evasions(cb_board_t *board, cb_state_tables_t *state,
+                                       cb_visitor_t visit, void *ctx)
+{
+    if (cb_visit_king_moves(board, state, visit, ctx))
+        return true;
+
+    /* Only the king can get out of a double check. */
+    if (popcnt(state->checks) > 1)
+        return false;
+
+    /* Pawns are already limited to the check blocks and castling is never legal in check. */
+    return cb_visit_pawn_moves(board, state, visit, ctx)
+        || cb_visit_block_moves(board, state, visit, ctx)
+        || cb_visit_enp_moves(board, state, visit, ctx);
+}
+
+/**
+ * @breif Generates the legal moves of a position and hands each one to a visitor.
+ *
+ * Visits the same moves in the same order as cb_gen_moves fills its list.
+ *
+ * @param board The board to generate moves on.
+ * @param state The state table to reference for move generation.
+ * @param visit The visitor. Returns true to stop the generation.
+ * @param ctx Passed through to the visitor.
+ * @return True if the visitor stopped the generation early.
+ */
+CB_VISIT_INLINE bool cb_visit_moves(cb_board_t *board, cb_state_tables_t *state,
+                                    cb_visitor_t visit, void *ctx)
+{
+    /* Use the dedicated generator when in check. */
+    if (state->checks)
+        return cb_visit_evasions(board, state, visit, ctx);
+
+    return cb_visit_pawn_moves(board, state, visit, ctx)
+        || cb_visit_simple_moves(board, state, visit, ctx)
+        || cb_visit_castle_moves(board, state, visit, ctx)
+        || cb_visit_enp_moves(board, state, visit, ctx);
+}
+
+/*
+ * Captures, promotions and quiet checks.
+ *
+ * The quiet moves are limited to the squares in a cb_check_info_t, so most of them are never
+ * generated. Passing no check info leaves out the quiet checks altogether.
+ */
+
+/**
+ * Returns the targets that uncover a check when the piece on sq moves to them.
+ */
+CB_VISIT_INLINE uint64_t cb_discovery_targets(const cb_check_info_t *info, uint8_t sq,
+                                              uint64_t targets)
+{
+    uint64_t off_line = 0;
+    uint8_t dir, target;
+
+    if ((info->discoverers & (UINT64_C(1) << sq)) == 0)
+        return 0;
+
+    /* Any move that leaves the line between the king and the slider behind sq. */
+    dir = cb_get_ray_direction(info->king_sq, sq);
+    while (targets) {
+        target = pop_rbit(&targets);
+        if (cb_get_ray_direction(info->king_sq, target) != dir)
+            off_line |= UINT64_C(1) << target;
+    }
+
+    return off_line;
+}
+
+/**
+ * @breif Returns true if a quiet move gives check. Captures and promotions are not looked at.
+ */
+CB_VISIT_INLINE bool cb_quiet_gives_check(cb_board_t *board, const cb_check_info_t *info,
+                                          cb_move_t mv)
+{
+    uint8_t from = cb_mv_get_from(mv);
+    uint8_t to = cb_mv_get_to(mv);
+
+    return (info->check_sqs[cb_ptype_at_sq(board, from)] & (UINT64_C(1) << to))
+        || cb_discovery_targets(info, from, UINT64_C(1) << to);
+}
+
+CB_VISIT_INLINE bool cb_visit_noisy_pawn_moves(cb_board_t *board, cb_state_tables_t *state,
+                                               const cb_check_info_t *info,
+                                               cb_visitor_t visit, void *ctx)
+{
+    cb_pawn_targets_t t;
+    uint64_t disc;
+
+    cb_pawn_targets(&t, board, state);
+
+    /* A push only uncovers a check when the pawn is not on the file of the king. */
+    if (info == NULL) {
+        t.forward = 0;
+        t.doubles = 0;
+    } else {
+        disc = board->bb.piece[board->turn][CB_PTYPE_PAWN] & info->discoverers
+            & ~(BB_LEFT_COL << (info->king_sq % 8));
+        disc = cb_pawn_smear_forward(disc, board->turn);
+        t.forward &= info->check_sqs[CB_PTYPE_PAWN] | disc;
+        disc = cb_pawn_smear_forward(disc, board->turn);
+        t.doubles &= info->check_sqs[CB_PTYPE_PAWN] | disc;
+    }
+
+    return cb_visit_pawn_targets(board, &t, visit, ctx);
+}
+
+CB_VISIT_INLINE bool cb_visit_noisy_simple_moves(cb_board_t *board, cb_state_tables_t *state,
+                                                 const cb_check_info_t *info,
+                                                 cb_visitor_t visit, void *ctx)
+{
+    uint8_t sq;
+    uint64_t mvmsk, quiet;
+    uint64_t enemy = board->bb.color[!board->turn];
+    uint64_t pieces = board->bb.color[board->turn];
+
+    pieces ^= board->bb.piece[board->turn][CB_PTYPE_PAWN];
+    while (pieces) {
+        sq = pop_rbit(&pieces);
+        mvmsk = cb_legal_mv_mask(board, state, sq);
+        quiet = mvmsk & ~board->bb.occ;
+        mvmsk &= enemy;
+        if (info != NULL)
+            mvmsk |= quiet & (info->check_sqs[cb_ptype_at_sq(board, sq)]
+                | cb_discovery_targets(info, sq, quiet));
+        if (cb_visit_mask(board, sq, mvmsk, visit, ctx))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Visits the castles where the rook lands with a check. The king can never uncover one.
+ */
+CB_VISIT_INLINE bool cb_visit_checking_castles(cb_board_t *board, cb_state_tables_t *state,
+                                               const cb_check_info_t *info,
+                                               cb_visitor_t visit, void *ctx)
+{
+    uint8_t from = board->turn == CB_WHITE ? M_WHITE_KING_START : M_BLACK_KING_START;
+    uint8_t to, rook_from, rook_to;
+    uint64_t occ;
+
+    if (cb_ksc_legal(board, state)) {
+        to = board->turn == CB_WHITE ? M_WHITE_KING_SIDE_CASTLE_TARGET :
+            M_BLACK_KING_SIDE_CASTLE_TARGET;
+        rook_from = board->turn == CB_WHITE ? M_WHITE_KING_SIDE_ROOK_START :
+            M_BLACK_KING_SIDE_ROOK_START;
+        rook_to = board->turn == CB_WHITE ? M_WHITE_KING_SIDE_ROOK_TARGET :
+            M_BLACK_KING_SIDE_ROOK_TARGET;
+        occ = board->bb.occ ^ (UINT64_C(1) << from) ^ (UINT64_C(1) << to)
+            ^ (UINT64_C(1) << rook_from) ^ (UINT64_C(1) << rook_to);
+        if (cb_read_rook_atk_msk(info->king_sq, occ) & (UINT64_C(1) << rook_to))
+            CB_VISIT(visit, ctx, cb_mv_from_data(from, to, CB_MV_KING_SIDE_CASTLE));
+    }
+
+    if (cb_qsc_legal(board, state)) {
+        to = board->turn == CB_WHITE ? M_WHITE_QUEEN_SIDE_CASTLE_TARGET :
+            M_BLACK_QUEEN_SIDE_CASTLE_TARGET;
+        rook_from = board->turn == CB_WHITE ? M_WHITE_QUEEN_SIDE_ROOK_START :
+            M_BLACK_QUEEN_SIDE_ROOK_START;
+        rook_to = board->turn == CB_WHITE ? M_WHITE_QUEEN_SIDE_ROOK_TARGET :
+            M_BLACK_QUEEN_SIDE_ROOK_TARGET;
+        occ = board->bb.occ ^ (UINT64_C(1) << from) ^ (UINT64_C(1) << to)
+            ^ (UINT64_C(1) << rook_from) ^ (UINT64_C(1) << rook_to);
+        if (cb_read_rook_atk_msk(info->king_sq, occ) & (UINT64_C(1) << rook_to))
+            CB_VISIT(visit, ctx, cb_mv_from_data(from, to, CB_MV_QUEEN_SIDE_CASTLE));
+    }
+
+    return false;
+}
+
+/**
+ * @breif Passes on the noisy moves among the evasions.
+ */
+typedef struct {
+    cb_board_t *board;              /**< The board the moves are generated on. */
+    const cb_check_info_t *info;    /**< The check squares, or NULL for no quiet checks. */
+    cb_visitor_t visit;             /**< The visitor to pass the moves on to. */
+    void *ctx;                      /**< The context of that visitor. */
+} cb_noisy_filter_t;
+
+CB_VISIT_INLINE bool cb_noisy_filter(void *ctx, cb_move_t mv)
+{
+    cb_noisy_filter_t *f = ctx;
+    uint16_t flags = cb_mv_get_flags(mv);
+
+    if ((flags & (CB_MV_CAPTURE | CB_MV_KNIGHT_PROMO)) == 0
+            && (f->info == NULL || !cb_quiet_gives_check(f->board, f->info, mv)))
+        return false;
+    return f->visit(f->ctx, mv);
+}
+
+/**
+ * @breif Generates the captures, promotions and quiet checks of a position.
+ *
+ * In check there are only a few evasions, so they are all generated and the quiet ones that
+ * do not give check are dropped.
+ *
+ * @param board The board to generate moves on.
+ * @param state The state table to reference for move generation.
+ * @param info The check squares from cb_gen_check_info, or NULL to leave out quiet checks.
+ * @param visit The visitor. Returns true to stop the generation.
+ * @param ctx Passed through to the visitor.
+ * @return True if the visitor stopped the generation early.
+ */
+CB_VISIT_INLINE bool cb_visit_noisy_and_checks(cb_board_t *board, cb_state_tables_t *state,
+                                               const cb_check_info_t *info,
+                                               cb_visitor_t visit, void *ctx)
+{
+    cb_noisy_filter_t filter;
+
+    if (state->checks) {
+        filter.board = board;
+        filter.info = info;
+        filter.visit = visit;
+        filter.ctx = ctx;
+        return cb_visit_evasions(board, state, cb_noisy_filter, &filter);
+    }
+
+    return cb_visit_noisy_pawn_moves(board, state, info, visit, ctx)
+        || cb_visit_noisy_simple_moves(board, state, info, visit, ctx)
+        || (info != NULL && cb_visit_checking_castles(board, state, info, visit, ctx))
+        || cb_visit_enp_moves(board, state, visit, ctx);
+}
+
+#endif /* CB_VISIT_H */
@@ -0,0 +1,79 @@
+
+#ifndef CB_ZOBRIST_H
+#define CB_ZOBRIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cb_types.h"
+#include "cb_const.h"
+#include "cb_tables.h"
+#include "cb_history.h"
+
+/**
+ * @breif The random keys that are xored together into the zobrist key of a position.
+ *
+ * The key covers the pieces, the side to move, the castle rights and the enpassant column. The
+ * enpassant column only counts when a pawn of the side to move can legally make the capture,
+ * so the same position reached with and without a double push gets the same key. The halfmove
+ * clock is left out.
+ */
+typedef struct {
+    uint64_t piece[2][6][64];   /**< Indexed by color, piece type and square. */
+    uint64_t castle[16];        /**< Indexed by the KQkq bits of the history state. */
+    uint64_t enp[8];            /**< Indexed by the enpassant column. */
+    uint64_t turn;              /**< Xored in when white is to move. */
+} cb_zobrist_t;
+
+extern cb_zobrist_t cb_zobrist;
+
+/**
+ * @breif Fills the zobrist keys. The keys are the same on every run.
+ */
+void cb_init_zobrist();
+
+/**
+ * @breif Computes the zobrist key of a board from scratch.
+ * @param board The board to hash.
+ * @return The key.
+ */
+uint64_t cb_hash_board(const cb_board_t *board);
+
+/**
+ * @breif Returns the zobrist key of the current position, as kept up to date by cb_make.
+ */
+static inline uint64_t cb_board_key(const cb_board_t *board)
+{
+    return board->hist.data[board->hist.count - 1].key;
+}
+
+/**
+ * @breif Returns true if one of the pawns in sources can legally capture on enp_sq.
+ */
+bool cb_zobrist_enp_legal(const cb_board_t *board, uint8_t enp_sq, uint64_t sources);
+
+/**
+ * @breif Returns the enpassant part of the zobrist key.
+ * @param board The board, with the capturing side to move.
+ * @param hist The history state holding the enpassant column.
+ * @return The enpassant key or zero if no pawn can legally make the capture.
+ */
+static inline uint64_t cb_zobrist_enp(const cb_board_t *board, cb_history_t hist)
+{
+    uint8_t enp_sq;
+    uint64_t sources;
+
+    if (!cb_hist_enp_availiable(hist))
+        return 0;
+
+    /* Most double pushes do not land next to an enemy pawn. */
+    enp_sq = (board->turn == CB_WHITE ? M_BLACK_MIN_ENPASSANT_TARGET :
+            M_WHITE_MIN_ENPASSANT_TARGET) + cb_hist_enp_col(hist);
+    sources = cb_read_pawn_atk_msk(enp_sq, !board->turn)
+        & board->bb.piece[board->turn][CB_PTYPE_PAWN];
+    if (sources == 0 || !cb_zobrist_enp_legal(board, enp_sq, sources))
+        return 0;
+    return cb_zobrist.enp[cb_hist_enp_col(hist)];
+}
+
+#endif /* CB_ZOBRIST_H */
@@ -0,0 +1,82 @@
+
+#ifndef CIBYL_ENGBENCH_H
+#define CIBYL_ENGBENCH_H
+
+#include "engine.h"
+
+#define ENGBENCH_DEFAULT_DEPTH 5
+#define ENGBENCH_EVAL_ITERATIONS 100000
+#define ENGBENCH_DRAW_DEPTH 8
+
+/* Set by bench counters. Wraps every bench pass and eval mode in hardware performance counters. */
+extern bool engbench_counters;
+
+/**
+ * @breif Measures how the time to reach a depth scales with the number of thinkers.
+ *
+ * Searches every bench position to a fixed depth with one thinker, then two, and so on up to
+ * max_threads. The hash is cleared before every search. Prints the summed time and nodes of
+ * each thread count and their ratio to one thinker, which shows how many extra nodes the
+ * parallel search pays for its speedup. The options are restored after.
+ *
+ * @param eng The engine to benchmark. Must be idle.
+ * @param depth The depth of every search.
+ * @param max_threads The largest number of thinkers to try.
+ * @param ybwc Split the tree between the thinkers in place of Lazy SMP.
+ * @return An error code for any failed engine calls.
+ */
+cibyl_errno_t engbench_threads(engine_t *eng, int depth, int max_threads, bool ybwc);
+
+/**
+ * @breif Measures how many nodes each pruning technique saves.
+ *
+ * Searches every bench position to a fixed depth with every technique switched off, then with
+ * each one on alone, then with all of them on. Prints the nodes and time of each pass and
+ * their ratio to the pass with none. The tuning options are left as set, so a margin can be
+ * changed with setoption and measured again. The switches are restored after.
+ *
+ * @param eng The engine to benchmark. Must be idle.
+ * @param depth The depth of every search.
+ * @return An error code for any failed engine calls.
+ */
+cibyl_errno_t engbench_pruning(engine_t *eng, int depth);
+
+/**
+ * @breif Measures the work per node of legal and of pseudo-legal move generation in the search.
+ *
+ * Searches every bench position to a fixed depth once with each MoveGen mode and prints the
+ * nodes, the time and the nanoseconds per node of each. The mode is restored after.
+ *
+ * @param eng The engine to benchmark. Must be idle.
+ * @param depth The depth of every search.
+ * @return An error code for any failed engine calls.
+ */
+cibyl_errno_t engbench_movegen(engine_t *eng, int depth);
+
+/**
+ * @breif Measures the evals per second of the full and the incremental static eval.
+ *
+ * Plays every legal move of every bench position and evaluates the child, once by walking the
+ * board and once by updating the eval terms of the parent. The time to make and unmake the
+ * moves alone is taken off both. Prints the rates and any child the two disagree on. With
+ * engbench_counters set, then plays the moves once more per mode under hardware counters.
+ *
+ * @param eng The engine whose board is borrowed. Must be idle.
+ * @param iterations The number of times the moves of each position are played.
+ * @return An error code for any failed engine calls.
+ */
+cibyl_errno_t engbench_eval(engine_t *eng, int iterations);
+
+/**
+ * @breif Checks that the search scores forced draws as draws.
+ *
+ * Searches positions where the side to move can do no better than a repetition or the fifty
+ * move rule, each far ahead or behind on material, and prints the score of each.
+ *
+ * @param eng The engine to search with. Must be idle.
+ * @param depth The depth of every search.
+ * @return CIBYL_EABORT if any position does not score zero, or for any failed engine calls.
+ */
+cibyl_errno_t engbench_draws(engine_t *eng, int depth);
+
+#endif /* CIBYL_ENGBENCH_H */
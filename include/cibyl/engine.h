@@ -12,13 +12,77 @@
 
 #include "cb_move.h"
 #include "cibyl.h"
+#include "ttable.h"
+#include "timeman.h"
+#include "eval.h"
+
+#define ENG_MSG_LEN 1024
+#define THINK_MAX_PLY 128
+#define SPLIT_DEQUE_LEN 16
+
+/**
+ * @breif The options that can be changed with setoption. Indexes eng->options.
+ */
+typedef enum {
+    ENG_OPT_HASH = 0,       /**< The size of the transposition table in megabytes. */
+    ENG_OPT_CLEAR_HASH,     /**< Empties the transposition table. */
+    ENG_OPT_THREADS,        /**< The number of thinkers. */
+    ENG_OPT_YBWC,           /**< Split the tree between the thinkers in place of Lazy SMP. */
+    ENG_OPT_MOVE_OVERHEAD,  /**< The time lost to the GUI per move in milliseconds. */
+    ENG_OPT_PONDER,         /**< Tells the GUI that the engine can ponder. */
+    ENG_OPT_NULL_MOVE,      /**< Null move pruning. */
+    ENG_OPT_NULL_MOVE_R,    /**< The depth reduction of a null move at depth zero. */
+    ENG_OPT_NULL_VERIFY,    /**< The depth from which a null move cutoff is verified. */
+    ENG_OPT_LMR,            /**< Late move reductions. */
+    ENG_OPT_LMR_BASE,       /**< The constant part of a reduction, in hundredths of a ply. */
+    ENG_OPT_LMR_DIVISOR,    /**< The divisor of the log part of a reduction, in hundredths. */
+    ENG_OPT_RFP,            /**< Reverse futility pruning. */
+    ENG_OPT_RFP_DEPTH,      /**< The deepest node reverse futility pruning applies to. */
+    ENG_OPT_RFP_MARGIN,     /**< The margin of reverse futility pruning per ply. */
+    ENG_OPT_FUTILITY,       /**< Futility pruning of quiet moves. */
+    ENG_OPT_FUTILITY_DEPTH, /**< The deepest node futility pruning applies to. */
+    ENG_OPT_FUTILITY_MARGIN,/**< The margin of futility pruning per ply. */
+    ENG_OPT_RAZORING,       /**< Razoring. */
+    ENG_OPT_RAZOR_DEPTH,    /**< The deepest node razoring applies to. */
+    ENG_OPT_RAZOR_MARGIN,   /**< The margin of razoring per ply. */
+    ENG_OPT_MOVEGEN,        /**< The eng_movegen_t the search generates its moves with. */
+    ENG_OPT_COUNT
+} eng_opt_t;
+
+/**
+ * @breif The kinds of UCI option.
+ */
+typedef enum {
+    ENG_OPT_SPIN,           /**< An integer between min and max. */
+    ENG_OPT_CHECK,          /**< A boolean, stored as zero or one. */
+    ENG_OPT_BUTTON,         /**< Has no value, setting it performs an action. */
+    ENG_OPT_COMBO           /**< One of a list of names, stored as its index. */
+} eng_opt_type_t;
+
+/**
+ * @breif The values of the MoveGen option.
+ */
+typedef enum {
+    ENG_MOVEGEN_LEGAL,      /**< Generate legal moves from the full state tables. */
+    ENG_MOVEGEN_PSEUDO      /**< Generate pseudo-legal moves, test each one before it is made. */
+} eng_movegen_t;
 
 /**
- * @breif Transposition table that contains precalculated positions.
+ * @breif Describes one option to the GUI.
  */
 typedef struct {
+    const char *name;       /**< The name of the option as sent by setoption. */
+    eng_opt_type_t type;    /**< The kind of option. */
+    int64_t def;            /**< The default value. */
+    int64_t min;            /**< The smallest value of a spin. */
+    int64_t max;            /**< The largest value of a spin, or the last index of a combo. */
+    const char *const *vars;/**< The names of the values of a combo. */
+} eng_option_t;
 
-} ttable_t;
+/**
+ * @breif The options of the engine, indexed by eng_opt_t.
+ */
+extern const eng_option_t ENG_OPTIONS[ENG_OPT_COUNT];
 
 /**
  * @breif A bag of parameters for an engine search.
@@ -39,28 +103,131 @@ typedef struct {
     bool ready;             /**< Flag that states if the search is ready. */
 } go_param_t;
 
+/**
+ * @breif A node whose remaining moves are shared out between thinkers.
+ *
+ * Made by a thinker once the first move of a node has been searched, as the young brothers
+ * wait rule asks. It lives on the stack of its owner, which does not return until every helper
+ * has left.
+ */
+typedef struct split_point {
+    mtx_t lock;                     /**< Guards every field below that is not constant. */
+    struct split_point *parent;     /**< The split point the owner was working on, or NULL. */
+    cb_move_t path[THINK_MAX_PLY];  /**< The moves from the root to the node. */
+    int path_len;                   /**< The number of moves in path. */
+    cb_mvlst_t moves;               /**< The moves of the node. Move k is move k + 1 there. */
+    bool late[CB_MAX_NUM_MOVES];    /**< Set for the moves that came from MP_QUIETS. */
+    bool pv_node;                   /**< The node was searched with an open window. */
+    bool futile;                    /**< Late quiet moves may be pruned by futility. */
+    bool lmr;                       /**< Late quiet moves may be reduced. */
+    int next;                       /**< The index of the next move to hand out. */
+    int alpha;                      /**< The best score so far or the alpha of the node. */
+    int beta;                       /**< The beta of the node. */
+    int best;                       /**< The best score so far. */
+    cb_move_t best_move;            /**< The move with the best score so far. */
+    int depth;                      /**< The depth of the node. */
+    int ply;                        /**< The distance of the node from the root. */
+    int helpers;                    /**< The thinkers other than the owner working on it. */
+    atomic_bool cutoff;             /**< Raised on a beta cutoff. Aborts every helper. */
+} split_point_t;
+
+/**
+ * @breif The split points of one thinker, oldest first.
+ *
+ * The owner pushes and pops at the end. Thieves look from the front, where the split points
+ * nearest the root and so with the most work under them are.
+ */
+typedef struct {
+    mtx_t lock;                                 /**< Guards the deque. */
+    split_point_t *sps[SPLIT_DEQUE_LEN];        /**< The split points. */
+    int count;                                  /**< The number of split points. */
+} sp_deque_t;
+
 /**
  * @breif Defines struct for a thread that thinks. */
 typedef struct {
-    cb_board_t *root;       /**< The root position to think on. */
+    struct engine *eng;     /**< The engine the thinker belongs to. */
+    cb_board_t board;       /**< The thinker's own copy of the root position. */
     ttable_t *ttable;       /**< The transposition table to add thoughts to. */
     thrd_t thread;          /**< The thread itself. */
+    int id;                 /**< The index in the pool. Thinker zero is the main thinker. */
+    _Atomic uint64_t nodes; /**< The nodes searched since the last go. */
+    _Atomic uint64_t qnodes;/**< The part of nodes that was searched in quiescence. */
+    _Atomic uint64_t cutoffs;       /**< The beta cutoffs of the main search. */
+    _Atomic uint64_t first_cutoffs; /**< The part of cutoffs made by the first move tried. */
+    int depth;              /**< The last depth that was completed. */
+    cb_move_t best_move;    /**< The best move of the last completed depth. */
+    int best_score;         /**< The score of the best move. */
+    int root_count;         /**< The length of the board's history at the root. */
+    int seldepth;           /**< The deepest ply reached since the last go. */
+    int null_min_ply;       /**< No null move is tried above this ply while verifying one. */
+    uint64_t limit_mask;    /**< The limits are checked whenever nodes & limit_mask is zero. */
+    eval_state_t evals[THINK_MAX_PLY];          /**< The eval terms of each ply from the root. */
+    cb_move_t pv[THINK_MAX_PLY][THINK_MAX_PLY]; /**< The line from each ply, a triangular table. */
+    int pv_len[THINK_MAX_PLY];                  /**< The length of each line of pv. */
+    cb_move_t best_pv[THINK_MAX_PLY];           /**< The line of the last completed depth. */
+    int best_pv_len;                            /**< The length of best_pv. */
+    cb_move_t killers[THINK_MAX_PLY][2];        /**< Quiet moves that cut off at each ply. */
+    int history[2][64][64];                     /**< Butterfly history by color, from and to. */
+    cb_move_t counters[64][64];                 /**< The reply that refuted each from and to. */
+    sp_deque_t deque;       /**< The split points this thinker owns. */
+    split_point_t *sp;      /**< The split point being worked on, or NULL. */
 } thinker_t;
 
 /**
- * @breif Defines a pool of threads that funcitons as an engine.
+ * @breif The result of the last search, written by the main thinker before bestmove.
+ */
+typedef struct {
+    cb_move_t best_move;    /**< The move that was played. */
+    int score;              /**< Its score in centipawns. */
+    int depth;              /**< The depth the main thinker completed. */
+    uint64_t nodes;         /**< The nodes searched by every thinker. */
+    uint64_t qnodes;        /**< The part of nodes that was searched in quiescence. */
+    uint64_t cutoffs;       /**< The beta cutoffs of the main search. */
+    uint64_t first_cutoffs; /**< The part of cutoffs made by the first move tried. */
+    uint64_t time_ns;       /**< The wall time from go to bestmove. */
+} search_result_t;
+
+/**
+ * @breif How pondering has paid off since the engine started.
  */
 typedef struct {
+    uint64_t searches;      /**< Ponder searches started. */
+    uint64_t hits;          /**< Ponder searches that ended in a ponderhit. */
+    uint64_t saved_ns;      /**< The time searched on the opponent's clock before each hit. */
+    uint64_t stop_ns;       /**< When the last stop was sent. */
+} ponder_stats_t;
+
+/**
+ * @breif Defines a pool of threads that funcitons as an engine.
+ */
+typedef struct engine {
     cb_board_t board;       /**< The current position. */
     ttable_t ttable;        /**< The transposition tables. */
     thinker_t *thinkers;    /**< The pool of thinkers. */
+    int num_thinkers;       /**< The number of thinkers in the pool. */
     thrd_t mgr;             /**< The manager thread. */
     go_param_t go_params;   /**< The parameters for any active search. */
+    uint64_t start_ns;      /**< When the active search was started. */
+    _Atomic uint64_t clock_ns; /**< When our clock started, at go or at the ponderhit. */
+    time_manager_t tm;      /**< The time budget of the active search. */
+    search_result_t result; /**< The result of the last search. */
+    bool quiet;             /**< Suppresses the info and bestmove output, set while benchmarking. */
 
     cnd_t sync_cnd;         /**< A condition variable that handles thinker sync. */
     mtx_t sync_mtx;         /**< A mutex that handles thinker sync. */
     int rdy_thrds;          /**< Holds the number of threads that are ready to run. */
+    int busy_thrds;         /**< Holds the number of thinkers still searching. */
+    uint64_t search_id;     /**< Bumped by every go. Wakes up the thinkers. */
+    bool searching;         /**< Set from go until the bestmove is sent. */
+    atomic_bool stop_flag;  /**< Checked by the thinkers to see if they should stop searching. */
+    atomic_bool pondering;  /**< Set from go ponder until the ponderhit. No limit applies. */
+    ponder_stats_t ponder;  /**< The ponder hit rate. Guarded by sync_mtx. */
     atomic_bool exit_flag;  /**< Checked by the thinkers to see if they should shut down. */
+    bool initialized;       /**< Set by the manager once initialization is complete. */
+    cibyl_errno_t init_result; /**< The result of initialization. */
+    int64_t options[ENG_OPT_COUNT]; /**< The current value of every option. */
+    uint8_t reductions[64][64];     /**< The late move reduction by depth and move number. */
 
 #ifdef _WIN32
     PHANDLE h_msg_read;     /**< The read handle for the pipe on windows. */
@@ -86,7 +253,7 @@ static void clear_go_params(go_param_t *params) {
     params->nodes = -1;
     params->mate = -1;
     params->movetime = -1;
-    params->infinite = true;
+    params->infinite = false;
 }
 
 /**
@@ -111,11 +278,41 @@ cibyl_errno_t eng_cleanup(engine_t *eng);
 
 /**
  * @breif Tells the engine that it is now playing a new game.
- * Dumps certain game-specific lookup tables.
+ *
+ * Ages the transposition table so the entries of the last game are the first to be replaced.
+ *
  * @param engine The engine in question.
  */
 void eng_newgame(engine_t *eng);
 
+/**
+ * @breif Sends a message out of the engine's message pipe. Safe to call from any thread.
+ * @param eng The engine in question.
+ * @param format A printf compliant format string. The message must end with a newline.
+ * @param ... All remaining arguments passed into the format string.
+ */
+void eng_write_msg(engine_t *eng, char *format, ...);
+
+/**
+ * @breif Changes an option of the engine. Waits for initialization to complete.
+ * @param eng The engine in question.
+ * @param name The name of the option. Matched without regard to case.
+ * @param value The value of the option, or NULL for a button.
+ * @return CIBYL_EABORT for unknown options and bad values.
+ */
+cibyl_errno_t eng_set_option(engine_t *eng, const char *name, const char *value);
+
+/**
+ * @breif Stops every thinker and spawns the same number again from the calling thread.
+ *
+ * Anything the calling thread sets up for the threads it creates, like inherited performance
+ * counters, then covers the whole search. No search may be running.
+ *
+ * @param eng The engine in question.
+ * @return An error code for any failed allocations or thread creations.
+ */
+cibyl_errno_t eng_respawn_thinkers(engine_t *eng);
+
 /**
  * @brief Initializes the position of the engine to a specific UCI fen string.
  * @param engine The engine in question.
@@ -130,6 +327,12 @@ cibyl_errno_t eng_set_ucifen(engine_t *eng, char *fen);
  */
 void eng_notify_go(engine_t *eng, const go_param_t *opts);
 
+/**
+ * @breif Waits for the active search to send its bestmove. Returns at once if there is none.
+ * @param eng The engine to wait on.
+ */
+void eng_await_search(engine_t *eng);
+
 /**
  * @breif Notifies the engine that it should stop a search as soon as possible.
  *
@@ -143,7 +346,10 @@ void eng_notify_stop(engine_t *eng);
 /**
  * @breif Notifies the engine that the pondered move was played.
  *
- * The engine should switch from a ponder search to a normal search.
+ * The ponder search carries on as a normal search, with its iterations, transposition table
+ * and history kept. The hard limit counts from the ponderhit, as our clock does, but the soft
+ * limit counts from the go, so the time already spent pondering is not spent again. If it
+ * already covers the soft limit the best move is sent at once.
  *
  * @param eng THe engine to notify.
  */
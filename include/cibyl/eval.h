@@ -5,13 +5,65 @@
 #include "cb_types.h"
 
 /**
- * Evaluates the position specified by board.
+ * @breif The value of each piece type in centipawns, indexed by cb_ptype_t.
  */
-float eval(const cb_board_t *board);
+extern const int PIECE_VALUES[7];
+
+/* The phase of the starting position, where the midgame score counts fully. */
+#define EVAL_MAX_PHASE 24
+
+/**
+ * @breif The terms of the evaluation that a move changes in constant time.
+ *
+ * The scores sum the material and piece-square values of every piece, white minus black.
+ * Search keeps one per ply and updates it along with the board, so the static eval of a node
+ * is a blend of two sums and never walks the board.
+ */
+typedef struct {
+    int mg;         /**< The midgame score from white. */
+    int eg;         /**< The endgame score from white. */
+    int phase;      /**< The non-pawn material left, from zero up to EVAL_MAX_PHASE. */
+} eval_state_t;
+
+/**
+ * @breif Computes the state of a position from scratch.
+ */
+void eval_state_init(eval_state_t *state, const cb_board_t *board);
+
+/**
+ * @breif Updates the state for a move. Must be called before the move is made on board.
+ */
+void eval_state_make(eval_state_t *state, const cb_board_t *board, cb_move_t mv);
+
+/**
+ * @breif Blends the midgame and endgame scores of a state by its phase.
+ * @return The score in centipawns from the side to move.
+ */
+static inline int eval_state_score(const eval_state_t *state, cb_color_t turn)
+{
+    /* Promotions can push the phase past the start. */
+    int phase = state->phase < EVAL_MAX_PHASE ? state->phase : EVAL_MAX_PHASE;
+    int score = (state->mg * phase + state->eg * (EVAL_MAX_PHASE - phase)) / EVAL_MAX_PHASE;
+
+    return turn == CB_WHITE ? score : -score;
+}
+
+/**
+ * Evaluates the position specified by board in centipawns from the side to move. Walks the
+ * whole board. Search reads its incremental state instead.
+ */
+int eval(const cb_board_t *board);
 
 /**
- * Preforms an alphabeta move search on the position specified by board.
+ * @breif Computes the static exchange evaluation of a capture.
+ *
+ * Plays out every capture on the target square, each side taking with its least valuable piece
+ * and stopping once going on would lose. Pins and checks are ignored.
+ *
+ * @param board The board the move is played on.
+ * @param mv The capture, enpassant or promotion.
+ * @return The material won by the side to move in centipawns. Negative for a losing capture.
  */
-cb_move_t alphabeta(cb_board_t *board);
+int see(const cb_board_t *board, cb_move_t mv);
 
 #endif /* CIBYL_EVAL_H */
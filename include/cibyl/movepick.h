@@ -0,0 +1,130 @@
+
+#ifndef CIBYL_MOVEPICK_H
+#define CIBYL_MOVEPICK_H
+
+#include "cb_move.h"
+#include "engine.h"
+
+/* History scores stay within plus or minus this. */
+#define HISTORY_MAX 16384
+
+/**
+ * @breif The stages of a move picker, in the order the moves come out.
+ */
+typedef enum {
+    MP_HASH,                /**< The move from the transposition table. */
+    MP_INIT_CAPTURES,       /**< Scores the captures and promotions by MVV-LVA. */
+    MP_GOOD_CAPTURES,       /**< Captures that do not lose material. The rest are put aside. */
+    MP_REFUTATIONS,         /**< The two killers of the ply and the countermove. */
+    MP_INIT_QUIETS,         /**< Scores the quiet moves by history. */
+    MP_QUIETS,              /**< Quiet moves, best history first. */
+    MP_BAD_CAPTURES,        /**< The captures put aside, in MVV-LVA order. */
+    MP_DONE
+} mp_stage_t;
+
+/**
+ * @breif Hands out the legal moves of a node, the moves most likely to cut off first.
+ *
+ * Every move is generated up front, but the moves of a stage are only scored once the stages
+ * before it are used up. A node that cuts off on the hash move scores nothing. Pseudo-legal
+ * moves are only tested for legality as they are handed out.
+ */
+typedef struct {
+    const cb_board_t *board;            /**< The board of the node. */
+    const thinker_t *thinker;           /**< The thinker whose tables are read. */
+    cb_mvlst_t moves;                   /**< Captures and promotions first, then quiet moves. */
+    bool pseudo;                        /**< The moves are pseudo-legal. */
+    cb_pseudo_tables_t pstate;          /**< The tables to test pseudo-legal moves with. */
+    int scores[CB_MAX_NUM_MOVES];       /**< The sort key of each move in the current stage. */
+    int num_captures;                   /**< The number of captures and promotions in moves. */
+    int cur;                            /**< The next move of moves to hand out. */
+    cb_move_t bad[CB_MAX_NUM_MOVES];    /**< The captures that lose material. */
+    int num_bad;                        /**< The number of moves in bad. */
+    int cur_bad;                        /**< The next move of bad to hand out. */
+    cb_move_t hash_move;                /**< The move from the table, or CB_INVALID_MOVE. */
+    cb_move_t refutations[3];           /**< The killers and the countermove of the node. */
+    int cur_ref;                        /**< The next refutation to try. */
+    mp_stage_t stage;                   /**< The stage of the next move. */
+} move_picker_t;
+
+/**
+ * @breif Returns true if a move neither captures nor promotes.
+ */
+static inline bool mp_is_quiet(cb_move_t mv)
+{
+    return cb_mv_get_flags(mv) < CB_MV_CAPTURE;
+}
+
+/**
+ * @breif Returns the value of the piece a move takes, and of the piece it promotes to less a
+ * pawn.
+ */
+int mp_capture_value(const cb_board_t *board, cb_move_t mv);
+
+/**
+ * @breif Sorts a list of captures by most valuable victim, then by least valuable attacker.
+ */
+void mp_sort_captures(const cb_board_t *board, cb_mvlst_t *mvlst);
+
+/**
+ * @breif Generates the moves of the thinker's board and readies a picker for them.
+ * @param mp The picker to initialize.
+ * @param thinker The thinker searching the node.
+ * @param state The state tables of the board to generate legal moves with, or NULL.
+ * @param pstate The pseudo tables of the board to generate pseudo-legal moves with if state is
+ *        NULL.
+ * @param hash_move The move from the transposition table, or CB_INVALID_MOVE.
+ * @param ply The distance of the node from the root.
+ */
+void mp_init(move_picker_t *mp, const thinker_t *thinker, cb_state_tables_t *state,
+             const cb_pseudo_tables_t *pstate, cb_move_t hash_move, int ply);
+
+/**
+ * @breif Returns the number of moves of the node. Pseudo-legal moves count as well.
+ */
+static inline int mp_size(move_picker_t *mp)
+{
+    return cb_mvlst_size(&mp->moves);
+}
+
+/**
+ * @breif Returns the next legal move, or CB_INVALID_MOVE once every move was handed out.
+ */
+cb_move_t mp_next(move_picker_t *mp);
+
+/**
+ * @breif Moves every move not yet handed out into a list, in the order they would come out.
+ * @param mp The picker to drain.
+ * @param out Populated with the moves.
+ * @param late Populated with whether each move of out came from MP_QUIETS.
+ */
+void mp_drain(move_picker_t *mp, cb_mvlst_t *out, bool *late);
+
+/**
+ * @breif Learns from a quiet move that cut off.
+ *
+ * The move becomes a killer of the ply and the countermove of the move before it. Its history
+ * is raised by the square of the depth and the history of the quiet moves tried before it is
+ * lowered by as much.
+ *
+ * @param thinker The thinker whose tables are written.
+ * @param mv The move that cut off.
+ * @param depth The depth of the node.
+ * @param ply The distance of the node from the root.
+ * @param tried The quiet moves searched before mv.
+ * @param num_tried The number of moves in tried.
+ */
+void mp_reward_quiet(thinker_t *thinker, cb_move_t mv, int depth, int ply,
+                     const cb_move_t *tried, int num_tried);
+
+/**
+ * @breif Clears the killers and halves the history before a new search.
+ */
+void mp_age_tables(thinker_t *thinker);
+
+/**
+ * @breif Clears every table of a thinker for a new game.
+ */
+void mp_clear_tables(thinker_t *thinker);
+
+#endif /* CIBYL_MOVEPICK_H */
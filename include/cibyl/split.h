@@ -0,0 +1,107 @@
+
+#ifndef CIBYL_SPLIT_H
+#define CIBYL_SPLIT_H
+
+#include "engine.h"
+
+/* Nodes shallower than this are not worth the cost of sharing. */
+#define SPLIT_MIN_DEPTH 4
+
+/**
+ * @breif Initializes an empty deque.
+ * @return CIBYL_EABORT if the lock could not be made.
+ */
+cibyl_errno_t sp_deque_init(sp_deque_t *dq);
+
+/**
+ * @breif Destroys a deque. It must be empty.
+ */
+void sp_deque_destroy(sp_deque_t *dq);
+
+/**
+ * @breif Returns true if the owner of the deque can make another split point.
+ */
+bool sp_deque_has_room(sp_deque_t *dq);
+
+/**
+ * @breif Makes a split point from a node and offers it to thieves.
+ *
+ * The moves from first on are shared out. The path to the node is read from the history of
+ * the owner's board. Move k of mvlst must be move k + 1 of the node, so that the late moves
+ * are reduced and pruned as the serial search would.
+ *
+ * @param sp The split point to fill, on the owner's stack.
+ * @param owner The thinker that searched the first move.
+ * @param mvlst The moves of the node.
+ * @param late Whether each move of mvlst came from MP_QUIETS.
+ * @param first The index of the first move that has not been searched.
+ * @param alpha The alpha of the node, raised by the moves already searched.
+ * @param beta The beta of the node.
+ * @param best The best score of the moves already searched.
+ * @param best_move The move with that score.
+ * @param depth The depth of the node.
+ * @param ply The distance of the node from the root.
+ * @param pv_node The node was searched with an open window.
+ * @param futile Late quiet moves may be pruned by futility.
+ * @param lmr Late quiet moves may be reduced.
+ * @return CIBYL_EABORT if the lock could not be made. The split point was not offered.
+ */
+cibyl_errno_t sp_open(split_point_t *sp, thinker_t *owner, const cb_mvlst_t *mvlst,
+                      const bool *late, int first, int alpha, int beta, int best,
+                      cb_move_t best_move, int depth, int ply, bool pv_node, bool futile,
+                      bool lmr);
+
+/**
+ * @breif Takes a split point back from thieves and waits for its helpers to leave.
+ * @param sp The split point, which must be the last one its owner opened.
+ * @param owner The owner of the split point.
+ */
+void sp_close(split_point_t *sp, thinker_t *owner);
+
+/**
+ * @breif Joins the oldest split point of another thinker that still has moves to hand out.
+ * @param eng The engine.
+ * @param thief The idle thinker.
+ * @return The joined split point, or NULL if there was none. Must be left with sp_leave.
+ */
+split_point_t *sp_steal(engine_t *eng, thinker_t *thief);
+
+/**
+ * @breif Leaves a split point joined with sp_steal.
+ */
+void sp_leave(split_point_t *sp);
+
+/**
+ * @breif Hands out the next move of a split point.
+ * @param sp The split point.
+ * @param mv Populated with the move.
+ * @param idx Populated with the index of the move in the moves of the split point.
+ * @param alpha Populated with the alpha to search the move with.
+ * @param best Populated with the best score so far.
+ * @return False once every move is handed out or the split point has cut off.
+ */
+bool sp_next_move(split_point_t *sp, cb_move_t *mv, int *idx, int *alpha, int *best);
+
+/**
+ * @breif Records the score of a move of a split point. Raises cutoff on a fail high.
+ * @param sp The split point.
+ * @param mv The move that was searched.
+ * @param score The score of the move.
+ * @param cut Set if this move is the one that cut the split point off, otherwise untouched.
+ * @return True if the move raised the alpha of the split point.
+ */
+bool sp_update(split_point_t *sp, cb_move_t mv, int score, bool *cut);
+
+/**
+ * @breif Returns true if a split point or any split point above it has cut off.
+ */
+static inline bool sp_aborted(const split_point_t *sp)
+{
+    for (; sp != NULL; sp = sp->parent) {
+        if (atomic_load_explicit(&sp->cutoff, memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+#endif /* CIBYL_SPLIT_H */
@@ -0,0 +1,44 @@
+
+#ifndef CIBYL_THINKER_H
+#define CIBYL_THINKER_H
+
+#include "engine.h"
+
+/* Scores are in centipawns. Mates are scored as SCORE_MATE less the plies to the mate. */
+#define SCORE_INF 32000
+#define SCORE_MATE 31000
+#define SCORE_MATE_BOUND (SCORE_MATE - THINK_MAX_PLY)
+
+/**
+ * @breif Runs an iterative deepening search on the thinker's copy of the root position.
+ *
+ * Every depth is a principal variation search. From ASPIRATION_MIN_DEPTH on it starts inside a
+ * window around the score of the depth before and widens it on a fail. The line of the last
+ * completed depth is kept in best_pv.
+ *
+ * In Lazy SMP every thinker of the pool searches the same root and they share nothing but the
+ * transposition table. Helpers skip ahead a ply on odd ids and try the root moves in a
+ * rotated order, so they fill the table with lines the main thinker has not reached yet.
+ *
+ * With the YBWC option only the main thinker runs the iterations. The helpers steal split
+ * points from the other thinkers and search their remaining moves.
+ *
+ * Returns when the engine raises stop_flag or the main thinker reaches the depth limit. The main
+ * thinker raises stop_flag itself once the nodes of the go command or the hard time limit run
+ * out, and returns between iterations once the time manager says the soft limit is used up.
+ *
+ * @param thinker The thinker to search with.
+ */
+void thinker_search(thinker_t *thinker);
+
+/**
+ * @breif Fills the late move reduction table of an engine from its LMR options.
+ *
+ * A move at depth d and move number m is reduced by base + ln(d) ln(m) / divisor plies. Must
+ * not be called while a search runs.
+ *
+ * @param eng The engine.
+ */
+void thinker_init_reductions(engine_t *eng);
+
+#endif /* CIBYL_THINKER_H */
@@ -0,0 +1,78 @@
+
+#ifndef CIBYL_TIMEMAN_H
+#define CIBYL_TIMEMAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cb_types.h"
+
+/* With no movestogo the clock is spread over this many more moves. */
+#define TM_MOVE_HORIZON 30
+
+/* The hard limit is this many soft limits, but never more than TM_MAX_USE percent of the
+ * clock that is left. */
+#define TM_HARD_FACTOR 4
+#define TM_MAX_USE 75
+
+/**
+ * @breif The time budget of one search.
+ *
+ * The soft limit is checked between iterations and stretched or shrunk by how the search is
+ * going. The hard limit is polled every few thousand nodes and aborts the search in the middle
+ * of an iteration.
+ */
+typedef struct {
+    bool active;            /**< The search has a clock. Otherwise only the GUI stops it. */
+    bool fixed;             /**< The search was given a movetime, which is used up as is. */
+    uint64_t soft_ns;       /**< No new iteration is started after this much time. */
+    uint64_t hard_ns;       /**< The search is stopped after this much time. */
+    int scale;              /**< The percent of soft_ns to use, set after every iteration. */
+    int instability;        /**< Best move changes, halved every iteration. In eighths. */
+    cb_move_t last_move;    /**< The best move of the last iteration. */
+    int last_score;         /**< The score of the last iteration. */
+    int first_score;        /**< The score of the first deep iteration, to spot a failing one. */
+} time_manager_t;
+
+/**
+ * @breif Sets the budget of a search from its go parameters.
+ *
+ * A movetime is used as is. Otherwise the limits come from the clock and increment of the
+ * side to move and from movestogo. The move overhead is taken off the clock first, so the
+ * hard limit plus the overhead never reaches the clock.
+ *
+ * @param tm The time manager to set.
+ * @param time The clock of the side to move in milliseconds, or -1.
+ * @param inc The increment of the side to move in milliseconds, or -1.
+ * @param movestogo The moves to the next time control, or -1.
+ * @param movetime The fixed time of the search in milliseconds, or -1.
+ * @param overhead The time lost to the GUI and the network per move in milliseconds.
+ */
+void tm_init(time_manager_t *tm, int64_t time, int64_t inc, int64_t movestogo, int64_t movetime,
+             int64_t overhead);
+
+/**
+ * @breif Returns true once a search that started at start_ns has run out of hard time.
+ */
+static inline bool tm_hard_expired(const time_manager_t *tm, uint64_t start_ns, uint64_t now_ns)
+{
+    return tm->active && now_ns - start_ns >= tm->hard_ns;
+}
+
+/**
+ * @breif Learns from a completed iteration and decides whether to start another.
+ *
+ * A best move that keeps changing or a score that has dropped since the early iterations
+ * stretches the soft limit, up to the hard limit. A best move that holds shrinks it.
+ *
+ * @param tm The time manager.
+ * @param depth The depth that was completed.
+ * @param best_move Its best move.
+ * @param score Its score.
+ * @param elapsed_ns The time since the search started.
+ * @return True if the search should stop.
+ */
+bool tm_iteration_done(time_manager_t *tm, int depth, cb_move_t best_move, int score,
+                       uint64_t elapsed_ns);
+
+#endif /* CIBYL_TIMEMAN_H */
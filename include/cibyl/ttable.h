@@ -0,0 +1,144 @@
+
+#ifndef CIBYL_TTABLE_H
+#define CIBYL_TTABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "cb_types.h"
+#include "cibyl.h"
+
+#define TT_BUCKET_ENTRIES 5
+#define TT_DEFAULT_MB 16
+#define TT_MAX_MB 65536
+#define TT_AGE_MASK 0x3F
+
+/* The static eval of an entry written in check, where there is none. */
+#define TT_EVAL_NONE INT16_MIN
+
+/**
+ * @breif The kind of bound that a stored score is.
+ */
+typedef enum {
+    TT_BOUND_NONE = 0,      /**< The slot is empty. */
+    TT_BOUND_UPPER = 1,     /**< The search failed low, the true score is at most this. */
+    TT_BOUND_LOWER = 2,     /**< The search failed high, the true score is at least this. */
+    TT_BOUND_EXACT = 3      /**< The score is exact. */
+} tt_bound_t;
+
+/**
+ * @breif A cache line of slots. A probe only ever touches one bucket.
+ *
+ * The data word of a slot packs the move, the score, the static eval, the depth, the bound and
+ * the age of the search that wrote it. The bucket index already holds the low bits of the
+ * zobrist key, so a slot only keeps the high half, xored with the data word folded to 32 bits.
+ * A slot torn by two threads writing at once no longer matches the key of either position and
+ * reads as a miss. No lock is ever taken. The 12 byte slots fit five to a line where the full
+ * key fit only four.
+ */
+typedef struct {
+    _Alignas(64) _Atomic uint32_t keys[TT_BUCKET_ENTRIES];  /**< Key fragments xored with data. */
+    _Atomic uint64_t data[TT_BUCKET_ENTRIES];               /**< The packed entries. */
+} tt_bucket_t;
+
+/**
+ * @breif An entry unpacked from a slot.
+ */
+typedef struct {
+    cb_move_t move;         /**< The best move found, or CB_INVALID_MOVE. */
+    int16_t score;          /**< The score of the search. */
+    int16_t eval;           /**< The static eval of the position, or TT_EVAL_NONE. */
+    int8_t depth;           /**< The depth that was searched. */
+    uint8_t bound;          /**< The tt_bound_t of the score. */
+} tt_data_t;
+
+/**
+ * @breif Transposition table that contains precalculated positions.
+ *
+ * Shared by every thinker. The buckets are only resized, cleared or aged while no search runs.
+ */
+typedef struct {
+    tt_bucket_t *buckets;   /**< The buckets, aligned to a cache line. */
+    uint64_t mask;          /**< The number of buckets minus one. Always a power of two. */
+    size_t mb;              /**< The size the table was asked to be in megabytes. */
+    uint8_t age;            /**< The age stamped on new entries. Bumped every search. */
+} ttable_t;
+
+/**
+ * @breif Allocates and clears a table.
+ * @param tt The table to initialize.
+ * @param mb The size of the table in megabytes. Rounded down to a power of two buckets.
+ * @return CIBYL_ENOMEM if the table could not be allocated.
+ */
+cibyl_errno_t tt_init(ttable_t *tt, size_t mb);
+
+/**
+ * @breif Frees a table.
+ */
+void tt_free(ttable_t *tt);
+
+/**
+ * @breif Reallocates a table with a new size. Every entry is lost.
+ * @param tt The table to resize.
+ * @param mb The new size in megabytes.
+ * @return CIBYL_ENOMEM if the new table could not be allocated. The old table is kept.
+ */
+cibyl_errno_t tt_resize(ttable_t *tt, size_t mb);
+
+/**
+ * @breif Empties every slot of a table.
+ */
+void tt_clear(ttable_t *tt);
+
+/**
+ * @breif Moves the table on to a new search.
+ *
+ * Entries written before this are not removed but are the first to be replaced, and no longer
+ * count towards tt_hashfull.
+ */
+static inline void tt_age(ttable_t *tt)
+{
+    tt->age = (tt->age + 1) & TT_AGE_MASK;
+}
+
+/**
+ * @breif Hints the cpu to start loading the bucket of a key.
+ */
+static inline void tt_prefetch(const ttable_t *tt, uint64_t key)
+{
+    __builtin_prefetch(&tt->buckets[key & tt->mask]);
+}
+
+/**
+ * @breif Looks up a position.
+ * @param tt The table to search.
+ * @param key The zobrist key of the position.
+ * @param out Populated with the entry on a hit.
+ * @return True on a hit.
+ */
+bool tt_probe(const ttable_t *tt, uint64_t key, tt_data_t *out);
+
+/**
+ * @breif Stores the result of a search.
+ *
+ * An entry for the same position is overwritten unless it holds a much deeper search of the
+ * same age, and keeps its move if the new search has none. Otherwise the slot holding the
+ * oldest and shallowest entry of the bucket is replaced.
+ *
+ * @param tt The table to write to.
+ * @param key The zobrist key of the position.
+ * @param data The entry to store.
+ */
+void tt_store(ttable_t *tt, uint64_t key, const tt_data_t *data);
+
+/**
+ * @breif Estimates how full the table is in permill from the first thousand slots.
+ *
+ * Only entries written since the last call to tt_age are counted, as the UCI hashfull field
+ * expects.
+ */
+int tt_hashfull(const ttable_t *tt);
+
+#endif /* CIBYL_TTABLE_H */
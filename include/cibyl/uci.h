@@ -23,7 +23,8 @@ typedef enum {
 
     /* These are not in the UCI standard but they allow for debugging. */
     DISPLAY,        /**< Displays the board in a nice ascii format. */
-    EVAL            /**< Logs information about evaluation to the console. */
+    EVAL,           /**< Logs information about evaluation to the console. */
+    BENCH           /**< Runs the search benchmarks. */
 } uci_cmd_t;
 
 /**
@@ -46,9 +47,15 @@ typedef enum {
 typedef struct {
     engine_t eng;   /**< The engine itself. */
     bool debug;     /**< Whether or not the engine is in debug mode. */
-    thrd_t mgr;     /**< The file descriptor on which engine messages will be returned. */
+    bool quit;      /**< Set by the quit command. */
+    thrd_t mgr;     /**< The thread that copies engine messages to stdout. */
 } uci_engine_t;
 
+/**
+ * @breif The engine that the UCI commands are applied to.
+ */
+extern uci_engine_t engine;
+
 /**
  * @breif Initializes a UCI chess engine. Performs absolute minimum work.
  * @param engine The engine to initialize.
@@ -0,0 +1,38 @@
+
+#ifndef DBG_EPD_H
+#define DBG_EPD_H
+
+#include "cb_types.h"
+
+#define EPD_MAX_DEPTH 16
+#define EPD_FEN_LEN 128
+
+/**
+ * @breif One line of an EPD perft suite along with the results of running it.
+ */
+typedef struct {
+    char fen[EPD_FEN_LEN];              /**< The position. */
+    uint64_t expected[EPD_MAX_DEPTH];   /**< Expected node counts, indexed by depth - 1. */
+    bool has_expected[EPD_MAX_DEPTH];   /**< Set for each depth the line lists, even as 0. */
+    uint64_t nodes[EPD_MAX_DEPTH];      /**< Counted nodes, indexed by depth - 1. */
+    uint64_t time_ns[EPD_MAX_DEPTH];    /**< Time spent on each depth. */
+    int max_depth;                      /**< The deepest depth with an expected count. */
+    int line;                           /**< The line number in the file. */
+    bool error;                         /**< Set if the position could not be set up. */
+} epd_entry_t;
+
+/**
+ * @breif Runs perft on every position of an EPD file across a pool of threads.
+ *
+ * Each line holds a fen followed by ";D<depth> <nodes>" fields. Every depth up to max_depth
+ * is verified and the failures are summarized once all positions are done. A malformed line
+ * counts as a failure, so a damaged suite cannot pass.
+ *
+ * @param path The path to the EPD file.
+ * @param num_threads The number of worker threads, or 0 for one per online cpu.
+ * @param max_depth The deepest depth to verify, or 0 for all listed depths.
+ * @return Zero if every count matched, 1 on mismatches and a negative number on errors.
+ */
+int epd_perft(const char *path, int num_threads, int max_depth);
+
+#endif /* DBG_EPD_H */
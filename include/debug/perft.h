@@ -4,8 +4,58 @@
 
 #include "cb_types.h"
 
-int perft_cheat(cb_board_t *board, int depth);
-int perft(cb_board_t *board, int depth);
+#define PERFT_STATS_MAX_DEPTH 16
+
+/**
+ * @breif Counters for the different kinds of nodes found at one depth of a perft.
+ */
+typedef struct {
+    uint64_t nodes;         /**< The number of leaf nodes. */
+    uint64_t captures;      /**< Moves that captured a piece, enpassant included. */
+    uint64_t enps;          /**< Enpassant captures. */
+    uint64_t castles;       /**< King and queen side castles. */
+    uint64_t promos;        /**< Promotions, with or without a capture. */
+    uint64_t checks;        /**< Moves that gave check. */
+    uint64_t disc_checks;   /**< Single checks given by a piece that did not move. */
+    uint64_t double_checks; /**< Checks given by two pieces at once. */
+    uint64_t mates;         /**< Checks that left the opponent with no legal moves. */
+} perft_stats_t;
+
+/**
+ * @breif Counts the leaf nodes at a depth without printing anything.
+ *
+ * The caller must reserve space for depth moves on the history stack beforehand.
+ *
+ * @param board The board to count from. It is restored before returning.
+ * @param depth The depth to count to.
+ * @return The number of leaf nodes.
+ */
+uint64_t perft_count(cb_board_t *board, int depth);
+
+/**
+ * @breif Same as perft_count but walks the tree with the pseudo-legal generator.
+ *
+ * Every generated move is passed through cb_is_legal, so the counts match perft_count.
+ */
+uint64_t perft_count_pseudo(cb_board_t *board, int depth);
+
+/*
+ * The interactive perfts print a per-move breakdown and store the total node count in nodes.
+ * nodes is left untouched if the perft did not run.
+ */
+int perft_stats(cb_board_t *board, int depth, uint64_t *nodes);
+int perft_cheat(cb_board_t *board, int depth, uint64_t *nodes);
+int perft_pseudo(cb_board_t *board, int depth, uint64_t *nodes);
+int perft(cb_board_t *board, int depth, uint64_t *nodes);
+
+/**
+ * @breif Checks cb_gen_noisy_and_checks against the full move list at every node of a perft.
+ *
+ * The expected moves are the captures and promotions of cb_gen_moves, plus the quiet moves
+ * that leave the opponent in check once made. Each mismatch prints the line leading to it.
+ * nodes is set to the number of positions checked.
+ */
+int perft_noisy(cb_board_t *board, int depth, uint64_t *nodes);
 
 #endif /* DBG_PERFT_H */
 
@@ -0,0 +1,28 @@
+
+#ifndef DBG_UNIQ_H
+#define DBG_UNIQ_H
+
+#include "cb_types.h"
+
+/* The depth is kept in the low bits of each stored key. */
+#define UNIQ_MAX_DEPTH 15
+#define UNIQ_DEFAULT_MB 256
+
+/**
+ * @breif Counts the distinct positions reachable at every depth up to a limit.
+ *
+ * The tree is walked once and the zobrist key of every node goes into an open addressed hash
+ * set. A node that is already in the set is a transposition, so its subtree is not walked again.
+ * When the set fills up its keys are sorted and spilled to a temporary file, and the runs are
+ * merged at the end. The memory limit only bounds the set; the spilled runs live on disk.
+ *
+ * Two positions with the same 60 bit key are counted once.
+ *
+ * @param board The board to walk from. It is restored before returning.
+ * @param depth The deepest depth to count, at most UNIQ_MAX_DEPTH.
+ * @param mem_mb The memory limit of the set in MB.
+ * @return Zero on success, nonzero on errors.
+ */
+int uniq_count(cb_board_t *board, int depth, size_t mem_mb);
+
+#endif /* DBG_UNIQ_H */
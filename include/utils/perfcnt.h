@@ -0,0 +1,250 @@
+
+#ifndef PERFCNT_H
+#define PERFCNT_H
+
+/*
+ * Optional hardware performance counters around a region of code.
+ *
+ * On Linux the counters are opened with perf_event_open for the calling thread, and optionally
+ * for the threads it creates after. Any counter the kernel refuses (no PMU in a VM,
+ * perf_event_paranoid, seccomp, ...) is simply reported as unavailable. On other platforms
+ * every counter is unavailable.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/**
+ * @breif The counters that are collected.
+ */
+typedef enum {
+    PERFCNT_CYCLES = 0,
+    PERFCNT_INSTRUCTIONS,
+    PERFCNT_BRANCHES,
+    PERFCNT_BRANCH_MISSES,
+    PERFCNT_L1D_MISSES,
+    PERFCNT_LLC_MISSES,
+    PERFCNT_NUM_EVENTS
+} perfcnt_event_t;
+
+/**
+ * @breif A set of open counters and their last readings.
+ */
+typedef struct {
+    int fd[PERFCNT_NUM_EVENTS];             /**< File descriptors, -1 when unavailable. */
+    uint64_t value[PERFCNT_NUM_EVENTS];     /**< Values scaled for multiplexing. */
+} perfcnt_t;
+
+static const char *const PERFCNT_NAMES[PERFCNT_NUM_EVENTS] = {
+    "cycles", "instructions", "branches", "branch-misses", "L1D-misses", "LLC-misses"
+};
+
+#ifdef __linux__
+static inline int perfcnt_open_one(uint32_t type, uint64_t config, bool inherit)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = inherit;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/**
+ * @breif Initializes a counter set with every counter closed. Start and stop are no-ops on it.
+ */
+static inline void perfcnt_init(perfcnt_t *pc)
+{
+    int i;
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        pc->fd[i] = -1;
+        pc->value[i] = 0;
+    }
+}
+
+/**
+ * @breif Opens every counter that the platform allows.
+ * @param pc The counter set to open.
+ * @param inherit Also count the threads that the calling thread creates after the call.
+ * @return The number of counters that could be opened.
+ */
+static inline int perfcnt_open_threads(perfcnt_t *pc, bool inherit)
+{
+    int opened = 0;
+    int i;
+
+    perfcnt_init(pc);
+
+#ifdef __linux__
+    pc->fd[PERFCNT_CYCLES] = perfcnt_open_one(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+            inherit);
+    pc->fd[PERFCNT_INSTRUCTIONS] = perfcnt_open_one(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_INSTRUCTIONS, inherit);
+    pc->fd[PERFCNT_BRANCHES] = perfcnt_open_one(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_BRANCH_INSTRUCTIONS, inherit);
+    pc->fd[PERFCNT_BRANCH_MISSES] = perfcnt_open_one(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_BRANCH_MISSES, inherit);
+    pc->fd[PERFCNT_L1D_MISSES] = perfcnt_open_one(PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), inherit);
+    pc->fd[PERFCNT_LLC_MISSES] = perfcnt_open_one(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_CACHE_MISSES, inherit);
+#else
+    (void)inherit;
+#endif
+
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++)
+        opened += pc->fd[i] >= 0;
+    return opened;
+}
+
+/**
+ * @breif Opens every counter that the platform allows for the calling thread only.
+ * @param pc The counter set to open.
+ * @return The number of counters that could be opened.
+ */
+static inline int perfcnt_open(perfcnt_t *pc)
+{
+    return perfcnt_open_threads(pc, false);
+}
+
+/**
+ * @breif Resets and starts all of the open counters.
+ */
+static inline void perfcnt_start(perfcnt_t *pc)
+{
+#ifdef __linux__
+    int i;
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        if (pc->fd[i] < 0)
+            continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/**
+ * @breif Pauses all of the open counters without reading or resetting them.
+ */
+static inline void perfcnt_pause(perfcnt_t *pc)
+{
+#ifdef __linux__
+    int i;
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        if (pc->fd[i] >= 0)
+            ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+}
+
+/**
+ * @breif Resumes all of the open counters from where perfcnt_pause left them.
+ */
+static inline void perfcnt_resume(perfcnt_t *pc)
+{
+#ifdef __linux__
+    int i;
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        if (pc->fd[i] >= 0)
+            ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/**
+ * @breif Stops all of the open counters and reads their values.
+ *
+ * Counters that were multiplexed with others are scaled up to the full enabled time.
+ * A counter that fails to read is closed and reported as unavailable from then on.
+ */
+static inline void perfcnt_stop(perfcnt_t *pc)
+{
+#ifdef __linux__
+    uint64_t buf[3];
+    int i;
+
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        if (pc->fd[i] < 0)
+            continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(pc->fd[i], buf, sizeof(buf)) != sizeof(buf)) {
+            close(pc->fd[i]);
+            pc->fd[i] = -1;
+            continue;
+        }
+        pc->value[i] = buf[2] == 0 ? 0 : (uint64_t)((double)buf[0] * buf[1] / buf[2]);
+    }
+#endif
+}
+
+/**
+ * @breif Closes all of the open counters.
+ */
+static inline void perfcnt_close(perfcnt_t *pc)
+{
+#ifdef __linux__
+    int i;
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        if (pc->fd[i] >= 0)
+            close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+#endif
+}
+
+/**
+ * @breif Returns true if the counter produced a reading.
+ */
+static inline bool perfcnt_has(const perfcnt_t *pc, perfcnt_event_t ev)
+{
+    return pc->fd[ev] >= 0;
+}
+
+/**
+ * @breif Prints the readings of the last run along with per-node ratios.
+ * @param f The file pointer to print to.
+ * @param pc The counters to print.
+ * @param nodes The number of nodes visited while the counters ran.
+ */
+static inline void perfcnt_print(FILE *f, const perfcnt_t *pc, uint64_t nodes)
+{
+    int i;
+
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        if (!perfcnt_has(pc, i)) {
+            fprintf(f, "%-14s %16s\n", PERFCNT_NAMES[i], "n/a");
+            continue;
+        }
+        fprintf(f, "%-14s %16llu  %10.3f/node\n", PERFCNT_NAMES[i],
+                (unsigned long long)pc->value[i],
+                nodes == 0 ? 0.0 : (double)pc->value[i] / nodes);
+    }
+
+    if (perfcnt_has(pc, PERFCNT_CYCLES) && perfcnt_has(pc, PERFCNT_INSTRUCTIONS)
+            && pc->value[PERFCNT_CYCLES] != 0)
+        fprintf(f, "%-14s %16.3f\n", "IPC",
+                (double)pc->value[PERFCNT_INSTRUCTIONS] / pc->value[PERFCNT_CYCLES]);
+    if (perfcnt_has(pc, PERFCNT_BRANCHES) && perfcnt_has(pc, PERFCNT_BRANCH_MISSES)
+            && pc->value[PERFCNT_BRANCHES] != 0)
+        fprintf(f, "%-14s %15.3f%%\n", "branch-miss",
+                100.0 * pc->value[PERFCNT_BRANCH_MISSES] / pc->value[PERFCNT_BRANCHES]);
+}
+
+#endif /* PERFCNT_H */
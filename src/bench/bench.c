@@ -0,0 +1,58 @@
+
+#define _GNU_SOURCE
+#include <sched.h>
+
+#include "bench.h"
+
+volatile uint64_t bench_sink;
+
+const char *const BENCH_POSITIONS[BENCH_NUM_POSITIONS] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+};
+
+const int BENCH_SHORT_DEPTHS[BENCH_NUM_POSITIONS] = { 6, 5, 7, 6, 6, 5, 5 };
+
+const uint64_t BENCH_SHORT_RESULTS[BENCH_NUM_POSITIONS] = {
+    UINT64_C(119060324),
+    UINT64_C(193690690),
+    UINT64_C(178633661),
+    UINT64_C(706045033),
+    UINT64_C(706045033),
+    UINT64_C(89941194),
+    UINT64_C(164075551)
+};
+
+const int BENCH_FULL_DEPTHS[BENCH_NUM_POSITIONS] = { 8, 6, 8, 6, 6, 5, 7 };
+
+const uint64_t BENCH_FULL_RESULTS[BENCH_NUM_POSITIONS] = {
+    UINT64_C(84998978956),
+    UINT64_C(8031647685),
+    UINT64_C(3009794393),
+    UINT64_C(706045033),
+    UINT64_C(706045033),
+    UINT64_C(89941194),
+    UINT64_C(287188994746)
+};
+
+int bench_pin_thread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (cpu < 0 && (cpu = sched_getcpu()) < 0)
+        return -1;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        return -1;
+    return cpu;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,247 @@
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "cb_lib.h"
+#include "cb_move.h"
+#include "cb_tables.h"
+#include "bench.h"
+#include "crosstime.h"
+
+/*
+ * Move generation throughput with many engine processes sharing the caches.
+ *
+ * Every process walks the bench positions generating moves at each node. After each node it
+ * touches a few random cache lines of a private buffer, standing in for the transposition table
+ * and evaluation state of a real engine. Together with the number of processes this sets how much
+ * of L2 and the LLC is left for the sliding attack tables. Run the same sweep with both values of
+ * CB_TABLELESS_SLIDERS to see where each backend wins.
+ */
+
+#define FEN_BUF_LEN 128
+#define CACHE_LINE 64
+#define DEFAULT_DEPTH 4
+#define DEFAULT_POLLUTE_KB 1024
+#define DEFAULT_LINES 8
+
+/**
+ * @breif The private memory that is touched between nodes.
+ */
+typedef struct {
+    uint8_t *data;      /**< The buffer. */
+    size_t num_lines;   /**< The number of cache lines in the buffer. */
+    int touches;        /**< Cache lines touched per node. */
+    uint64_t rng;       /**< Xorshift state for picking lines. */
+} polluter_t;
+
+/**
+ * @breif What a worker process reports back to the parent.
+ */
+typedef struct {
+    uint64_t nodes;     /**< Nodes visited. */
+    uint64_t time_ns;   /**< Time spent walking. */
+} worker_result_t;
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-j <procs>] [-m <kb>] [-l <lines>] [-d <depth>]\n"
+            "  -j    Number of processes (default: online cpus).\n"
+            "  -m    Private buffer per process in KB (default %d, 0 disables).\n"
+            "  -l    Cache lines of the buffer touched per node (default %d).\n"
+            "  -d    Depth to walk each position to (default %d).\n",
+            prog, DEFAULT_POLLUTE_KB, DEFAULT_LINES, DEFAULT_DEPTH);
+}
+
+static inline void pollute(polluter_t *p)
+{
+    int i;
+    size_t line;
+
+    if (p->num_lines == 0)
+        return;
+    for (i = 0; i < p->touches; i++) {
+        p->rng ^= p->rng << 13;
+        p->rng ^= p->rng >> 7;
+        p->rng ^= p->rng << 17;
+        line = p->rng % p->num_lines;
+        p->data[line * CACHE_LINE]++;
+    }
+}
+
+uint64_t walk(cb_board_t *board, polluter_t *p, int depth)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    uint64_t nodes = 1;
+    int i;
+
+    cb_gen_board_tables(&state, board);
+    cb_gen_moves(&mvlst, board, &state);
+    pollute(p);
+
+    if (depth <= 1)
+        return nodes + cb_mvlst_size(&mvlst);
+
+    for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
+        cb_make(board, cb_mvlst_at(&mvlst, i));
+        nodes += walk(board, p, depth - 1);
+        cb_unmake(board);
+    }
+
+    return nodes;
+}
+
+int run_worker(worker_result_t *res, int id, size_t pollute_kb, int touches, int depth)
+{
+    cb_board_t board;
+    cb_error_t err;
+    polluter_t p;
+    char fen_buf[FEN_BUF_LEN];
+    uint64_t start_time;
+    int result = 0;
+    int i;
+
+    /* Touch the whole buffer once so that page faults stay out of the timing. */
+    p.num_lines = pollute_kb * 1024 / CACHE_LINE;
+    p.touches = touches;
+    p.rng = UINT64_C(0x9E3779B97F4A7C15) * (id + 1);
+    if ((p.data = malloc(p.num_lines * CACHE_LINE + 1)) == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    memset(p.data, 0, p.num_lines * CACHE_LINE + 1);
+
+    /* Separate engine processes each have their own copy of the tables, so build them after
+     * the fork instead of sharing the parent's pages. */
+    if (cb_tables_init(&err) != 0) {
+        fprintf(stderr, "cb_tables_init: %s\n", err.desc);
+        result = -1;
+        goto out_free_data;
+    }
+    if (cb_board_init(&err, &board) != 0) {
+        fprintf(stderr, "cb_board_init: %s\n", err.desc);
+        result = -1;
+        goto out_free_tables;
+    }
+
+    res->nodes = 0;
+    start_time = time_ns();
+    for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+        strncpy(fen_buf, BENCH_POSITIONS[i], FEN_BUF_LEN - 1);
+        fen_buf[FEN_BUF_LEN - 1] = '\0';
+        if (cb_board_from_fen(&err, &board, fen_buf) != 0
+                || cb_reserve_for_make(&err, &board, depth) != 0) {
+            fprintf(stderr, "%s: %s\n", BENCH_POSITIONS[i], err.desc);
+            result = -1;
+            goto out_free_board;
+        }
+        res->nodes += walk(&board, &p, depth);
+    }
+    res->time_ns = time_ns() - start_time;
+    bench_sink ^= p.data[0];
+
+out_free_board:
+    cb_board_free(&board);
+out_free_tables:
+    cb_tables_free();
+out_free_data:
+    free(p.data);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    worker_result_t res;
+    worker_result_t *results;
+    int *fds;
+    pid_t pid;
+    long procs = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t pollute_kb = DEFAULT_POLLUTE_KB;
+    int touches = DEFAULT_LINES;
+    int depth = DEFAULT_DEPTH;
+    uint64_t start_time, wall_ns;
+    uint64_t total_nodes = 0;
+    double per_proc_nps = 0;
+    int status;
+    int failed = 0;
+    int pipefd[2];
+    int i;
+
+    /* Parse the arguments. */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            procs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            pollute_kb = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            touches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (procs < 1)
+        procs = 1;
+    if (depth < 1)
+        depth = 1;
+
+    if ((results = calloc(procs, sizeof(worker_result_t))) == NULL
+            || (fds = calloc(procs, sizeof(int))) == NULL) {
+        perror("calloc");
+        return 2;
+    }
+
+    /* Start every worker with a pipe to report back on. */
+    start_time = time_ns();
+    for (i = 0; i < procs; i++) {
+        if (pipe(pipefd) != 0 || (pid = fork()) < 0) {
+            perror("fork");
+            return 2;
+        }
+        if (pid == 0) {
+            close(pipefd[0]);
+            if (run_worker(&res, i, pollute_kb, touches, depth) != 0)
+                _exit(1);
+            _exit(write(pipefd[1], &res, sizeof(res)) == sizeof(res) ? 0 : 1);
+        }
+        close(pipefd[1]);
+        fds[i] = pipefd[0];
+    }
+
+    /* Collect the results. */
+    for (i = 0; i < procs; i++) {
+        if (read(fds[i], &results[i], sizeof(worker_result_t)) != sizeof(worker_result_t))
+            failed++;
+        close(fds[i]);
+    }
+    while (wait(&status) > 0) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+    }
+    wall_ns = time_ns() - start_time;
+
+    for (i = 0; i < procs; i++) {
+        total_nodes += results[i].nodes;
+        if (results[i].time_ns != 0)
+            per_proc_nps += results[i].nodes * 1.0e9 / results[i].time_ns;
+    }
+
+    printf("Backend: %s\n", CB_SLIDER_BACKEND);
+    printf("Processes: %ld\n", procs);
+    printf("Buffer per process: %zuKB, %d lines per node\n", pollute_kb, touches);
+    printf("Nodes searched: %" PRIu64 "\n", total_nodes);
+    printf("Time: %.3fms\n", wall_ns / 1.0e6);
+    printf("Aggregate NPS: %.0f\n", wall_ns == 0 ? 0.0 : total_nodes * 1.0e9 / wall_ns);
+    printf("Per-process NPS: %.0f\n", per_proc_nps / procs);
+
+    free(fds);
+    free(results);
+    return failed != 0;
+}
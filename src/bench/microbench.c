@@ -0,0 +1,531 @@
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "cb_lib.h"
+#include "cb_move.h"
+#include "cb_tables.h"
+#include "cb_bitutil.h"
+#include "bench.h"
+#include "crosstime.h"
+
+#define FEN_BUF_LEN 128
+#define DEFAULT_STREAM_DEPTH 3
+#define DEFAULT_REPEATS 3
+#define LOOKUP_BATCH 64
+
+/* Marks an unmake in a recorded stream. Never produced by the move generator. */
+#define STREAM_UNMAKE CB_INVALID_MOVE
+
+/**
+ * @breif A recorded depth first walk of the tree below one position.
+ *
+ * Every entry is either a move to make or STREAM_UNMAKE. Replaying the stream from the
+ * position visits the same boards in the same order every time.
+ */
+typedef struct {
+    const char *fen;    /**< The root position of the walk. */
+    cb_move_t *ops;     /**< The make and unmake operations. */
+    size_t len;         /**< The number of operations. */
+    size_t cap;         /**< The allocated number of operations. */
+} mv_stream_t;
+
+/**
+ * @breif Inputs for one attack mask lookup gathered from a recorded position.
+ */
+typedef struct {
+    uint64_t occ;       /**< The occupancy at the time. */
+    uint8_t sq;         /**< The square that is looked up. */
+    uint8_t color;      /**< The color of the piece on the square. */
+} lookup_t;
+
+/**
+ * @breif Growable list of lookup inputs.
+ */
+typedef struct {
+    lookup_t *data;     /**< The lookups. */
+    size_t len;         /**< The number of lookups. */
+    size_t cap;         /**< The allocated number of lookups. */
+} lookup_set_t;
+
+/**
+ * @breif Growable list of per call timings.
+ */
+typedef struct {
+    uint32_t *data;     /**< Cycles per call. */
+    size_t len;         /**< The number of samples. */
+    size_t cap;         /**< The allocated number of samples. */
+} samples_t;
+
+/* Timing overhead of an empty measurement. Subtracted from every sample. */
+uint64_t timer_overhead;
+
+/* Nanoseconds per cycle of bench_cycles, calibrated against time_ns. */
+double ns_per_cycle;
+
+int grow(void **data, size_t *cap, size_t len, size_t ele_size)
+{
+    void *new_data;
+    size_t new_cap;
+
+    if (len < *cap)
+        return 0;
+    new_cap = *cap == 0 ? 4096 : *cap * 2;
+    if ((new_data = realloc(*data, new_cap * ele_size)) == NULL)
+        return -1;
+    *data = new_data;
+    *cap = new_cap;
+    return 0;
+}
+
+static inline void samples_push(samples_t *samples, uint64_t cycles)
+{
+    if (grow((void **)&samples->data, &samples->cap, samples->len, sizeof(uint32_t)) != 0) {
+        perror("realloc");
+        exit(2);
+    }
+    cycles = cycles > timer_overhead ? cycles - timer_overhead : 0;
+    samples->data[samples->len++] = cycles > UINT32_MAX ? UINT32_MAX : cycles;
+}
+
+int load_position(cb_board_t *board, const char *fen, int depth)
+{
+    cb_errno_t result;
+    cb_error_t err;
+    char fen_buf[FEN_BUF_LEN];
+
+    strncpy(fen_buf, fen, FEN_BUF_LEN - 1);
+    fen_buf[FEN_BUF_LEN - 1] = '\0';
+    if ((result = cb_board_from_fen(&err, board, fen_buf)) != 0) {
+        fprintf(stderr, "cb_board_from_fen: %s\n", err.desc);
+        return result;
+    }
+    if ((result = cb_reserve_for_make(&err, board, depth)) != 0) {
+        fprintf(stderr, "cb_reserve_for_make: %s\n", err.desc);
+        return result;
+    }
+    return 0;
+}
+
+int record_stream(mv_stream_t *stream, lookup_set_t *lookups, cb_board_t *board, int depth)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    uint64_t pieces = board->bb.occ;
+    uint8_t sq;
+    int i;
+
+    /* Record a lookup for every piece on the board. */
+    while (pieces) {
+        sq = pop_rbit(&pieces);
+        if (grow((void **)&lookups->data, &lookups->cap, lookups->len, sizeof(lookup_t)) != 0)
+            return -1;
+        lookups->data[lookups->len].sq = sq;
+        lookups->data[lookups->len].occ = board->bb.occ;
+        lookups->data[lookups->len].color = (board->bb.color[CB_WHITE] >> sq) & 1;
+        lookups->len++;
+    }
+
+    if (depth <= 0)
+        return 0;
+
+    cb_gen_board_tables(&state, board);
+    cb_gen_moves(&mvlst, board, &state);
+    for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
+        if (grow((void **)&stream->ops, &stream->cap, stream->len + 1, sizeof(cb_move_t)) != 0)
+            return -1;
+        stream->ops[stream->len++] = cb_mvlst_at(&mvlst, i);
+        cb_make(board, cb_mvlst_at(&mvlst, i));
+        if (record_stream(stream, lookups, board, depth - 1) != 0)
+            return -1;
+        cb_unmake(board);
+        stream->ops[stream->len++] = STREAM_UNMAKE;
+    }
+
+    return 0;
+}
+
+/**
+ * Measures the cost of an empty measurement and the length of a cycle in nanoseconds.
+ */
+void calibrate()
+{
+    uint64_t best = UINT64_MAX;
+    uint64_t start_cycles, start_ns, t;
+    int i;
+
+    for (i = 0; i < 10000; i++) {
+        t = bench_cycles();
+        t = bench_cycles() - t;
+        best = t < best ? t : best;
+    }
+    timer_overhead = best;
+
+    start_ns = time_ns();
+    start_cycles = bench_cycles();
+    while (time_ns() - start_ns < 100000000)
+        ;
+    ns_per_cycle = (double)(time_ns() - start_ns) / (bench_cycles() - start_cycles);
+}
+
+void bench_make(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        t = bench_cycles();
+        cb_make(board, stream->ops[i]);
+        bench_escape(board);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+void bench_unmake(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] != STREAM_UNMAKE) {
+            cb_make(board, stream->ops[i]);
+            continue;
+        }
+        t = bench_cycles();
+        cb_unmake(board);
+        bench_escape(board);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+void bench_tables(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    cb_state_tables_t state;
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        cb_make(board, stream->ops[i]);
+        t = bench_cycles();
+        cb_gen_board_tables(&state, board);
+        bench_escape(&state);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+void bench_gen(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        cb_make(board, stream->ops[i]);
+        cb_gen_board_tables(&state, board);
+        t = bench_cycles();
+        cb_gen_moves(&mvlst, board, &state);
+        bench_escape(&mvlst);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+void bench_pseudo_tables(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    cb_pseudo_tables_t pstate;
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        cb_make(board, stream->ops[i]);
+        t = bench_cycles();
+        cb_gen_pseudo_tables(&pstate, board);
+        bench_escape(&pstate);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+void bench_pseudo_gen(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    cb_pseudo_tables_t pstate;
+    cb_mvlst_t mvlst;
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        cb_make(board, stream->ops[i]);
+        cb_gen_pseudo_tables(&pstate, board);
+        t = bench_cycles();
+        cb_gen_pseudo_moves(&mvlst, board, &pstate);
+        bench_escape(&mvlst);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+/* Times the legality test of every pseudo-legal move of a node as one sample. */
+void bench_is_legal(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    cb_pseudo_tables_t pstate;
+    cb_mvlst_t mvlst;
+    uint64_t legal;
+    uint64_t t;
+    size_t i;
+    int j;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        cb_make(board, stream->ops[i]);
+        cb_gen_pseudo_tables(&pstate, board);
+        cb_gen_pseudo_moves(&mvlst, board, &pstate);
+        legal = 0;
+        t = bench_cycles();
+        for (j = 0; j < cb_mvlst_size(&mvlst); j++)
+            legal += cb_is_legal(board, &pstate, cb_mvlst_at(&mvlst, j));
+        bench_escape(&legal);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+/*
+ * The two node benches time everything a node needs to produce its legal moves, which is
+ * what a search pays per node when it ends up trying every move.
+ */
+void bench_legal_node(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    uint64_t t;
+    size_t i;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        cb_make(board, stream->ops[i]);
+        t = bench_cycles();
+        cb_gen_board_tables(&state, board);
+        cb_gen_moves(&mvlst, board, &state);
+        bench_escape(&mvlst);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+void bench_pseudo_node(samples_t *samples, cb_board_t *board, mv_stream_t *stream)
+{
+    cb_pseudo_tables_t pstate;
+    cb_mvlst_t mvlst;
+    uint64_t legal;
+    uint64_t t;
+    size_t i;
+    int j;
+
+    for (i = 0; i < stream->len; i++) {
+        if (stream->ops[i] == STREAM_UNMAKE) {
+            cb_unmake(board);
+            continue;
+        }
+        cb_make(board, stream->ops[i]);
+        legal = 0;
+        t = bench_cycles();
+        cb_gen_pseudo_tables(&pstate, board);
+        cb_gen_pseudo_moves(&mvlst, board, &pstate);
+        for (j = 0; j < cb_mvlst_size(&mvlst); j++)
+            legal += cb_is_legal(board, &pstate, cb_mvlst_at(&mvlst, j));
+        bench_escape(&legal);
+        samples_push(samples, bench_cycles() - t);
+    }
+}
+
+/* Lookups are too cheap to time one at a time so they are timed in batches. */
+#define BENCH_LOOKUP(name, expr)                                                    \
+void name(samples_t *samples, lookup_set_t *lookups)                                \
+{                                                                                   \
+    uint64_t acc = 0;                                                               \
+    uint64_t t;                                                                     \
+    size_t i, j;                                                                    \
+                                                                                    \
+    for (i = 0; i + LOOKUP_BATCH <= lookups->len; i += LOOKUP_BATCH) {              \
+        t = bench_cycles();                                                         \
+        for (j = i; j < i + LOOKUP_BATCH; j++)                                      \
+            acc ^= (expr);                                                          \
+        bench_escape(&acc);                                                         \
+        samples_push(samples, bench_cycles() - t);                                  \
+    }                                                                               \
+    bench_sink ^= acc;                                                              \
+}
+
+BENCH_LOOKUP(bench_bishop, cb_read_bishop_atk_msk(lookups->data[j].sq, lookups->data[j].occ))
+BENCH_LOOKUP(bench_rook, cb_read_rook_atk_msk(lookups->data[j].sq, lookups->data[j].occ))
+BENCH_LOOKUP(bench_pawn, cb_read_pawn_atk_msk(lookups->data[j].sq, lookups->data[j].color))
+BENCH_LOOKUP(bench_knight, cb_read_knight_atk_msk(lookups->data[j].sq))
+BENCH_LOOKUP(bench_king, cb_read_king_atk_msk(lookups->data[j].sq))
+
+int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+void report(const char *name, samples_t *samples, int per_sample)
+{
+    double mean = 0;
+    double pct[4];
+    const double PCTS[4] = { 0.50, 0.90, 0.99, 0.999 };
+    size_t i;
+
+    if (samples->len == 0)
+        return;
+
+    qsort(samples->data, samples->len, sizeof(uint32_t), cmp_u32);
+    for (i = 0; i < samples->len; i++)
+        mean += samples->data[i];
+    mean /= (double)samples->len * per_sample;
+    for (i = 0; i < 4; i++)
+        pct[i] = (double)samples->data[(size_t)(PCTS[i] * (samples->len - 1))] / per_sample;
+
+    printf("%-22s %10zu %9.1f %9.1f %9.1f %9.1f %9.1f %9.2f %9.2f %9.2f\n", name,
+           samples->len * per_sample, mean, pct[0], pct[1], pct[2], pct[3],
+           mean * ns_per_cycle, pct[0] * ns_per_cycle, pct[2] * ns_per_cycle);
+    samples->len = 0;
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-d <depth>] [-n <repeats>] [-c <cpu>]\n"
+            "  -d    Depth of the recorded walks (default %d).\n"
+            "  -n    Number of times each stream is replayed (default %d).\n"
+            "  -c    Cpu to pin the benchmark to (default: the current one).\n",
+            prog, DEFAULT_STREAM_DEPTH, DEFAULT_REPEATS);
+}
+
+int main(int argc, char *argv[])
+{
+    typedef void (*stream_bench_t)(samples_t *, cb_board_t *, mv_stream_t *);
+    typedef void (*lookup_bench_t)(samples_t *, lookup_set_t *);
+
+    const char *STREAM_NAMES[] = { "cb_make", "cb_unmake", "cb_gen_board_tables",
+        "cb_gen_moves", "cb_gen_pseudo_tables", "cb_gen_pseudo_moves", "cb_is_legal (node)",
+        "legal node", "pseudo node" };
+    const stream_bench_t STREAM_BENCHES[] = { bench_make, bench_unmake, bench_tables, bench_gen,
+        bench_pseudo_tables, bench_pseudo_gen, bench_is_legal, bench_legal_node,
+        bench_pseudo_node };
+    const char *LOOKUP_NAMES[] = { "bishop_atk_msk", "rook_atk_msk", "pawn_atk_msk",
+        "knight_atk_msk", "king_atk_msk" };
+    const lookup_bench_t LOOKUP_BENCHES[] = { bench_bishop, bench_rook, bench_pawn,
+        bench_knight, bench_king };
+
+    mv_stream_t streams[BENCH_NUM_POSITIONS];
+    lookup_set_t lookups;
+    samples_t samples;
+    cb_board_t board;
+    cb_error_t err;
+    int depth = DEFAULT_STREAM_DEPTH;
+    int repeats = DEFAULT_REPEATS;
+    int cpu = -1;
+    int result = 0;
+    int i, j, r;
+
+    /* Parse the arguments. */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if ((cpu = bench_pin_thread(cpu)) < 0)
+        fprintf(stderr, "warning: could not pin the benchmark thread\n");
+
+    if (cb_tables_init(&err) != 0) {
+        fprintf(stderr, "cb_tables_init: %s\n", err.desc);
+        return 2;
+    }
+    if (cb_board_init(&err, &board) != 0) {
+        fprintf(stderr, "cb_board_init: %s\n", err.desc);
+        result = 2;
+        goto out_free_tables;
+    }
+
+    /* Record the streams up front so every primitive replays the exact same work. */
+    memset(streams, 0, sizeof(streams));
+    memset(&lookups, 0, sizeof(lookups));
+    memset(&samples, 0, sizeof(samples));
+    for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+        streams[i].fen = BENCH_POSITIONS[i];
+        if (load_position(&board, streams[i].fen, depth + 1) != 0
+                || record_stream(&streams[i], &lookups, &board, depth) != 0) {
+            fprintf(stderr, "failed to record the stream for %s\n", streams[i].fen);
+            result = 2;
+            goto out_free_streams;
+        }
+    }
+
+    calibrate();
+    printf("cpu %d, stream depth %d, %zu lookups, timer overhead %" PRIu64 " cycles, "
+           "%.4f ns/cycle\n\n", cpu, depth, lookups.len, timer_overhead, ns_per_cycle);
+    printf("%-22s %10s %9s %9s %9s %9s %9s %9s %9s %9s\n", "primitive", "calls", "cyc/mean",
+           "cyc/p50", "cyc/p90", "cyc/p99", "cyc/p99.9", "ns/mean", "ns/p50", "ns/p99");
+
+    for (j = 0; j < (int)(sizeof(STREAM_BENCHES) / sizeof(STREAM_BENCHES[0])); j++) {
+        for (r = 0; r < repeats; r++) {
+            for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+                if (load_position(&board, streams[i].fen, depth + 1) != 0) {
+                    result = 2;
+                    goto out_free_streams;
+                }
+                STREAM_BENCHES[j](&samples, &board, &streams[i]);
+            }
+        }
+        report(STREAM_NAMES[j], &samples, 1);
+    }
+
+    for (j = 0; j < 5; j++) {
+        for (r = 0; r < repeats; r++)
+            LOOKUP_BENCHES[j](&samples, &lookups);
+        report(LOOKUP_NAMES[j], &samples, LOOKUP_BATCH);
+    }
+
+out_free_streams:
+    for (i = 0; i < BENCH_NUM_POSITIONS; i++)
+        free(streams[i].ops);
+    free(lookups.data);
+    free(samples.data);
+    cb_board_free(&board);
+out_free_tables:
+    cb_tables_free();
+    return result;
+}
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <threads.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "cb_lib.h"
+#include "cb_tables.h"
+#include "perft.h"
+#include "bench.h"
+#include "crosstime.h"
+
+/*
+ * Move generation throughput with a thread on every cpu, reading the tables either from the
+ * master copy or from the copy on the thread's own NUMA node.
+ *
+ * The master copy lives wherever the main thread first touched it, so in the shared run the
+ * threads on every other node pay remote latency on each table miss. The replicated run binds
+ * every thread to its local copy with cb_tables_bind_thread. On a single node host pass -N to
+ * force a number of copies; the numbers then only show the cost of the indirection.
+ */
+
+#define FEN_BUF_LEN 128
+#define DEFAULT_DEPTH 4
+#define MAX_NODES 64
+
+/**
+ * @breif The work and the results of one thread.
+ */
+typedef struct {
+    int cpu;            /**< The cpu the thread is pinned to. */
+    int depth;          /**< The perft depth of every position. */
+    bool replicated;    /**< Read the local copy of the tables. */
+    int node;           /**< The node of the copy that was read, -1 for the master. */
+    uint64_t nodes;     /**< Perft nodes counted. */
+    uint64_t time_ns;   /**< Wall time of the walk. */
+    int result;         /**< Nonzero if the thread failed. */
+} worker_t;
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-j <threads>] [-d <depth>] [-N <copies>]\n"
+            "  -j    Number of threads, one per cpu (default: online cpus).\n"
+            "  -d    Perft depth of each bench position (default %d).\n"
+            "  -N    Number of table copies to make (default: one per online node).\n",
+            prog, DEFAULT_DEPTH);
+}
+
+int worker_entry(void *arg)
+{
+    worker_t *w = arg;
+    char fen_buf[FEN_BUF_LEN];
+    cb_board_t board;
+    cb_error_t err;
+    uint64_t start;
+    int i;
+
+    if (bench_pin_thread(w->cpu) < 0)
+        fprintf(stderr, "warning: could not pin a thread to cpu %d\n", w->cpu);
+    w->node = w->replicated ? cb_tables_bind_thread() : cb_tables_bind_node(-1);
+
+    if (cb_board_init(&err, &board) != 0) {
+        fprintf(stderr, "cb_board_init: %s\n", err.desc);
+        return w->result = 2;
+    }
+
+    start = time_ns();
+    for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+        strncpy(fen_buf, BENCH_POSITIONS[i], FEN_BUF_LEN - 1);
+        fen_buf[FEN_BUF_LEN - 1] = '\0';
+        if (cb_board_from_fen(&err, &board, fen_buf) != 0
+                || cb_reserve_for_make(&err, &board, w->depth) != 0) {
+            fprintf(stderr, "failed to load %s: %s\n", BENCH_POSITIONS[i], err.desc);
+            w->result = 2;
+            break;
+        }
+        w->nodes += perft_count(&board, w->depth);
+    }
+    w->time_ns = time_ns() - start;
+
+    cb_board_free(&board);
+    return w->result;
+}
+
+/**
+ * Runs one worker per cpu and prints the throughput of each node.
+ */
+int run(worker_t *workers, int num_threads, int depth, bool replicated, uint64_t *counted)
+{
+    thrd_t *threads;
+    uint64_t node_nps[MAX_NODES + 1] = { 0 };
+    int node_threads[MAX_NODES + 1] = { 0 };
+    uint64_t total = 0;
+    int spawned, i, node;
+    int result = 0;
+
+    if ((threads = malloc(num_threads * sizeof(thrd_t))) == NULL) {
+        perror("malloc");
+        return 2;
+    }
+
+    memset(workers, 0, num_threads * sizeof(worker_t));
+    for (spawned = 0; spawned < num_threads; spawned++) {
+        workers[spawned].cpu = spawned;
+        workers[spawned].depth = depth;
+        workers[spawned].replicated = replicated;
+        if (thrd_create(&threads[spawned], worker_entry, &workers[spawned]) != thrd_success) {
+            fprintf(stderr, "thrd_create: failed to spawn worker %d\n", spawned);
+            result = 2;
+            break;
+        }
+    }
+    for (i = 0; i < spawned; i++) {
+        thrd_join(threads[i], NULL);
+        result |= workers[i].result;
+    }
+    free(threads);
+    if (result != 0)
+        return result;
+
+    /* Group the threads by the copy they read. The master copy is reported as "-". */
+    for (i = 0; i < num_threads; i++) {
+        node = workers[i].node < 0 ? MAX_NODES : workers[i].node;
+        node_nps[node] += workers[i].nodes * 1.0e9 / workers[i].time_ns;
+        node_threads[node]++;
+        total += workers[i].nodes * 1.0e9 / workers[i].time_ns;
+        *counted += workers[i].nodes;
+    }
+
+    printf("%s tables\n", replicated ? "replicated" : "shared");
+    printf("%6s %8s %14s %14s\n", "copy", "threads", "nps", "nps/thread");
+    for (node = 0; node <= MAX_NODES; node++) {
+        if (node_threads[node] == 0)
+            continue;
+        if (node == MAX_NODES)
+            printf("%6s", "-");
+        else
+            printf("%6d", node);
+        printf(" %8d %14" PRIu64 " %14" PRIu64 "\n", node_threads[node], node_nps[node],
+               node_nps[node] / node_threads[node]);
+    }
+    printf("%6s %8d %14" PRIu64 "\n\n", "total", num_threads, total);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    worker_t *workers;
+    cb_error_t err;
+    uint64_t shared_nodes = 0;
+    uint64_t local_nodes = 0;
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int depth = DEFAULT_DEPTH;
+    int copies = 0;
+    int result = 0;
+    int i;
+
+    /* Parse the arguments. */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc) {
+            copies = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (num_threads < 1 || depth < 1 || copies < 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    if (cb_tables_init(&err) != 0) {
+        fprintf(stderr, "cb_tables_init: %s\n", err.desc);
+        return 2;
+    }
+    if (cb_tables_replicate(&err, copies) != 0) {
+        fprintf(stderr, "cb_tables_replicate: %s\n", err.desc);
+        result = 2;
+        goto out_free_tables;
+    }
+    if ((workers = calloc(num_threads, sizeof(worker_t))) == NULL) {
+        perror("calloc");
+        result = 2;
+        goto out_free_tables;
+    }
+
+    printf("%d threads, depth %d, %s sliders, %d table copies\n", num_threads, depth,
+           CB_SLIDER_BACKEND, cb_tables_num_copies());
+    for (i = 0; i < cb_tables_num_copies(); i++)
+        printf("  copy %d: %s\n", i, cb_tables_copy_bound(i) ? "bound with mbind" :
+               "first touch");
+    printf("\n");
+
+    /* Both runs walk the same trees, so a bad copy shows up as a different node count. */
+    if ((result = run(workers, num_threads, depth, false, &shared_nodes)) == 0
+            && (result = run(workers, num_threads, depth, true, &local_nodes)) == 0
+            && shared_nodes != local_nodes) {
+        fprintf(stderr, "node counts differ: %" PRIu64 " shared, %" PRIu64 " replicated\n",
+                shared_nodes, local_nodes);
+        result = 1;
+    }
+
+    free(workers);
+out_free_tables:
+    cb_tables_free();
+    return result;
+}
@@ -0,0 +1,186 @@
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "cb_lib.h"
+#include "cb_tables.h"
+#include "perft.h"
+#include "bench.h"
+#include "crosstime.h"
+#include "perfcnt.h"
+
+#define FEN_BUF_LEN 128
+
+/**
+ * @breif The outcome of a single suite entry.
+ */
+typedef struct {
+    uint64_t nodes;     /**< The number of nodes counted. */
+    uint64_t time_ns;   /**< The wall time taken to count them. */
+    perfcnt_t pc;       /**< Hardware counters for the run, if requested. */
+} suite_result_t;
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-f] [-c] [-s] [-p <index>]\n"
+            "  -f, --full       Run the full depths instead of the quick ones.\n"
+            "  -c, --counters   Collect hardware performance counters for each position.\n"
+            "  -s, --pseudo     Walk the tree with the pseudo-legal generator.\n"
+            "  -p, --position   Only run the position at the given index.\n", prog);
+}
+
+int run_position(cb_board_t *board, suite_result_t *res, const char *fen, int depth,
+                 bool pseudo)
+{
+    cb_errno_t result;
+    cb_error_t err;
+    char fen_buf[FEN_BUF_LEN];
+    uint64_t start_time;
+
+    /* The fen parser modifies its input so hand it a copy. */
+    strncpy(fen_buf, fen, FEN_BUF_LEN - 1);
+    fen_buf[FEN_BUF_LEN - 1] = '\0';
+    if ((result = cb_board_from_fen(&err, board, fen_buf)) != 0) {
+        fprintf(stderr, "cb_board_from_fen: %s\n", err.desc);
+        return result;
+    }
+    if ((result = cb_reserve_for_make(&err, board, depth)) != 0) {
+        fprintf(stderr, "cb_reserve_for_make: %s\n", err.desc);
+        return result;
+    }
+
+    perfcnt_start(&res->pc);
+    start_time = time_ns();
+    res->nodes = pseudo ? perft_count_pseudo(board, depth) : perft_count(board, depth);
+    res->time_ns = time_ns() - start_time;
+    perfcnt_stop(&res->pc);
+
+    return 0;
+}
+
+static inline uint64_t nps(uint64_t nodes, uint64_t ns)
+{
+    return ns == 0 ? 0 : (uint64_t)(nodes * 1.0e9 / ns);
+}
+
+/**
+ * Prints the counters as a JSON object, with null for any counter that is unavailable.
+ */
+void print_counters(const perfcnt_t *pc, uint64_t nodes)
+{
+    int i;
+
+    printf(", \"counters\": {");
+    for (i = 0; i < PERFCNT_NUM_EVENTS; i++) {
+        printf("%s\"%s\": ", i == 0 ? "" : ", ", PERFCNT_NAMES[i]);
+        if (perfcnt_has(pc, i))
+            printf("{\"total\": %" PRIu64 ", \"per_node\": %.4f}", pc->value[i],
+                   nodes == 0 ? 0.0 : (double)pc->value[i] / nodes);
+        else
+            printf("null");
+    }
+    printf("}");
+}
+
+int main(int argc, char *argv[])
+{
+    cb_board_t board;
+    cb_error_t err;
+    suite_result_t res;
+    const int *depths = BENCH_SHORT_DEPTHS;
+    const uint64_t *expected = BENCH_SHORT_RESULTS;
+    bool full = false;
+    bool counters = false;
+    bool pseudo = false;
+    int only = -1;
+    int failures = 0;
+    int result = 0;
+    bool first = true;
+    uint64_t total_nodes = 0;
+    uint64_t total_ns = 0;
+    int i;
+
+    /* Parse the arguments. */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--full") == 0) {
+            full = true;
+        } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--pseudo") == 0) {
+            pseudo = true;
+        } else if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--position") == 0)
+                && i + 1 < argc) {
+            only = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (full) {
+        depths = BENCH_FULL_DEPTHS;
+        expected = BENCH_FULL_RESULTS;
+    }
+
+    /* Set up the tables and the board. */
+    if (cb_tables_init(&err) != 0) {
+        fprintf(stderr, "cb_tables_init: %s\n", err.desc);
+        return 2;
+    }
+    if (cb_board_init(&err, &board) != 0) {
+        fprintf(stderr, "cb_board_init: %s\n", err.desc);
+        result = 2;
+        goto out_free_tables;
+    }
+
+    /* The counters stay closed when not requested, which makes start and stop no-ops. */
+    perfcnt_init(&res.pc);
+    if (counters && perfcnt_open(&res.pc) == 0)
+        fprintf(stderr, "warning: no hardware performance counters are available\n");
+
+    /* Run the suite and emit one JSON record per position. */
+    printf("{\n  \"suite\": \"%s\",\n  \"generator\": \"%s\",\n  \"sliders\": \"%s\",\n"
+           "  \"slider_table_bytes\": %zu,\n  \"positions\": [", full ? "full" : "quick",
+           pseudo ? "pseudo" : "legal", CB_SLIDER_BACKEND, CB_SLIDER_TABLE_BYTES);
+    for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+        if (only >= 0 && i != only)
+            continue;
+        if (run_position(&board, &res, BENCH_POSITIONS[i], depths[i], pseudo) != 0) {
+            result = 2;
+            goto out_free_board;
+        }
+
+        total_nodes += res.nodes;
+        total_ns += res.time_ns;
+        failures += res.nodes != expected[i];
+        if (res.nodes != expected[i])
+            fprintf(stderr, "MISMATCH: %s depth %d expected %" PRIu64 " got %" PRIu64 "\n",
+                    BENCH_POSITIONS[i], depths[i], expected[i], res.nodes);
+
+        printf("%s\n    {\"fen\": \"%s\", \"depth\": %d, \"expected\": %" PRIu64
+               ", \"nodes\": %" PRIu64 ", \"time_ms\": %.3f, \"nps\": %" PRIu64
+               ", \"ns_per_node\": %.3f, \"ok\": %s", first ? "" : ",", BENCH_POSITIONS[i],
+               depths[i], expected[i], res.nodes, res.time_ns / 1.0e6,
+               nps(res.nodes, res.time_ns),
+               res.nodes == 0 ? 0.0 : (double)res.time_ns / res.nodes,
+               res.nodes == expected[i] ? "true" : "false");
+        if (counters)
+            print_counters(&res.pc, res.nodes);
+        printf("}");
+        fflush(stdout);
+        first = false;
+    }
+    printf("\n  ],\n  \"total_nodes\": %" PRIu64 ",\n  \"total_time_ms\": %.3f,\n"
+           "  \"nps\": %" PRIu64 ",\n  \"failures\": %d\n}\n", total_nodes, total_ns / 1.0e6,
+           nps(total_nodes, total_ns), failures);
+    result = failures != 0;
+
+out_free_board:
+    perfcnt_close(&res.pc);
+    cb_board_free(&board);
+out_free_tables:
+    cb_tables_free();
+    return result;
+}
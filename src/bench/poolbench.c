@@ -0,0 +1,272 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "cb_lib.h"
+#include "cb_move.h"
+#include "cb_pool.h"
+#include "cb_zobrist.h"
+#include "bench.h"
+#include "crosstime.h"
+
+/*
+ * Random playouts of many games at once, stepped a ply at a time in game order the way the
+ * server and the self-play generator step them.
+ *
+ * The same games are played twice, once on an array of cb_board_t and once on a cb_pool_t.
+ * Both runs draw their moves from the same seeded generator, so they visit the same positions.
+ * The xor of the final keys has to agree, and so does every history word of every game.
+ */
+
+#define FEN_BUF_LEN 128
+#define DEFAULT_GAMES 4096
+#define DEFAULT_ROUNDS 256
+#define DEFAULT_PLIES 128
+#define RNG_SEED UINT64_C(0x9E3779B97F4A7C15)
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-g <games>] [-r <rounds>] [-p <plies>] [-c <cpu>]\n"
+            "  -g    Number of games stepped together (default %d).\n"
+            "  -r    Number of rounds, one ply of every game each (default %d).\n"
+            "  -p    Plies a game runs for before it restarts (default %d).\n"
+            "  -c    Cpu to pin the benchmark to (default: the current one).\n",
+            prog, DEFAULT_GAMES, DEFAULT_ROUNDS, DEFAULT_PLIES);
+}
+
+static inline uint64_t next_rand(uint64_t *rng)
+{
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    return *rng;
+}
+
+/**
+ * Picks the next move of a game, or CB_INVALID_MOVE if the game has to restart.
+ */
+static inline cb_move_t pick_move(cb_mvlst_t *mvlst, int hist_count, int plies, uint64_t *rng)
+{
+    if (cb_mvlst_size(mvlst) == 0 || hist_count >= plies)
+        return CB_INVALID_MOVE;
+    return cb_mvlst_at(mvlst, next_rand(rng) % cb_mvlst_size(mvlst));
+}
+
+uint64_t play_boards(cb_board_t *boards, int games, int rounds, int plies, uint64_t *steps)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    cb_move_t mv;
+    uint64_t rng = RNG_SEED;
+    uint64_t keys = 0;
+    int r, id;
+
+    for (r = 0; r < rounds; r++) {
+        for (id = 0; id < games; id++) {
+            cb_gen_board_tables(&state, &boards[id]);
+            cb_gen_moves(&mvlst, &boards[id], &state);
+            if ((mv = pick_move(&mvlst, boards[id].hist.count, plies, &rng)) == CB_INVALID_MOVE) {
+                while (boards[id].hist.count > 1)
+                    cb_unmake(&boards[id]);
+                continue;
+            }
+            cb_make(&boards[id], mv);
+            (*steps)++;
+        }
+    }
+
+    for (id = 0; id < games; id++)
+        keys ^= cb_board_key(&boards[id]);
+    return keys;
+}
+
+uint64_t play_pool(cb_pool_t *pool, cb_move_t *mvs, int rounds, int plies, uint64_t *steps)
+{
+    cb_mvlst_t mvlst;
+    uint64_t rng = RNG_SEED;
+    uint64_t keys = 0;
+    uint32_t id;
+    int r;
+
+    for (r = 0; r < rounds; r++) {
+        /* Pick every move first, then make them all in one pass. */
+        for (id = 0; id < pool->count; id++) {
+            cb_pool_gen_moves(&mvlst, pool, id);
+            if ((mvs[id] = pick_move(&mvlst, pool->hist_count[id], plies, &rng)) == CB_INVALID_MOVE) {
+                while (pool->hist_count[id] > 1)
+                    cb_pool_unmake(pool, id);
+                continue;
+            }
+            (*steps)++;
+        }
+        cb_pool_step(pool, mvs);
+    }
+
+    for (id = 0; id < pool->count; id++)
+        keys ^= cb_pool_key(pool, id);
+    return keys;
+}
+
+/**
+ * Counts the games whose history on the pool differs from the one on their board, in the
+ * moves, the keys or the history words with the halfmove clock.
+ */
+int count_diverged(const cb_board_t *boards, const cb_pool_t *pool)
+{
+    const cb_hist_ele_t *hist;
+    int diverged = 0;
+    uint32_t id;
+    int i;
+
+    for (id = 0; id < pool->count; id++) {
+        hist = pool->hist + (size_t)id * pool->hist_len;
+        if (boards[id].hist.count != (int)pool->hist_count[id]) {
+            diverged++;
+            continue;
+        }
+        for (i = 0; i < boards[id].hist.count; i++) {
+            if (boards[id].hist.data[i].hist != hist[i].hist
+                    || boards[id].hist.data[i].move != hist[i].move
+                    || boards[id].hist.data[i].key != hist[i].key) {
+                diverged++;
+                break;
+            }
+        }
+    }
+    return diverged;
+}
+
+/**
+ * Loads the root position into a board with room for plies moves.
+ */
+int load_root(cb_board_t *board, int plies)
+{
+    char fen_buf[FEN_BUF_LEN];
+    cb_error_t err;
+
+    strncpy(fen_buf, BENCH_POSITIONS[0], FEN_BUF_LEN - 1);
+    fen_buf[FEN_BUF_LEN - 1] = '\0';
+    if (cb_board_from_fen(&err, board, fen_buf) != 0
+            || cb_reserve_for_make(&err, board, plies) != 0) {
+        fprintf(stderr, "failed to load the root position: %s\n", err.desc);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    cb_board_t *boards = NULL;
+    cb_move_t *mvs = NULL;
+    cb_pool_t pool;
+    cb_error_t err;
+    uint64_t board_keys, pool_keys;
+    uint64_t board_steps = 0, pool_steps = 0;
+    uint64_t start, board_ns, pool_ns;
+    int games = DEFAULT_GAMES;
+    int rounds = DEFAULT_ROUNDS;
+    int plies = DEFAULT_PLIES;
+    int cpu = -1;
+    int result = 0;
+    int inited = 0;
+    int i;
+
+    /* Parse the arguments. */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            plies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (games < 1 || rounds < 1 || plies < 2) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    if ((cpu = bench_pin_thread(cpu)) < 0)
+        fprintf(stderr, "warning: could not pin the benchmark thread\n");
+
+    if (cb_tables_init(&err) != 0) {
+        fprintf(stderr, "cb_tables_init: %s\n", err.desc);
+        return 2;
+    }
+
+    /* One board with its own heap history per game, as the server keeps them today. */
+    if ((boards = calloc(games, sizeof(cb_board_t))) == NULL
+            || (mvs = calloc(games, sizeof(cb_move_t))) == NULL) {
+        perror("calloc");
+        result = 2;
+        goto out_free_boards;
+    }
+    for (inited = 0; inited < games; inited++) {
+        if (cb_board_init(&err, &boards[inited]) != 0) {
+            fprintf(stderr, "cb_board_init: %s\n", err.desc);
+            result = 2;
+            goto out_free_boards;
+        }
+        if (load_root(&boards[inited], plies) != 0) {
+            inited++;
+            result = 2;
+            goto out_free_boards;
+        }
+    }
+
+    /* The pool gets the same games copied in. */
+    if (cb_pool_init(&err, &pool, games, plies + 1) != 0) {
+        fprintf(stderr, "cb_pool_init: %s\n", err.desc);
+        result = 2;
+        goto out_free_boards;
+    }
+    for (i = 0; i < games; i++) {
+        if (cb_pool_load(&err, &pool, i, &boards[i]) != 0) {
+            fprintf(stderr, "cb_pool_load: %s\n", err.desc);
+            result = 2;
+            goto out_free_pool;
+        }
+    }
+
+    start = time_ns();
+    board_keys = play_boards(boards, games, rounds, plies, &board_steps);
+    board_ns = time_ns() - start;
+
+    start = time_ns();
+    pool_keys = play_pool(&pool, mvs, rounds, plies, &pool_steps);
+    pool_ns = time_ns() - start;
+
+    printf("%d games, %d rounds, %d plies per game, cpu %d\n\n", games, rounds, plies, cpu);
+    printf("%-10s %12s %10s %12s %10s %12s\n", "layout", "steps", "time_ms", "steps/s",
+           "ns/step", "history KB");
+    printf("%-10s %12" PRIu64 " %10.1f %12.0f %10.1f %12.1f\n", "boards", board_steps,
+           board_ns / 1e6, board_steps / (board_ns / 1e9), (double)board_ns / board_steps,
+           (double)games * boards[0].hist.size * sizeof(cb_hist_ele_t) / 1024);
+    printf("%-10s %12" PRIu64 " %10.1f %12.0f %10.1f %12.1f\n", "pool", pool_steps,
+           pool_ns / 1e6, pool_steps / (pool_ns / 1e9), (double)pool_ns / pool_steps,
+           (double)games * pool.hist_len * sizeof(cb_hist_ele_t) / 1024);
+    printf("\n");
+
+    if (board_keys != pool_keys || board_steps != pool_steps
+            || (i = count_diverged(boards, &pool)) != 0) {
+        fprintf(stderr, "the pool diverged from the boards in %d games\n", i);
+        result = 1;
+    }
+
+out_free_pool:
+    cb_pool_free(&pool);
+out_free_boards:
+    for (i = 0; i < inited; i++)
+        cb_board_free(&boards[i]);
+    free(boards);
+    free(mvs);
+    cb_tables_free();
+    return result;
+}
@@ -6,8 +6,21 @@ const uint16_t HIST_ENP_COL          =       0b11100000;
 const uint16_t HIST_PID_COL          =       0b11100000;
 const uint16_t HIST_ENP_AVAILABLE    =          0b10000;
 const uint16_t HIST_ENP_ALL          =       0b11110000;
-const uint16_t HIST_HALFMOVE_CLOCK   = 0b11111100000000;
-const uint16_t HIST_HALFMOVE_FIFTY   = 50 << 8;
+const uint16_t HIST_HALFMOVE_CLOCK   = 0b1111111100000000;
+const uint16_t HIST_HALFMOVE_FIFTY   = 100 << 8;
+
+/* The castle rights that survive a move to or from each square. Only the king and rook starting
+ * squares clear anything. */
+const uint16_t HIST_CASTLE_KEEP[64] = {
+    0xFFFE, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFC, 0xFFFF, 0xFFFF, 0xFFFD,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFB, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFF3, 0xFFFF, 0xFFFF, 0xFFF7
+};
 
 const uint8_t M_WHITE_KING_START               = 60;
 const uint8_t M_WHITE_KING_SIDE_ROOK_START     = 63;
@@ -58,9 +71,11 @@ const uint64_t BB_BLACK_KING_SIDE_CASTLE_CHECK      = 0x0000000000000070;
 const uint64_t BB_BLACK_QUEEN_SIDE_CASTLE_CHECK     = 0x000000000000001C;
 
 const cb_move_t CB_INVALID_MOVE = 0b0110111111111111;
+const cb_move_t CB_NULL_MOVE    = 0b0110000000000000;
 const cb_hist_ele_t CB_INIT_STATE = {
     HIST_INIT_BOARD_STATE,
-    CB_INVALID_MOVE
+    CB_INVALID_MOVE,
+    0
 };
 
 const uint16_t CB_MV_TO_MASK   = 0x3F;
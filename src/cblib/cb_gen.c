@@ -8,355 +8,75 @@
 #include "cb_move.h"
 #include "cb_bitutil.h"
 #include "cb_history.h"
+#include "cb_visit.h"
 
-static inline uint64_t pawn_smear(uint64_t pawns, cb_color_t color)
+static bool push_visitor(void *ctx, cb_move_t mv)
 {
-    return color == CB_WHITE ?
-        (pawns >> 9 & ~BB_RIGHT_COL) | (pawns >> 7 & ~BB_LEFT_COL) :
-        (pawns << 7 & ~BB_RIGHT_COL) | (pawns << 9 & ~BB_LEFT_COL);
+    cb_mvlst_push((cb_mvlst_t *)ctx, mv);
+    return false;
 }
 
-static inline uint64_t pawn_smear_left(uint64_t pawns, cb_color_t color)
-{
-    return color == CB_WHITE ?
-        (pawns >> 9 & ~BB_RIGHT_COL) :
-        (pawns << 9 & ~BB_LEFT_COL);
-}
-
-static inline uint64_t pawn_smear_forward(uint64_t pawns, cb_color_t color)
-{
-    return color == CB_WHITE ? pawns >> 8 : pawns << 8;
-}
-
-static inline uint64_t pawn_smear_right(uint64_t pawns, cb_color_t color)
-{
-    return color == CB_WHITE ?
-        (pawns >> 7 & ~BB_LEFT_COL) :
-        (pawns << 7 & ~BB_RIGHT_COL);
-}
-
-static inline void append_pushes(cb_mvlst_t *mvlst, cb_board_t *board, uint64_t pushes)
-{
-    uint8_t target;
-    uint8_t sq;
-
-    while (pushes != 0) {
-        target = pop_rbit(&pushes);
-        sq = target + (board->turn == CB_WHITE ? 8 : -8);
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_QUIET));
-    }
-}
-
-static inline void append_doubles(cb_mvlst_t *mvlst, cb_board_t *board, uint64_t doubles)
-{
-    uint8_t target;
-    uint8_t sq;
-
-    while (doubles != 0) {
-        target = pop_rbit(&doubles);
-        sq = target + (board->turn == CB_WHITE ? 16 : -16);
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_DOUBLE_PAWN_PUSH));
-    }
-}
-
-static inline void append_left_attacks(cb_mvlst_t *mvlst, cb_board_t *board,
-                                       uint64_t left_attacks)
-{
-    uint8_t target;
-    uint8_t sq;
-
-    while (left_attacks != 0) {
-        target = pop_rbit(&left_attacks);
-        sq = target + (board->turn == CB_WHITE ? 9 : -9);
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_CAPTURE));
-    }
-}
-
-static inline void append_right_attacks(cb_mvlst_t *mvlst, cb_board_t *board,
-                                        uint64_t right_attacks)
-{
-    uint8_t target;
-    uint8_t sq;
-
-    while (right_attacks != 0) {
-        target = pop_rbit(&right_attacks);
-        sq = target + (board->turn == CB_WHITE ? 7 : -7);
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_CAPTURE));
-    }
-}
-
-static inline void append_left_promos(cb_mvlst_t *mvlst, cb_board_t *board, uint64_t left_promos)
-{
-    uint8_t target;
-    uint8_t sq;
-
-    while (left_promos != 0) {
-        target = pop_rbit(&left_promos);
-        sq = target + (board->turn == CB_WHITE ? 9 : -9);
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_KNIGHT_PROMO_CAPTURE));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_BISHOP_PROMO_CAPTURE));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_ROOK_PROMO_CAPTURE));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_QUEEN_PROMO_CAPTURE));
-    }
-}
-
-static inline void append_forward_promos(cb_mvlst_t *mvlst, cb_board_t *board,
-                                         uint64_t forward_promos)
+void cb_gen_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state)
 {
-    uint8_t target;
-    uint8_t sq;
-
-    while (forward_promos != 0) {
-        target = pop_rbit(&forward_promos);
-        sq = target + (board->turn == CB_WHITE ? 8 : -8);
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_KNIGHT_PROMO));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_BISHOP_PROMO));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_ROOK_PROMO));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_QUEEN_PROMO));
-    }
+    cb_mvlst_clear(mvlst);
+    cb_visit_moves(board, state, push_visitor, mvlst);
 }
 
-static inline void append_right_promos(cb_mvlst_t *mvlst, cb_board_t *board, uint64_t right_promos)
+static inline uint64_t gen_discoverers(cb_board_t *board, uint8_t king_sq)
 {
-    uint8_t target;
+    uint64_t *pieces = board->bb.piece[board->turn];
+    uint64_t occ = board->bb.occ;
+    uint64_t own = board->bb.color[board->turn];
+    uint64_t atks, snipers;
+    uint64_t discoverers = 0;
     uint8_t sq;
 
-    while (right_promos != 0) {
-        target = pop_rbit(&right_promos);
-        sq = target + (board->turn == CB_WHITE ? 7 : -7);
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_KNIGHT_PROMO_CAPTURE));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_BISHOP_PROMO_CAPTURE));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_ROOK_PROMO_CAPTURE));
-        cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, CB_MV_QUEEN_PROMO_CAPTURE));
-    }
-}
-
-void append_pawn_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state)
-{
-    /* Get the mask of pawns that we want to evaluate. */
-    uint64_t pawns = board->bb.piece[board->turn][CB_PTYPE_PAWN];
-
-    /* TODO: REMOVE ME.
-    cb_print_state(stdout, state); *;/
-
-    /* Remove all of the pinned pawns and add back those that lie on a left ray. */
-    uint64_t left_pin_mask = state->pins[CB_DIR_DR] | state->pins[CB_DIR_UL];
-    uint64_t left_pawns = (pawns & ~state->pins[8]) | (pawns & left_pin_mask);
-
-    /* Remove all of the pinned pawns and add back those that lie on a forward ray. */
-    uint64_t forward_pin_mask = state->pins[CB_DIR_D] | state->pins[CB_DIR_U];
-    uint64_t forward_pawns = (pawns & ~state->pins[8]) | (pawns & forward_pin_mask);
-
-    /* Remove all of the pinned pawns and add back those that lie on a right ray. */
-    uint64_t right_pin_mask = state->pins[CB_DIR_DL] | state->pins[CB_DIR_UR];
-    uint64_t right_pawns = (pawns & ~state->pins[8]) | (pawns & right_pin_mask);
-
-    /* Generate masks for pawns moving left and right. */
-    uint64_t left_smear = pawn_smear_left(left_pawns, board->turn);
-    uint64_t left_attacks = left_smear & board->bb.color[!board->turn];
-    uint64_t right_smear = pawn_smear_right(right_pawns, board->turn);
-    uint64_t right_attacks = right_smear & board->bb.color[!board->turn];
-
-    /* Generate masks for pushing pawns. */
-    uint64_t forward_smear = pawn_smear_forward(forward_pawns, board->turn);
-    uint64_t forward_moves = forward_smear & ~board->bb.occ;
-
-    /* Smear the forward moves again to get the double pushes. */
-    uint64_t double_smear = pawn_smear_forward(forward_moves, board->turn);
-    uint64_t double_moves = double_smear & ~board->bb.occ;
-    double_moves &= board->turn == CB_WHITE ? BB_WHITE_PAWN_LINE : BB_BLACK_PAWN_LINE;
-
-    /* Adjust for checks. */
-    left_attacks &= state->check_blocks;
-    right_attacks &= state->check_blocks;
-    forward_moves &= state->check_blocks;
-    double_moves &= state->check_blocks;
-
-    /* Select the moves that cuase a promotion. */
-    uint64_t left_promos = left_attacks & (BB_TOP_ROW | BB_BOTTOM_ROW);
-    left_attacks ^= left_promos;
-    uint64_t right_promos = right_attacks & (BB_TOP_ROW | BB_BOTTOM_ROW);
-    right_attacks ^= right_promos;
-    uint64_t forward_promos = forward_moves & (BB_TOP_ROW | BB_BOTTOM_ROW);
-    forward_moves ^= forward_promos;
-
-    /* Turn the masks into moves. */
-    append_pushes(mvlst, board, forward_moves);
-    append_doubles(mvlst, board, double_moves);
-    append_left_attacks(mvlst, board, left_attacks);
-    append_right_attacks(mvlst, board, right_attacks);
-    append_forward_promos(mvlst, board, forward_promos);
-    append_left_promos(mvlst, board, left_promos);
-    append_right_promos(mvlst, board, right_promos);
-}
-
-uint64_t gen_pseudo_mv_mask(cb_ptype_t ptype, cb_color_t pcolor, uint8_t sq, uint64_t occ)
-{
-    switch (ptype) {
-        case CB_PTYPE_PAWN:
-            return cb_read_pawn_atk_msk(sq, pcolor);
-        case CB_PTYPE_KNIGHT:
-            return cb_read_knight_atk_msk(sq);
-        case CB_PTYPE_BISHOP:
-            return cb_read_bishop_atk_msk(sq, occ);
-        case CB_PTYPE_ROOK:
-            return cb_read_rook_atk_msk(sq, occ);
-        case CB_PTYPE_QUEEN:
-            return cb_read_bishop_atk_msk(sq, occ)
-                | cb_read_rook_atk_msk(sq, occ);
-        case CB_PTYPE_KING:
-            return cb_read_king_atk_msk(sq);
-        case CB_PTYPE_EMPTY:
-            assert(false && "invalid piece type for pseudo legal move generation");
-            return 0;
-    }
-}
-
-static inline uint64_t pin_adjust(cb_board_t *board, cb_state_tables_t *state, uint8_t sq,
-                                  uint64_t moves)
-{
-    uint64_t mask;
-    uint8_t king_sq = peek_rbit(board->bb.piece[board->turn][CB_PTYPE_KING]);
-    uint8_t dir = cb_get_ray_direction(king_sq, sq);
-    return (state->pins[dir] & (UINT64_C(1) << sq)) == 0 ? moves : (moves & state->pins[dir]);
-}
-
-uint64_t cb_gen_legal_mv_mask(cb_board_t *board, cb_state_tables_t *state, uint8_t sq)
-{
-    /* Generate the pseudo moves. */
-    cb_ptype_t ptype = cb_ptype_at_sq(board, sq);
-    cb_color_t pcolor = cb_color_at_sq(board, sq);
-    uint64_t moves = gen_pseudo_mv_mask(ptype, pcolor, sq, board->bb.occ);
-    moves &= ~board->bb.color[board->turn];
-
-    /* Adjust moves for pins and checks. */
-    moves &= ptype == CB_PTYPE_KING ? ~state->threats : state->check_blocks;
-    moves = pin_adjust(board, state, sq, moves);
-
-    return moves;
-}
-
-void append_simple_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state)
-{
-    uint8_t sq, target;
-    cb_mv_flag_t flags;
-    uint64_t mvmsk;
-    uint64_t pieces = board->bb.color[board->turn];
+    /* Find the friendly sliders that see the king once our own pieces are removed. */
+    atks = cb_read_bishop_atk_msk(king_sq, occ);
+    snipers = (atks ^ cb_read_bishop_atk_msk(king_sq, occ ^ (atks & own)))
+        & (pieces[CB_PTYPE_BISHOP] | pieces[CB_PTYPE_QUEEN]);
+    atks = cb_read_rook_atk_msk(king_sq, occ);
+    snipers |= (atks ^ cb_read_rook_atk_msk(king_sq, occ ^ (atks & own)))
+        & (pieces[CB_PTYPE_ROOK] | pieces[CB_PTYPE_QUEEN]);
 
-    /* Append all of the moves to the list. */
-    pieces ^= board->bb.piece[board->turn][CB_PTYPE_PAWN];
-    while (pieces) {
-        sq = pop_rbit(&pieces);
-        mvmsk = cb_gen_legal_mv_mask(board, state, sq);
-        while (mvmsk) {
-            target = pop_rbit(&mvmsk);
-            flags = (UINT64_C(1) << target) & board->bb.occ ? CB_MV_CAPTURE : CB_MV_QUIET;
-            cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, flags));
-        }
+    /* The lone piece between each sniper and the king is a discoverer. The ray includes the
+     * sniper itself, so take it back out. */
+    while (snipers) {
+        sq = pop_rbit(&snipers);
+        discoverers |= cb_read_tf_table(sq, king_sq) & own & occ & ~(UINT64_C(1) << sq);
     }
-}
-
-static inline bool ksc_legal(cb_board_t *board, cb_state_tables_t *state)
-{
-    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
-    uint64_t occ_mask = board->turn == CB_WHITE ? BB_WHITE_KING_SIDE_CASTLE_OCCUPANCY :
-        BB_BLACK_KING_SIDE_CASTLE_OCCUPANCY;
-    uint64_t check_mask = board->turn == CB_WHITE ? BB_WHITE_KING_SIDE_CASTLE_CHECK :
-        BB_BLACK_KING_SIDE_CASTLE_CHECK;
 
-    /* If the occupancy intersects occ_mask or the threats intersect ckeck_mask. No castling. */
-    return ((board->bb.occ & occ_mask) | (state->threats & check_mask)) == 0
-        && cb_hist_has_ksc(hist, board->turn);
+    return discoverers;
 }
 
-static inline bool qsc_legal(cb_board_t *board, cb_state_tables_t *state)
+void cb_gen_check_info(cb_check_info_t *info, cb_board_t *board)
 {
-    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
-    uint64_t occ_mask = board->turn == CB_WHITE ? BB_WHITE_QUEEN_SIDE_CASTLE_OCCUPANCY :
-        BB_BLACK_QUEEN_SIDE_CASTLE_OCCUPANCY;
-    uint64_t check_mask = board->turn == CB_WHITE ? BB_WHITE_QUEEN_SIDE_CASTLE_CHECK :
-        BB_BLACK_QUEEN_SIDE_CASTLE_CHECK;
-
-    /* If the occupancy intersects occ_mask or the threats intersect ckeck_mask. No castling. */
-    return ((board->bb.occ & occ_mask) | (state->threats & check_mask)) == 0
-        && cb_hist_has_qsc(hist, board->turn);
+    uint64_t occ = board->bb.occ;
+    uint8_t king_sq = peek_rbit(board->bb.piece[!board->turn][CB_PTYPE_KING]);
+
+    info->king_sq = king_sq;
+    info->check_sqs[CB_PTYPE_PAWN] = cb_read_pawn_atk_msk(king_sq, !board->turn);
+    info->check_sqs[CB_PTYPE_KNIGHT] = cb_read_knight_atk_msk(king_sq);
+    info->check_sqs[CB_PTYPE_BISHOP] = cb_read_bishop_atk_msk(king_sq, occ);
+    info->check_sqs[CB_PTYPE_ROOK] = cb_read_rook_atk_msk(king_sq, occ);
+    info->check_sqs[CB_PTYPE_QUEEN] = info->check_sqs[CB_PTYPE_BISHOP]
+        | info->check_sqs[CB_PTYPE_ROOK];
+    info->check_sqs[CB_PTYPE_KING] = 0;
+    info->discoverers = gen_discoverers(board, king_sq);
 }
 
-void append_castle_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state)
+void cb_gen_noisy_and_checks(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state,
+                             bool quiet_checks)
 {
-    uint8_t from = board->turn == CB_WHITE ? M_WHITE_KING_START : M_BLACK_KING_START;
-    uint8_t to;
+    cb_check_info_t info;
 
-    if (ksc_legal(board, state)) {
-        to = board->turn == CB_WHITE ? M_WHITE_KING_SIDE_CASTLE_TARGET :
-            M_BLACK_KING_SIDE_CASTLE_TARGET;
-        cb_mvlst_push(mvlst, cb_mv_from_data(from, to, CB_MV_KING_SIDE_CASTLE));
-    }
-
-    if (qsc_legal(board, state)) {
-        to = board->turn == CB_WHITE ? M_WHITE_QUEEN_SIDE_CASTLE_TARGET :
-            M_BLACK_QUEEN_SIDE_CASTLE_TARGET;
-        cb_mvlst_push(mvlst, cb_mv_from_data(from, to, CB_MV_QUEEN_SIDE_CASTLE));
-    }
-}
-
-void append_enp_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state)
-{
-    /* Exit early if there is not availiable enpassant. */
-    if (!cb_hist_enp_availiable(board->hist.data[board->hist.count - 1].hist))
+    cb_mvlst_clear(mvlst);
+    if (!quiet_checks) {
+        cb_visit_noisy_and_checks(board, state, NULL, push_visitor, mvlst);
         return;
-
-    /* Get the swares relavent to the piece that can enpassant. */
-    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
-    uint8_t enp_row_start = board->turn == CB_WHITE ? M_BLACK_MIN_ENPASSANT_TARGET :
-        M_WHITE_MIN_ENPASSANT_TARGET;
-    uint8_t enp_sq = enp_row_start + cb_hist_enp_col(hist);
-    uint8_t enemy_sq = enp_sq + (board->turn == CB_WHITE ? 8 : -8);
-
-    /* Get all of the pieces that can enpassnt. */
-    uint64_t enp_sources = cb_read_pawn_atk_msk(enp_sq, !board->turn)
-        & board->bb.piece[board->turn][CB_PTYPE_PAWN];
-
-    /* Loop through the pieces that can enpassant and generate the moves. */
-    uint8_t sq, king_sq;
-    cb_move_t mv;
-    uint64_t new_occ, bishop_threats, rook_threats;
-    while (enp_sources) {
-        sq = pop_rbit(&enp_sources);
-        mv = cb_mv_from_data(sq, enp_sq, CB_MV_ENPASSANT);
-
-        /* Update the occupancy mask to what it will be after the move takes place. */
-        new_occ = board->bb.occ;
-        new_occ &= ~(UINT64_C(1) << sq);
-        new_occ &= ~(UINT64_C(1) << enemy_sq);
-        new_occ |= UINT64_C(1) << enp_sq;
-
-        /* Check if the king is in check after the move is made.
-         * This could be the case if some piece was pinned before the enpassant was made. */
-        king_sq = peek_rbit(board->bb.piece[board->turn][CB_PTYPE_KING]);
-
-        bishop_threats = cb_read_bishop_atk_msk(king_sq, new_occ)
-            & (board->bb.piece[!board->turn][CB_PTYPE_BISHOP]
-                | board->bb.piece[!board->turn][CB_PTYPE_QUEEN]);
-        if (bishop_threats) continue;
-
-        rook_threats = cb_read_rook_atk_msk(king_sq, new_occ)
-            & (board->bb.piece[!board->turn][CB_PTYPE_ROOK]
-                | board->bb.piece[!board->turn][CB_PTYPE_QUEEN]);
-        if (rook_threats) continue;
-
-        /* Push the move if it doesn't cause any problems. */
-        cb_mvlst_push(mvlst, mv);
     }
-}
-
-void cb_gen_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_state_tables_t *state)
-{
-    cb_mvlst_clear(mvlst);
-    append_pawn_moves(mvlst, board, state);
-    append_simple_moves(mvlst, board, state);
-    append_castle_moves(mvlst, board, state);
-    append_enp_moves(mvlst, board, state);
+    cb_gen_check_info(&info, board);
+    cb_visit_noisy_and_checks(board, state, &info, push_visitor, mvlst);
 }
 
 static inline uint64_t gen_threats(cb_board_t *board)
@@ -373,12 +93,12 @@ static inline uint64_t gen_threats(cb_board_t *board)
     cb_color_t pcolor;
 
     /* Generate all threats. */
-    threats = pawn_smear(pawns, !board->turn);
+    threats = cb_pawn_smear(pawns, !board->turn);
     while (pieces) {
         sq = pop_rbit(&pieces);
         ptype = cb_ptype_at_sq(board, sq);
         pcolor = cb_color_at_sq(board, sq);
-        threats |= gen_pseudo_mv_mask(ptype, pcolor, sq, occ);
+        threats |= cb_pseudo_mv_mask(ptype, pcolor, sq, occ);
     }
 
     return threats;
@@ -475,3 +195,162 @@ void cb_gen_board_tables(cb_state_tables_t *state, cb_board_t *board)
     state->check_blocks = gen_check_blocks(board, state->checks);
     gen_pins(state->pins, board);
 }
+
+static inline uint64_t attackers_of(cb_board_t *board, uint8_t sq, uint64_t occ)
+{
+    uint64_t *pieces = board->bb.piece[!board->turn];
+
+    /* Masking by occ drops any enemy piece that was removed from the occupancy. */
+    return ((cb_read_pawn_atk_msk(sq, board->turn) & pieces[CB_PTYPE_PAWN])
+        | (cb_read_knight_atk_msk(sq) & pieces[CB_PTYPE_KNIGHT])
+        | (cb_read_king_atk_msk(sq) & pieces[CB_PTYPE_KING])
+        | (cb_read_bishop_atk_msk(sq, occ) & (pieces[CB_PTYPE_BISHOP] | pieces[CB_PTYPE_QUEEN]))
+        | (cb_read_rook_atk_msk(sq, occ) & (pieces[CB_PTYPE_ROOK] | pieces[CB_PTYPE_QUEEN])))
+        & occ;
+}
+
+void cb_gen_pseudo_tables(cb_pseudo_tables_t *pstate, cb_board_t *board)
+{
+    uint64_t own = board->bb.color[board->turn];
+    uint64_t occ = board->bb.occ;
+    uint64_t *enemy = board->bb.piece[!board->turn];
+    uint64_t pinner;
+    uint8_t king_sq = peek_rbit(board->bb.piece[board->turn][CB_PTYPE_KING]);
+
+    pstate->king_sq = king_sq;
+    pstate->checks = attackers_of(board, king_sq, occ);
+
+    /* Any slider that sees the king through exactly one friendly piece pins that piece. */
+    pinner = (xray_bishop_attacks(occ, own, king_sq)
+        & (enemy[CB_PTYPE_BISHOP] | enemy[CB_PTYPE_QUEEN]))
+        | (xray_rook_attacks(occ, own, king_sq)
+        & (enemy[CB_PTYPE_ROOK] | enemy[CB_PTYPE_QUEEN]));
+    pstate->pinned = 0;
+    while (pinner)
+        pstate->pinned |= cb_read_tf_table(pop_rbit(&pinner), king_sq) & own;
+}
+
+static inline void append_pseudo_piece_moves(cb_mvlst_t *mvlst, cb_board_t *board)
+{
+    uint8_t sq, target;
+    cb_mv_flag_t flags;
+    uint64_t mvmsk;
+    uint64_t own = board->bb.color[board->turn];
+    uint64_t pieces = own ^ board->bb.piece[board->turn][CB_PTYPE_PAWN];
+
+    while (pieces) {
+        sq = pop_rbit(&pieces);
+        mvmsk = cb_pseudo_mv_mask(cb_ptype_at_sq(board, sq), board->turn, sq, board->bb.occ);
+        mvmsk &= ~own;
+        while (mvmsk) {
+            target = pop_rbit(&mvmsk);
+            flags = (UINT64_C(1) << target) & board->bb.occ ? CB_MV_CAPTURE : CB_MV_QUIET;
+            cb_mvlst_push(mvlst, cb_mv_from_data(sq, target, flags));
+        }
+    }
+}
+
+static inline void append_pseudo_castle_moves(cb_mvlst_t *mvlst, cb_board_t *board)
+{
+    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
+    uint8_t from = board->turn == CB_WHITE ? M_WHITE_KING_START : M_BLACK_KING_START;
+    uint64_t ksc_occ = board->turn == CB_WHITE ? BB_WHITE_KING_SIDE_CASTLE_OCCUPANCY :
+        BB_BLACK_KING_SIDE_CASTLE_OCCUPANCY;
+    uint64_t qsc_occ = board->turn == CB_WHITE ? BB_WHITE_QUEEN_SIDE_CASTLE_OCCUPANCY :
+        BB_BLACK_QUEEN_SIDE_CASTLE_OCCUPANCY;
+
+    /* Attacks on the squares the king passes over are left to cb_is_legal. */
+    if (cb_hist_has_ksc(hist, board->turn) && (board->bb.occ & ksc_occ) == 0)
+        cb_mvlst_push(mvlst, cb_mv_from_data(from, board->turn == CB_WHITE ?
+                    M_WHITE_KING_SIDE_CASTLE_TARGET : M_BLACK_KING_SIDE_CASTLE_TARGET,
+                    CB_MV_KING_SIDE_CASTLE));
+    if (cb_hist_has_qsc(hist, board->turn) && (board->bb.occ & qsc_occ) == 0)
+        cb_mvlst_push(mvlst, cb_mv_from_data(from, board->turn == CB_WHITE ?
+                    M_WHITE_QUEEN_SIDE_CASTLE_TARGET : M_BLACK_QUEEN_SIDE_CASTLE_TARGET,
+                    CB_MV_QUEEN_SIDE_CASTLE));
+}
+
+static inline void append_pseudo_enp_moves(cb_mvlst_t *mvlst, cb_board_t *board)
+{
+    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
+    uint8_t enp_sq;
+    uint64_t enp_sources;
+
+    if (!cb_hist_enp_availiable(hist))
+        return;
+
+    enp_sq = (board->turn == CB_WHITE ? M_BLACK_MIN_ENPASSANT_TARGET :
+            M_WHITE_MIN_ENPASSANT_TARGET) + cb_hist_enp_col(hist);
+    enp_sources = cb_read_pawn_atk_msk(enp_sq, !board->turn)
+        & board->bb.piece[board->turn][CB_PTYPE_PAWN];
+    while (enp_sources)
+        cb_mvlst_push(mvlst, cb_mv_from_data(pop_rbit(&enp_sources), enp_sq, CB_MV_ENPASSANT));
+}
+
+void cb_gen_pseudo_moves(cb_mvlst_t *mvlst, cb_board_t *board, cb_pseudo_tables_t *pstate)
+{
+    /* With no pins and no checks the pawn generator yields every pseudo-legal pawn move. */
+    cb_state_tables_t open = { .check_blocks = BB_FULL };
+
+    cb_mvlst_clear(mvlst);
+    cb_visit_pawn_moves(board, &open, push_visitor, mvlst);
+    append_pseudo_piece_moves(mvlst, board);
+    if (pstate->checks == 0)
+        append_pseudo_castle_moves(mvlst, board);
+    append_pseudo_enp_moves(mvlst, board);
+}
+
+bool cb_is_legal(cb_board_t *board, cb_pseudo_tables_t *pstate, cb_move_t mv)
+{
+    uint8_t from = cb_mv_get_from(mv);
+    uint8_t to = cb_mv_get_to(mv);
+    uint16_t flags = cb_mv_get_flags(mv);
+    uint64_t occ = board->bb.occ;
+    uint64_t path;
+    uint8_t enemy_sq;
+
+    /* Most moves are made by an unpinned piece that is not the king while not in check. */
+    if ((pstate->checks | (pstate->pinned & (UINT64_C(1) << from))) == 0
+            && from != pstate->king_sq && flags != CB_MV_ENPASSANT)
+        return true;
+
+    /* Castles must not start in, pass through or land in check. */
+    if (flags == CB_MV_KING_SIDE_CASTLE || flags == CB_MV_QUEEN_SIDE_CASTLE) {
+        if (flags == CB_MV_KING_SIDE_CASTLE)
+            path = board->turn == CB_WHITE ? BB_WHITE_KING_SIDE_CASTLE_CHECK :
+                BB_BLACK_KING_SIDE_CASTLE_CHECK;
+        else
+            path = board->turn == CB_WHITE ? BB_WHITE_QUEEN_SIDE_CASTLE_CHECK :
+                BB_BLACK_QUEEN_SIDE_CASTLE_CHECK;
+        while (path) {
+            if (attackers_of(board, pop_rbit(&path), occ))
+                return false;
+        }
+        return true;
+    }
+
+    /* The king must not step onto an attacked square. Lift it off the board so that a slider
+     * checking it along the line of the move still sees the target square. */
+    if (from == pstate->king_sq)
+        return attackers_of(board, to, occ ^ (UINT64_C(1) << from)) == 0;
+
+    /* Enpassant removes two pieces from one row, so just look at the board after the move. */
+    if (flags == CB_MV_ENPASSANT) {
+        enemy_sq = to + (board->turn == CB_WHITE ? 8 : -8);
+        occ ^= (UINT64_C(1) << from) | (UINT64_C(1) << enemy_sq) | (UINT64_C(1) << to);
+        return attackers_of(board, pstate->king_sq, occ) == 0;
+    }
+
+    /* Any other move must capture the lone checker or block its ray. */
+    if (pstate->checks) {
+        if (popcnt(pstate->checks) > 1)
+            return false;
+        if (((cb_read_tf_table(peek_rbit(pstate->checks), pstate->king_sq) | pstate->checks)
+                    & (UINT64_C(1) << to)) == 0)
+            return false;
+    }
+
+    /* A pinned piece can only move along its pin ray. */
+    return (pstate->pinned & (UINT64_C(1) << from)) == 0
+        || cb_get_ray_direction(pstate->king_sq, from) == cb_get_ray_direction(pstate->king_sq, to);
+}
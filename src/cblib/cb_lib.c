@@ -10,6 +10,7 @@
 #include "cb_move.h"
 #include "cb_board.h"
 #include "cb_history.h"
+#include "cb_zobrist.h"
 
 void cb_mv_to_uci_algbr(char *buf, cb_move_t move)
 {
@@ -58,13 +59,19 @@ cb_errno_t cb_tables_init(cb_error_t *err)
 {
     cb_errno_t result;
     cb_init_normal_tables();
+    cb_init_zobrist();
     if ((result = cb_init_magic_tables()) != 0)
         return cb_mkerr(err, result, "malloc: %s\n", strerror(errno));
+#ifdef CB_NUMA_TABLES
+    if ((result = cb_tables_replicate(err, 0)) != 0)
+        return result;
+#endif
     return CB_EOK;
 }
 
 void cb_tables_free()
 {
+    cb_tables_free_copies();
     cb_free_magic_tables();
 }
 
@@ -82,131 +89,103 @@ cb_errno_t cb_reserve_for_make(cb_error_t *err, cb_board_t *board, uint32_t adde
     return 0;
 }
 
+/* The rook squares of a castle, indexed by the square the king lands on. */
+static const uint8_t CASTLE_ROOK_FROM[64] = { [2] = 0, [6] = 7, [58] = 56, [62] = 63 };
+static const uint8_t CASTLE_ROOK_TO[64] = { [2] = 3, [6] = 5, [58] = 59, [62] = 61 };
+
+/**
+ * Returns true for the two castle flags, which are the only moves that move a second piece.
+ */
+static inline bool is_castle(uint16_t flag)
+{
+    return flag >> 13 == 1;
+}
+
+/**
+ * Moves the rook of a castle. The same xors undo it.
+ */
+static inline void toggle_castle_rook(cb_board_t *board, uint8_t king_to, uint8_t color)
+{
+    uint64_t rook_bb = UINT64_C(1) << CASTLE_ROOK_FROM[king_to]
+        | UINT64_C(1) << CASTLE_ROOK_TO[king_to];
+
+    board->bb.piece[color][CB_PTYPE_ROOK] ^= rook_bb;
+    board->bb.color[color] ^= rook_bb;
+    board->bb.occ ^= rook_bb;
+}
+
+/*
+ * Make and unmake treat every move as a piece leaving from, a possibly different piece landing
+ * on to, and whatever the mailbox holds on the capture square being removed. The capture square
+ * is to except for enpassant, the landing piece is the moving piece except for promotions, and a
+ * missing capture xors in an empty mask, so no move flag needs its own path. Castles move the
+ * rook on top of that.
+ */
+
 void cb_make(cb_board_t *board, const cb_move_t mv)
 {
-    cb_history_t old_state = board->hist.data[board->hist.count - 1].hist;
+    cb_hist_ele_t *top = &board->hist.data[board->hist.count - 1];
+    cb_history_t old_state = top->hist;
+    cb_history_t new_state;
     cb_hist_ele_t new_ele;
-    cb_mv_flag_t flag = cb_mv_get_flags(mv);
+    uint16_t flag = cb_mv_get_flags(mv);
     uint8_t to = cb_mv_get_to(mv);
     uint8_t from = cb_mv_get_from(mv);
-
-    cb_ptype_t ptype;
-    cb_ptype_t cap_ptype;
-    cb_history_t new_state = old_state;
-
-    /* Variables for castles. */
-    uint8_t rook_from;
-    uint8_t rook_to;
-
-    /* Variables for enp. */
-    int8_t direction;
-
-    /* Make the move. */
-    switch (flag)
-    {
-        case CB_MV_QUIET:
-            ptype = cb_ptype_at_sq(board, from);
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_EMPTY);
-            cb_hist_decay_castle_rights(&new_state, board->turn, to, from);
-            cb_write_piece(board, to, ptype, board->turn);
-            cb_delete_piece(board, from, ptype, board->turn);
-            break;
-        case CB_MV_CAPTURE:
-            ptype = cb_ptype_at_sq(board, from);
-            cap_ptype = cb_ptype_at_sq(board, to);
-            cb_hist_set_captured_piece(&new_state, cap_ptype);
-            cb_hist_decay_castle_rights(&new_state, board->turn, to, from);
-            cb_replace_piece(board, to, ptype, board->turn, cap_ptype, !board->turn);
-            cb_delete_piece(board, from, ptype, board->turn);
-            break;
-        case CB_MV_DOUBLE_PAWN_PUSH:
-            cb_hist_set_enp(&new_state, to & 0b111);
-            cb_write_piece(board, to, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_KING_SIDE_CASTLE:
-            rook_from = board->turn ? M_WHITE_KING_SIDE_ROOK_START :
-                M_BLACK_KING_SIDE_ROOK_START;
-            rook_to = board->turn ? M_WHITE_KING_SIDE_ROOK_TARGET :
-                M_BLACK_KING_SIDE_ROOK_TARGET;
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_EMPTY);
-            cb_hist_remove_castle(&new_state, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_KING, board->turn);
-            cb_write_piece(board, to, CB_PTYPE_KING, board->turn);
-            cb_delete_piece(board, rook_from, CB_PTYPE_ROOK, board->turn);
-            cb_write_piece(board, rook_to, CB_PTYPE_ROOK, board->turn);
-            break;
-        case CB_MV_QUEEN_SIDE_CASTLE:
-            rook_from = board->turn ? M_WHITE_QUEEN_SIDE_ROOK_START :
-                M_BLACK_QUEEN_SIDE_ROOK_START;
-            rook_to = board->turn ? M_WHITE_QUEEN_SIDE_ROOK_TARGET :
-                M_BLACK_QUEEN_SIDE_ROOK_TARGET;
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_EMPTY);
-            cb_hist_remove_castle(&new_state, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_KING, board->turn);
-            cb_write_piece(board, to, CB_PTYPE_KING, board->turn);
-            cb_delete_piece(board, rook_from, CB_PTYPE_ROOK, board->turn);
-            cb_write_piece(board, rook_to, CB_PTYPE_ROOK, board->turn);
-            break;
-        case CB_MV_ENPASSANT:
-            direction = board->turn == CB_WHITE ? 8 : -8;
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_PAWN);
-            cb_write_piece(board, to, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, to + direction, CB_PTYPE_PAWN, !board->turn);
-            break;
-        case CB_MV_KNIGHT_PROMO:
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_EMPTY);
-            cb_write_piece(board, to, CB_PTYPE_KNIGHT, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_BISHOP_PROMO:
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_EMPTY);
-            cb_write_piece(board, to, CB_PTYPE_BISHOP, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_ROOK_PROMO:
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_EMPTY);
-            cb_write_piece(board, to, CB_PTYPE_ROOK, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_QUEEN_PROMO:
-            cb_hist_set_captured_piece(&new_state, CB_PTYPE_EMPTY);
-            cb_write_piece(board, to, CB_PTYPE_QUEEN, board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_KNIGHT_PROMO_CAPTURE:
-            cap_ptype = cb_ptype_at_sq(board, to);
-            cb_hist_set_captured_piece(&new_state, cap_ptype);
-            cb_hist_decay_castle_rights(&new_state, board->turn, to, from);
-            cb_replace_piece(board, to, CB_PTYPE_KNIGHT, board->turn, cap_ptype, !board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_BISHOP_PROMO_CAPTURE:
-            cap_ptype = cb_ptype_at_sq(board, to);
-            cb_hist_set_captured_piece(&new_state, cap_ptype);
-            cb_hist_decay_castle_rights(&new_state, board->turn, to, from);
-            cb_replace_piece(board, to, CB_PTYPE_BISHOP, board->turn, cap_ptype, !board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_ROOK_PROMO_CAPTURE:
-            cap_ptype = cb_ptype_at_sq(board, to);
-            cb_hist_set_captured_piece(&new_state, cap_ptype);
-            cb_hist_decay_castle_rights(&new_state, board->turn, to, from);
-            cb_replace_piece(board, to, CB_PTYPE_ROOK, board->turn, cap_ptype, !board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
-        case CB_MV_QUEEN_PROMO_CAPTURE:
-            cap_ptype = cb_ptype_at_sq(board, to);
-            cb_hist_set_captured_piece(&new_state, cap_ptype);
-            cb_hist_decay_castle_rights(&new_state, board->turn, to, from);
-            cb_replace_piece(board, to, CB_PTYPE_QUEEN, board->turn, cap_ptype, !board->turn);
-            cb_delete_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            break;
+    uint8_t turn = board->turn;
+    uint8_t cap_sq = flag == CB_MV_ENPASSANT ? to + (turn ? 8 : -8) : to;
+
+    /* The promotion flags count up from the knight in piece order. */
+    cb_ptype_t ptype = cb_ptype_at_sq(board, from);
+    cb_ptype_t new_ptype = flag & CB_MV_KNIGHT_PROMO ?
+        (cb_ptype_t)(CB_PTYPE_KNIGHT + (flag >> 12 & 0b11)) : ptype;
+    cb_ptype_t cap_ptype = cb_ptype_at_sq(board, cap_sq);
+    bool capture = cap_ptype != CB_PTYPE_EMPTY;
+    uint8_t cap_idx = capture ? cap_ptype : 0;
+    uint64_t cap_bb = capture ? UINT64_C(1) << cap_sq : 0;
+    uint64_t from_bb = UINT64_C(1) << from;
+    uint64_t to_bb = UINT64_C(1) << to;
+    uint64_t (*keys)[64] = cb_zobrist.piece[turn];
+    uint64_t key;
+
+    /* The enpassant key has to be read before the pawns move. */
+    key = top->key ^ cb_zobrist_enp(board, old_state);
+
+    /* The enpassant field holds the captured piece unless this move opens an enpassant. */
+    new_state = (old_state & ~HIST_ENP_ALL & HIST_CASTLE_KEEP[from] & HIST_CASTLE_KEEP[to])
+        | (flag == CB_MV_DOUBLE_PAWN_PUSH ? (to & 0b111) << 5 | HIST_ENP_AVAILABLE :
+            cap_ptype << 5);
+
+    /* The halfmove clock starts over on pawn moves and captures. */
+    if (ptype == CB_PTYPE_PAWN || capture)
+        cb_hist_reset_halfmove_clk(&new_state);
+    else
+        cb_hist_inc_halfmove_clk(&new_state);
+
+    /* Move the pieces. */
+    board->bb.piece[!turn][cap_idx] ^= cap_bb;
+    board->bb.color[!turn] ^= cap_bb;
+    board->bb.piece[turn][ptype] ^= from_bb;
+    board->bb.piece[turn][new_ptype] ^= to_bb;
+    board->bb.color[turn] ^= from_bb | to_bb;
+    board->bb.occ = (board->bb.occ ^ from_bb ^ cap_bb) | to_bb;
+    board->mb.data[from] = CB_PTYPE_EMPTY;
+    board->mb.data[cap_sq] = CB_PTYPE_EMPTY;
+    board->mb.data[to] = new_ptype;
+
+    key ^= keys[ptype][from] ^ keys[new_ptype][to]
+        ^ (cb_zobrist.piece[!turn][cap_idx][cap_sq] & -(uint64_t)capture)
+        ^ cb_zobrist.turn ^ cb_zobrist.castle[(old_state ^ new_state) & 0xF];
+
+    if (is_castle(flag)) {
+        toggle_castle_rook(board, to, turn);
+        board->mb.data[CASTLE_ROOK_FROM[to]] = CB_PTYPE_EMPTY;
+        board->mb.data[CASTLE_ROOK_TO[to]] = CB_PTYPE_ROOK;
+        key ^= keys[CB_PTYPE_ROOK][CASTLE_ROOK_FROM[to]] ^ keys[CB_PTYPE_ROOK][CASTLE_ROOK_TO[to]];
     }
 
     /* Save the new state to the stack. */
-    board->turn = !board->turn;
+    board->turn = !turn;
+    new_ele.key = key ^ cb_zobrist_enp(board, new_state);
     new_ele.hist = new_state;
     new_ele.move = mv;
     cb_hist_stack_push(&board->hist, new_ele);
@@ -215,99 +194,62 @@ void cb_make(cb_board_t *board, const cb_move_t mv)
 void cb_unmake(cb_board_t *board)
 {
     cb_hist_ele_t old_ele = cb_hist_stack_pop(&board->hist);
-    cb_hist_ele_t new_ele;
-    cb_mv_flag_t flag = cb_mv_get_flags(old_ele.move);
+    uint16_t flag = cb_mv_get_flags(old_ele.move);
     uint8_t to = cb_mv_get_to(old_ele.move);
     uint8_t from = cb_mv_get_from(old_ele.move);
+    uint8_t turn = !board->turn;
+    uint8_t cap_sq = flag == CB_MV_ENPASSANT ? to + (turn ? 8 : -8) : to;
+
+    /* A double push keeps the enpassant column where the captured piece would be. */
+    cb_ptype_t new_ptype = cb_ptype_at_sq(board, to);
+    cb_ptype_t ptype = flag & CB_MV_KNIGHT_PROMO ? CB_PTYPE_PAWN : new_ptype;
+    cb_ptype_t cap_ptype = flag == CB_MV_DOUBLE_PAWN_PUSH ? CB_PTYPE_EMPTY :
+        cb_hist_get_captured_piece(&old_ele.hist);
+    bool capture = cap_ptype != CB_PTYPE_EMPTY;
+    uint8_t cap_idx = capture ? cap_ptype : 0;
+    uint64_t cap_bb = capture ? UINT64_C(1) << cap_sq : 0;
+    uint64_t from_bb = UINT64_C(1) << from;
+    uint64_t to_bb = UINT64_C(1) << to;
 
-    cb_ptype_t ptype;
-    cb_ptype_t cap_ptype;
+    /* Unmake the move. */
+    board->turn = turn;
+    board->bb.piece[turn][new_ptype] ^= to_bb;
+    board->bb.piece[turn][ptype] ^= from_bb;
+    board->bb.color[turn] ^= from_bb | to_bb;
+    board->bb.piece[!turn][cap_idx] ^= cap_bb;
+    board->bb.color[!turn] ^= cap_bb;
+    board->bb.occ = (board->bb.occ ^ to_bb ^ from_bb) | cap_bb;
+    board->mb.data[to] = CB_PTYPE_EMPTY;
+    board->mb.data[cap_sq] = cap_ptype;
+    board->mb.data[from] = ptype;
+
+    if (is_castle(flag)) {
+        toggle_castle_rook(board, to, turn);
+        board->mb.data[CASTLE_ROOK_TO[to]] = CB_PTYPE_EMPTY;
+        board->mb.data[CASTLE_ROOK_FROM[to]] = CB_PTYPE_ROOK;
+    }
+}
 
-    /* Variables for castles. */
-    uint8_t rook_from;
-    uint8_t rook_to;
+void cb_make_null(cb_board_t *board)
+{
+    cb_hist_ele_t *top = &board->hist.data[board->hist.count - 1];
+    cb_history_t new_state = (top->hist & ~HIST_ENP_ALL) | CB_PTYPE_EMPTY << 5;
+    cb_hist_ele_t new_ele;
 
-    /* Variables for enp. */
-    int8_t direction;
+    /* No position before a pass repeats one after it. */
+    cb_hist_reset_halfmove_clk(&new_state);
 
-    /* Unmake the move. */
+    new_ele.key = top->key ^ cb_zobrist_enp(board, top->hist) ^ cb_zobrist.turn;
+    new_ele.hist = new_state;
+    new_ele.move = CB_NULL_MOVE;
+    board->turn = !board->turn;
+    cb_hist_stack_push(&board->hist, new_ele);
+}
+
+void cb_unmake_null(cb_board_t *board)
+{
+    cb_hist_stack_pop(&board->hist);
     board->turn = !board->turn;
-    switch (flag) {
-        case CB_MV_QUIET:
-        case CB_MV_DOUBLE_PAWN_PUSH:
-            ptype = cb_ptype_at_sq(board, to);
-            cb_write_piece(board, from, ptype, board->turn);
-            cb_delete_piece(board, to, ptype, board->turn);
-            break;
-        case CB_MV_CAPTURE:
-            ptype = cb_ptype_at_sq(board, to);
-            cap_ptype = cb_hist_get_captured_piece(&old_ele.hist);
-            cb_write_piece(board, from, ptype, board->turn);
-            cb_replace_piece(board, to, cap_ptype, !board->turn, ptype, board->turn);
-            break;
-        case CB_MV_KING_SIDE_CASTLE:
-            rook_from = board->turn ? M_WHITE_KING_SIDE_ROOK_START :
-                M_BLACK_KING_SIDE_ROOK_START;
-            rook_to = board->turn ? M_WHITE_KING_SIDE_ROOK_TARGET :
-                M_BLACK_KING_SIDE_ROOK_TARGET;
-            cb_write_piece(board, from, CB_PTYPE_KING, board->turn);
-            cb_delete_piece(board, to, CB_PTYPE_KING, board->turn);
-            cb_write_piece(board, rook_from, CB_PTYPE_ROOK, board->turn);
-            cb_delete_piece(board, rook_to, CB_PTYPE_ROOK, board->turn);
-            break;
-        case CB_MV_QUEEN_SIDE_CASTLE:
-            rook_from = board->turn ? M_WHITE_QUEEN_SIDE_ROOK_START :
-                M_BLACK_QUEEN_SIDE_ROOK_START;
-            rook_to = board->turn ? M_WHITE_QUEEN_SIDE_ROOK_TARGET :
-                M_BLACK_QUEEN_SIDE_ROOK_TARGET;
-            cb_write_piece(board, from, CB_PTYPE_KING, board->turn);
-            cb_delete_piece(board, to, CB_PTYPE_KING, board->turn);
-            cb_write_piece(board, rook_from, CB_PTYPE_ROOK, board->turn);
-            cb_delete_piece(board, rook_to, CB_PTYPE_ROOK, board->turn);
-            break;
-        case CB_MV_ENPASSANT:
-            direction = board->turn ? 8 : -8;
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, to, CB_PTYPE_PAWN, board->turn);
-            cb_write_piece(board, to + direction, CB_PTYPE_PAWN, !board->turn);
-            break;
-        case CB_MV_KNIGHT_PROMO:
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, to, CB_PTYPE_KNIGHT, board->turn);
-            break;
-        case CB_MV_BISHOP_PROMO:
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, to, CB_PTYPE_BISHOP, board->turn);
-            break;
-        case CB_MV_ROOK_PROMO:
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, to, CB_PTYPE_ROOK, board->turn);
-            break;
-        case CB_MV_QUEEN_PROMO:
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_delete_piece(board, to, CB_PTYPE_QUEEN, board->turn);
-            break;
-        case CB_MV_KNIGHT_PROMO_CAPTURE:
-            cap_ptype = cb_hist_get_captured_piece(&old_ele.hist);
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_replace_piece(board, to, cap_ptype, !board->turn, CB_PTYPE_KNIGHT, board->turn);
-            break;
-        case CB_MV_BISHOP_PROMO_CAPTURE:
-            cap_ptype = cb_hist_get_captured_piece(&old_ele.hist);
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_replace_piece(board, to, cap_ptype, !board->turn, CB_PTYPE_BISHOP, board->turn);
-            break;
-        case CB_MV_ROOK_PROMO_CAPTURE:
-            cap_ptype = cb_hist_get_captured_piece(&old_ele.hist);
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_replace_piece(board, to, cap_ptype, !board->turn, CB_PTYPE_ROOK, board->turn);
-            break;
-        case CB_MV_QUEEN_PROMO_CAPTURE:
-            cap_ptype = cb_hist_get_captured_piece(&old_ele.hist);
-            cb_write_piece(board, from, CB_PTYPE_PAWN, board->turn);
-            cb_replace_piece(board, to, cap_ptype, !board->turn, CB_PTYPE_QUEEN, board->turn);
-            break;
-    }
 }
 
 cb_errno_t cb_mv_from_short_algbr(cb_error_t *err, cb_move_t *mv, cb_board_t *board,
@@ -521,9 +463,12 @@ cb_errno_t parse_fen_hlfmv(cb_error_t *err, cb_board_t *board, char *fen_hlfmv)
     if (fen_hlfmv != NULL) {
         errno = 0;
         hlfmv = strtol(fen_hlfmv, &endptr, 10);
-        if (errno || *endptr != '\0')
+        if (errno || *endptr != '\0' || hlfmv < 0)
             return cb_mkerr(err, CB_EINVAL, "invalid halfmove number");
-        cb_hist_set_halfmove_clk(&board->hist.data[board->hist.count - 1].move, hlfmv);
+
+        /* The clock stops counting well past the fifty move rule. */
+        hlfmv = hlfmv < 0xFF ? hlfmv : 0xFF;
+        cb_hist_set_halfmove_clk(&board->hist.data[board->hist.count - 1].hist, hlfmv);
     }
 
     return 0;
@@ -553,6 +498,7 @@ cb_errno_t cb_board_from_fen(cb_error_t *err, cb_board_t *board, char *fen)
         return result;
     if ((result = parse_fen_hlfmv(err, board, fen_hlfmv)) != 0)
         return result;
+    board->hist.data[board->hist.count - 1].key = cb_hash_board(board);
 
     return 0;
 }
@@ -583,6 +529,8 @@ cb_errno_t cb_board_from_uci(cb_error_t *err, cb_board_t *board, char *uci)
     while (algbr != NULL) {
         if ((result = cb_mv_from_uci_algbr(err, &mv, board, algbr)) != 0)
             return result;
+        if ((result = cb_reserve_for_make(err, board, 1)) != 0)
+            return result;
         cb_make(board, mv);
         algbr = strtok(NULL, " \n");
     }
@@ -4,10 +4,24 @@
 #include "cb_tables.h"
 #include "cb_const.h"
 
-uint64_t pawn_atks[2][64];
-uint64_t knight_atks[64];
-uint64_t king_atks[64];
-uint64_t to_from_table[64][64];
+const int8_t dir_offset_mapping[8] = { 1, -7, -8, -9, -1, 7, 8, 9 };
+
+/**
+ * @breif The non-sliding tables, kept in one block so that it can be copied to every node.
+ */
+typedef struct {
+    uint64_t pawn_atks[2][64];
+    uint64_t knight_atks[64];
+    uint64_t king_atks[64];
+    uint64_t to_from_table[64][64];
+} normal_tables_t;
+
+normal_tables_t normal_tables;
+
+const size_t CB_NORMAL_TABLE_BYTES = sizeof(normal_tables_t);
+
+/* The copy this thread reads. Every thread starts out on the master copy. */
+static _Thread_local const normal_tables_t *local_tables = &normal_tables;
 
 /**
  * Generates a lookup table from a set of offsets on each square.
@@ -43,20 +57,20 @@ void gen_table_from_offsets(uint64_t table[64], const int8_t offsets[], uint8_t
 void gen_pawn_atk_table()
 {
     const int8_t OFFSETS[2][8] = {{7, 9}, {-7, -9}};
-    gen_table_from_offsets(pawn_atks[0], OFFSETS[0], 2);
-    gen_table_from_offsets(pawn_atks[1], OFFSETS[1], 2);
+    gen_table_from_offsets(normal_tables.pawn_atks[0], OFFSETS[0], 2);
+    gen_table_from_offsets(normal_tables.pawn_atks[1], OFFSETS[1], 2);
 }
 
 void gen_knight_atk_table()
 {
     const int8_t OFFSETS[8] = {-17, -15, -10, -6, 6, 10, 15, 17};
-    gen_table_from_offsets(knight_atks, OFFSETS, 8);
+    gen_table_from_offsets(normal_tables.knight_atks, OFFSETS, 8);
 }
 
 void gen_king_atk_table()
 {
     const int8_t OFFSETS[8] = {9, 8, 7, 1, -1, -7, -8, -9};
-    gen_table_from_offsets(king_atks, OFFSETS, 8);
+    gen_table_from_offsets(normal_tables.king_atks, OFFSETS, 8);
 }
 
 /**
@@ -113,7 +127,7 @@ void gen_to_from_table()
     /* Loop over all of the squares on the board and generate the respective rays. */
     for (i = 0; i < 64; i++) {
         for (j = 0; j < 64; j++) {
-            to_from_table[i][j] = get_connecting_ray(i, j);
+            normal_tables.to_from_table[i][j] = get_connecting_ray(i, j);
         }
     }
 }
@@ -126,22 +140,32 @@ void cb_init_normal_tables()
     gen_to_from_table();
 }
 
+const void *cb_normal_tables_master()
+{
+    return &normal_tables;
+}
+
+void cb_use_normal_tables(const void *tables)
+{
+    local_tables = tables;
+}
+
 uint64_t cb_read_pawn_atk_msk(uint8_t sq, cb_color_t color)
 {
-    return pawn_atks[color][sq];
+    return local_tables->pawn_atks[color][sq];
 }
 
 uint64_t cb_read_knight_atk_msk(uint8_t sq)
 {
-    return knight_atks[sq];
+    return local_tables->knight_atks[sq];
 }
 
 uint64_t cb_read_king_atk_msk(uint8_t sq)
 {
-    return king_atks[sq];
+    return local_tables->king_atks[sq];
 }
 
 uint64_t cb_read_tf_table(uint8_t sq1, uint8_t sq2)
 {
-    return to_from_table[sq1][sq2];
+    return local_tables->to_from_table[sq1][sq2];
 }
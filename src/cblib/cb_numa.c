@@ -0,0 +1,200 @@
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "cb_lib.h"
+#include "cb_tables.h"
+
+/*
+ * Per node copies of the move generation tables.
+ *
+ * Each copy is one mapping holding the normal tables followed by the sliding attack tables. The
+ * mapping is bound to its node with mbind before it is first written, so the pages are placed
+ * there no matter which thread does the copy. Where mbind is not available the pages are placed
+ * by the kernel's first touch policy, which still keeps them off the other nodes' memory
+ * controllers as long as the copying thread is not on a remote node.
+ */
+
+#define CB_MAX_NODES 64
+
+/* Values from linux/mempolicy.h, which is not always installed. */
+#define NUMA_MPOL_BIND 2
+#define NUMA_MPOL_MF_STRICT 1
+
+/**
+ * @breif One copy of the tables.
+ */
+typedef struct {
+    void *mem;          /**< The mapping. */
+    size_t len;         /**< The length of the mapping. */
+    bool bound;         /**< Set if mbind placed the mapping on its node. */
+} table_copy_t;
+
+static table_copy_t copies[CB_MAX_NODES];
+static int num_copies;
+
+/**
+ * Returns where the sliding attack tables start in a copy. Kept on a cache line boundary.
+ */
+static inline size_t slider_offset()
+{
+    return (CB_NORMAL_TABLE_BYTES + 63) & ~(size_t)63;
+}
+
+/**
+ * Returns the number of the highest online node plus one, or 1 if it cannot be read.
+ */
+static int count_nodes()
+{
+    FILE *f;
+    char buf[256];
+    char *p;
+    long node, max = 0;
+
+    if ((f = fopen("/sys/devices/system/node/online", "r")) == NULL)
+        return 1;
+    if (fgets(buf, sizeof(buf), f) == NULL) {
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    /* The list looks like "0-3,5". Only the largest number matters. */
+    for (p = buf; *p != '\0'; p++) {
+        if (*p < '0' || *p > '9')
+            continue;
+        node = strtol(p, &p, 10);
+        max = node > max ? node : max;
+        p--;
+    }
+    return max + 1 < CB_MAX_NODES ? max + 1 : CB_MAX_NODES;
+}
+
+/**
+ * Returns the node of the cpu the calling thread is running on, or -1 if it is not known.
+ */
+static int current_node()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu, node;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+        return node;
+#endif
+    return -1;
+}
+
+/**
+ * Maps len bytes and asks for them to live on a node.
+ */
+static int alloc_on_node(table_copy_t *copy, size_t len, int node)
+{
+#ifdef __linux__
+    unsigned long mask[CB_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    void *mem;
+
+    mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return errno;
+
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << node % (8 * sizeof(unsigned long));
+#ifdef SYS_mbind
+    copy->bound = syscall(SYS_mbind, mem, len, NUMA_MPOL_BIND, mask, CB_MAX_NODES + 1,
+            NUMA_MPOL_MF_STRICT) == 0;
+#else
+    copy->bound = false;
+#endif
+    copy->mem = mem;
+    copy->len = len;
+    return 0;
+#else
+    return ENOSYS;
+#endif
+}
+
+static void free_copy(table_copy_t *copy)
+{
+#ifdef __linux__
+    if (copy->mem != NULL)
+        munmap(copy->mem, copy->len);
+#endif
+    copy->mem = NULL;
+}
+
+cb_errno_t cb_tables_replicate(cb_error_t *err, int nodes)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t len = (slider_offset() + CB_SLIDER_TABLE_BYTES + page - 1) & ~(page - 1);
+    int node, result;
+
+    cb_tables_free_copies();
+    if (nodes <= 0)
+        nodes = count_nodes();
+    nodes = nodes < CB_MAX_NODES ? nodes : CB_MAX_NODES;
+
+    /* Nothing to gain on a single node. */
+    if (nodes < 2)
+        return CB_EOK;
+
+    for (node = 0; node < nodes; node++) {
+        if ((result = alloc_on_node(&copies[node], len, node)) != 0) {
+            while (node-- > 0)
+                free_copy(&copies[node]);
+            return cb_mkerr(err, CB_ENOMEM, "mmap: %s\n", strerror(result));
+        }
+        memcpy(copies[node].mem, cb_normal_tables_master(), CB_NORMAL_TABLE_BYTES);
+        memcpy((uint8_t *)copies[node].mem + slider_offset(), cb_slider_tables_master(),
+               CB_SLIDER_TABLE_BYTES);
+    }
+
+    num_copies = nodes;
+    return CB_EOK;
+}
+
+int cb_tables_bind_node(int node)
+{
+    if (node < 0 || node >= num_copies) {
+        cb_use_normal_tables(cb_normal_tables_master());
+        cb_use_slider_tables(cb_slider_tables_master());
+        return -1;
+    }
+
+    cb_use_normal_tables(copies[node].mem);
+    cb_use_slider_tables((uint8_t *)copies[node].mem + slider_offset());
+    return node;
+}
+
+int cb_tables_bind_thread()
+{
+    return cb_tables_bind_node(current_node());
+}
+
+int cb_tables_num_copies()
+{
+    return num_copies;
+}
+
+bool cb_tables_copy_bound(int node)
+{
+    return node >= 0 && node < num_copies && copies[node].bound;
+}
+
+void cb_tables_free_copies()
+{
+    int node;
+
+    /* Threads that still point at a copy must not look anything up after this. */
+    cb_tables_bind_node(-1);
+    for (node = 0; node < num_copies; node++)
+        free_copy(&copies[node]);
+    num_copies = 0;
+}
@@ -0,0 +1,238 @@
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "cb_pool.h"
+#include "cb_lib.h"
+#include "cb_const.h"
+#include "cb_board.h"
+#include "cb_history.h"
+#include "cb_move.h"
+#include "cb_zobrist.h"
+
+/* Every array starts on its own cache line. */
+#define POOL_ALIGN 64
+
+/**
+ * Reserves len bytes at the end of a layout and returns their offset.
+ */
+static size_t pool_carve(size_t *size, size_t len)
+{
+    size_t offset = (*size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+    *size = offset + len;
+    return offset;
+}
+
+cb_errno_t cb_pool_init(cb_error_t *err, cb_pool_t *pool, uint32_t count, uint32_t hist_len)
+{
+    size_t words = (size_t)count * sizeof(uint64_t);
+    size_t size = 0;
+    size_t color_off[2], piece_off[2][6], occ_off, mb_off, hist_off;
+    size_t hist_count_off, fullmove_off, turn_off;
+    uint8_t *mem;
+    int color, ptype;
+
+    if (count == 0 || hist_len == 0)
+        return cb_mkerr(err, CB_EINVAL, "pool must hold at least one game and one ply");
+
+    /* Lay out the arrays first so that everything comes from one allocation. */
+    for (color = 0; color < 2; color++) {
+        color_off[color] = pool_carve(&size, words);
+        for (ptype = 0; ptype < 6; ptype++)
+            piece_off[color][ptype] = pool_carve(&size, words);
+    }
+    occ_off = pool_carve(&size, words);
+    mb_off = pool_carve(&size, (size_t)count * sizeof(cb_mailbox_t));
+    hist_off = pool_carve(&size, (size_t)count * hist_len * sizeof(cb_hist_ele_t));
+    hist_count_off = pool_carve(&size, (size_t)count * sizeof(uint32_t));
+    fullmove_off = pool_carve(&size, (size_t)count * sizeof(uint32_t));
+    turn_off = pool_carve(&size, (size_t)count * sizeof(uint8_t));
+    size = pool_carve(&size, 0);
+
+    if ((mem = aligned_alloc(POOL_ALIGN, size)) == NULL)
+        return cb_mkerr(err, CB_ENOMEM, "aligned_alloc: %s\n", strerror(errno));
+    memset(mem, 0, size);
+
+    for (color = 0; color < 2; color++) {
+        pool->color[color] = (uint64_t *)(mem + color_off[color]);
+        for (ptype = 0; ptype < 6; ptype++)
+            pool->piece[color][ptype] = (uint64_t *)(mem + piece_off[color][ptype]);
+    }
+    pool->occ = (uint64_t *)(mem + occ_off);
+    pool->mb = (cb_mailbox_t *)(mem + mb_off);
+    pool->hist = (cb_hist_ele_t *)(mem + hist_off);
+    pool->hist_count = (uint32_t *)(mem + hist_count_off);
+    pool->fullmove_num = (uint32_t *)(mem + fullmove_off);
+    pool->turn = (uint8_t *)(mem + turn_off);
+    pool->count = count;
+    pool->hist_len = hist_len;
+    pool->mem = mem;
+
+    /* Empty games have empty mailboxes, not boards full of pawns. */
+    memset(pool->mb, CB_PTYPE_EMPTY, (size_t)count * sizeof(cb_mailbox_t));
+    return CB_EOK;
+}
+
+void cb_pool_free(cb_pool_t *pool)
+{
+    free(pool->mem);
+    pool->mem = NULL;
+}
+
+cb_errno_t cb_pool_load(cb_error_t *err, cb_pool_t *pool, uint32_t id, const cb_board_t *board)
+{
+    cb_board_t view;
+
+    if (id >= pool->count)
+        return cb_mkerr(err, CB_EINVAL, "game id %u out of range", id);
+    if ((uint32_t)board->hist.count > pool->hist_len)
+        return cb_mkerr(err, CB_EINVAL, "history of %d plies does not fit in %u slots",
+                board->hist.count, pool->hist_len);
+
+    /* Copy the history straight into the slab and everything else through a view. */
+    view = *board;
+    view.hist.data = pool->hist + (size_t)id * pool->hist_len;
+    memcpy(view.hist.data, board->hist.data, board->hist.count * sizeof(cb_hist_ele_t));
+    cb_pool_sync(pool, id, &view);
+    return CB_EOK;
+}
+
+cb_errno_t cb_pool_store(cb_error_t *err, cb_board_t *board, const cb_pool_t *pool,
+                         uint32_t id)
+{
+    cb_hist_stack_t hist = board->hist;
+    cb_board_t view;
+    cb_errno_t result;
+
+    if (id >= pool->count)
+        return cb_mkerr(err, CB_EINVAL, "game id %u out of range", id);
+
+    /* Make room on the board's own stack before anything is overwritten. */
+    hist.count = 0;
+    if ((result = cb_hist_stack_reserve(&hist, pool->hist_count[id])) != 0)
+        return cb_mkerr(err, result, "realloc: %s\n", strerror(errno));
+
+    cb_pool_view(&view, pool, id);
+    memcpy(hist.data, view.hist.data, view.hist.count * sizeof(cb_hist_ele_t));
+    hist.count = view.hist.count;
+    *board = view;
+    board->hist = hist;
+    return CB_EOK;
+}
+
+/*
+ * Quiet moves and captures are made and unmade straight on the arrays, touching only the
+ * bitboards that change. Everything else goes through a view and cb_make so that the rules for
+ * castles, enpassant and promotions stay in one place.
+ */
+
+void cb_pool_make(cb_pool_t *pool, uint32_t id, cb_move_t mv)
+{
+    cb_hist_ele_t *top = pool->hist + (size_t)id * pool->hist_len + pool->hist_count[id] - 1;
+    cb_history_t old_state = top->hist;
+    cb_history_t new_state = old_state;
+    cb_mv_flag_t flag = cb_mv_get_flags(mv);
+    uint8_t to = cb_mv_get_to(mv);
+    uint8_t from = cb_mv_get_from(mv);
+    uint8_t turn = pool->turn[id];
+    uint64_t from_bb = UINT64_C(1) << from;
+    uint64_t to_bb = UINT64_C(1) << to;
+    cb_ptype_t ptype, cap_ptype;
+    uint64_t key;
+    cb_board_t view;
+
+    /* An open enpassant square changes the key in ways only the full board can tell. */
+    if ((flag != CB_MV_QUIET && flag != CB_MV_CAPTURE) || cb_hist_enp_availiable(old_state)) {
+        cb_pool_view(&view, pool, id);
+        cb_make(&view, mv);
+        cb_pool_sync(pool, id, &view);
+        return;
+    }
+
+    ptype = pool->mb[id].data[from];
+    cap_ptype = pool->mb[id].data[to];
+    cb_hist_set_captured_piece(&new_state, cap_ptype);
+    cb_hist_decay_castle_rights(&new_state, turn, to, from);
+
+    /* The halfmove clock starts over on pawn moves and captures, as in cb_make. */
+    if (ptype == CB_PTYPE_PAWN || cap_ptype != CB_PTYPE_EMPTY)
+        cb_hist_reset_halfmove_clk(&new_state);
+    else
+        cb_hist_inc_halfmove_clk(&new_state);
+
+    key = top->key ^ cb_zobrist.piece[turn][ptype][from] ^ cb_zobrist.piece[turn][ptype][to]
+        ^ cb_zobrist.turn ^ cb_zobrist.castle[(old_state ^ new_state) & 0xF];
+    if (cap_ptype != CB_PTYPE_EMPTY) {
+        pool->piece[!turn][cap_ptype][id] ^= to_bb;
+        pool->color[!turn][id] ^= to_bb;
+        key ^= cb_zobrist.piece[!turn][cap_ptype][to];
+    }
+    pool->piece[turn][ptype][id] ^= from_bb | to_bb;
+    pool->color[turn][id] ^= from_bb | to_bb;
+    pool->occ[id] = (pool->occ[id] ^ from_bb) | to_bb;
+    pool->mb[id].data[to] = ptype;
+    pool->mb[id].data[from] = CB_PTYPE_EMPTY;
+    pool->turn[id] = !turn;
+
+    top[1].hist = new_state;
+    top[1].move = mv;
+    top[1].key = key;
+    pool->hist_count[id]++;
+}
+
+void cb_pool_unmake(cb_pool_t *pool, uint32_t id)
+{
+    cb_hist_ele_t *top = pool->hist + (size_t)id * pool->hist_len + pool->hist_count[id] - 1;
+    cb_mv_flag_t flag = cb_mv_get_flags(top->move);
+    uint8_t to = cb_mv_get_to(top->move);
+    uint8_t from = cb_mv_get_from(top->move);
+    uint8_t turn = !pool->turn[id];
+    uint64_t from_bb = UINT64_C(1) << from;
+    uint64_t to_bb = UINT64_C(1) << to;
+    cb_ptype_t ptype, cap_ptype;
+    cb_board_t view;
+
+    if (flag != CB_MV_QUIET && flag != CB_MV_CAPTURE && flag != CB_MV_DOUBLE_PAWN_PUSH) {
+        cb_pool_view(&view, pool, id);
+        cb_unmake(&view);
+        cb_pool_sync(pool, id, &view);
+        return;
+    }
+
+    ptype = pool->mb[id].data[to];
+    cap_ptype = flag == CB_MV_CAPTURE ? cb_hist_get_captured_piece(&top->hist) : CB_PTYPE_EMPTY;
+    pool->piece[turn][ptype][id] ^= from_bb | to_bb;
+    pool->color[turn][id] ^= from_bb | to_bb;
+    pool->occ[id] |= from_bb;
+    pool->mb[id].data[from] = ptype;
+    pool->mb[id].data[to] = cap_ptype;
+    if (cap_ptype != CB_PTYPE_EMPTY) {
+        pool->piece[!turn][cap_ptype][id] ^= to_bb;
+        pool->color[!turn][id] ^= to_bb;
+    } else {
+        pool->occ[id] ^= to_bb;
+    }
+    pool->turn[id] = turn;
+    pool->hist_count[id]--;
+}
+
+void cb_pool_gen_moves(cb_mvlst_t *mvlst, cb_pool_t *pool, uint32_t id)
+{
+    cb_state_tables_t state;
+    cb_board_t view;
+
+    cb_pool_view(&view, pool, id);
+    cb_gen_board_tables(&state, &view);
+    cb_gen_moves(mvlst, &view, &state);
+}
+
+void cb_pool_step(cb_pool_t *pool, const cb_move_t *mvs)
+{
+    uint32_t id;
+
+    for (id = 0; id < pool->count; id++) {
+        if (mvs[id] != CB_INVALID_MOVE)
+            cb_pool_make(pool, id, mvs[id]);
+    }
+}
@@ -0,0 +1,92 @@
+
+#include "cb_zobrist.h"
+#include "cb_board.h"
+#include "cb_bitutil.h"
+
+/* Any fixed seed works. Keeping it fixed makes keys comparable between runs. */
+#define ZOBRIST_SEED UINT64_C(0x5EED0F2B7C1A9D43)
+
+cb_zobrist_t cb_zobrist;
+
+/**
+ * Splitmix64. Every output of a 64-bit counter is distinct, so no two keys collide.
+ */
+static uint64_t next_key(uint64_t *state)
+{
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+void cb_init_zobrist()
+{
+    uint64_t state = ZOBRIST_SEED;
+    int color, ptype, sq, i;
+
+    for (color = 0; color < 2; color++) {
+        for (ptype = 0; ptype < 6; ptype++) {
+            for (sq = 0; sq < 64; sq++)
+                cb_zobrist.piece[color][ptype][sq] = next_key(&state);
+        }
+    }
+
+    /* The castle keys are built from one key per right so that losing a right is one xor. */
+    for (i = 0; i < 4; i++)
+        cb_zobrist.castle[1 << i] = next_key(&state);
+    for (i = 0; i < 16; i++) {
+        cb_zobrist.castle[i] = (i & 1 ? cb_zobrist.castle[1] : 0)
+            ^ (i & 2 ? cb_zobrist.castle[2] : 0)
+            ^ (i & 4 ? cb_zobrist.castle[4] : 0)
+            ^ (i & 8 ? cb_zobrist.castle[8] : 0);
+    }
+
+    for (i = 0; i < 8; i++)
+        cb_zobrist.enp[i] = next_key(&state);
+    cb_zobrist.turn = next_key(&state);
+}
+
+bool cb_zobrist_enp_legal(const cb_board_t *board, uint8_t enp_sq, uint64_t sources)
+{
+    const uint64_t *enemy = board->bb.piece[!board->turn];
+    uint8_t king_sq = peek_rbit(board->bb.piece[board->turn][CB_PTYPE_KING]);
+    uint8_t cap_sq = enp_sq + (board->turn == CB_WHITE ? 8 : -8);
+    uint64_t pawns = enemy[CB_PTYPE_PAWN] & ~(UINT64_C(1) << cap_sq);
+    uint64_t occ;
+
+    /* Look at the king on the board after each capture. */
+    while (sources) {
+        occ = board->bb.occ ^ (UINT64_C(1) << pop_rbit(&sources)) ^ (UINT64_C(1) << cap_sq)
+            ^ (UINT64_C(1) << enp_sq);
+        if ((cb_read_pawn_atk_msk(king_sq, board->turn) & pawns)
+                | (cb_read_knight_atk_msk(king_sq) & enemy[CB_PTYPE_KNIGHT])
+                | (cb_read_bishop_atk_msk(king_sq, occ)
+                    & (enemy[CB_PTYPE_BISHOP] | enemy[CB_PTYPE_QUEEN]))
+                | (cb_read_rook_atk_msk(king_sq, occ)
+                    & (enemy[CB_PTYPE_ROOK] | enemy[CB_PTYPE_QUEEN])))
+            continue;
+        return true;
+    }
+
+    return false;
+}
+
+uint64_t cb_hash_board(const cb_board_t *board)
+{
+    cb_history_t hist = board->hist.data[board->hist.count - 1].hist;
+    uint64_t key = 0;
+    uint64_t occ = board->bb.occ;
+    uint8_t sq;
+
+    while (occ) {
+        sq = pop_rbit(&occ);
+        key ^= cb_zobrist.piece[cb_color_at_sq(board, sq)][cb_ptype_at_sq(board, sq)][sq];
+    }
+
+    key ^= cb_zobrist.castle[hist & 0xF];
+    key ^= cb_zobrist_enp(board, hist);
+    if (board->turn == CB_WHITE)
+        key ^= cb_zobrist.turn;
+
+    return key;
+}
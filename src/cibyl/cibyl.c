@@ -32,5 +32,16 @@ void cibyl_write_log(char *format, ...)
 
 int main()
 {
-    return 0;
+    cibyl_errno_t result;
+
+    /* Errors go to stderr so they never reach the GUI. */
+    log_file = stderr;
+    if (mtx_init(&log_mtx, mtx_plain) != thrd_success)
+        return 1;
+
+    if ((result = uci_init(&engine)) == CIBYL_EOK)
+        result = uci_process(&engine);
+
+    mtx_destroy(&log_mtx);
+    return result == CIBYL_EOK ? 0 : 1;
 }
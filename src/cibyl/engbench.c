@@ -0,0 +1,423 @@
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "cb_lib.h"
+#include "crosstime.h"
+#include "bench.h"
+#include "eval.h"
+#include "perfcnt.h"
+#include "engbench.h"
+
+bool engbench_counters = false;
+
+/**
+ * @breif The totals of one pass over the bench positions.
+ */
+typedef struct {
+    uint64_t nodes;         /**< Nodes searched by every thinker. */
+    uint64_t qnodes;        /**< The part of nodes searched in quiescence. */
+    uint64_t cutoffs;       /**< Beta cutoffs of the main search. */
+    uint64_t first_cutoffs; /**< The part of cutoffs made by the first move. */
+    uint64_t time_ns;       /**< Wall time from go to bestmove. */
+    perfcnt_t pc;           /**< Hardware counters of the searches, if requested. */
+} bench_pass_t;
+
+/**
+ * @breif Searches every bench position once with the current options.
+ *
+ * With engbench_counters set the thinkers are spawned again under hardware counters that run
+ * only between go and bestmove. The counters are left open for print_pass_counters.
+ */
+static cibyl_errno_t run_pass(engine_t *eng, const go_param_t *params, bench_pass_t *pass)
+{
+    perfcnt_t *pc = &pass->pc;
+    char fen[256];
+    int i;
+
+    pass->nodes = 0;
+    pass->qnodes = 0;
+    pass->cutoffs = 0;
+    pass->first_cutoffs = 0;
+    pass->time_ns = 0;
+
+    /* The counters stay closed when not requested, which makes start and stop no-ops. */
+    perfcnt_init(pc);
+    if (engbench_counters) {
+        if (perfcnt_open_threads(pc, true) == 0)
+            printf("No hardware performance counters are available\n");
+        if (eng_respawn_thinkers(eng) != CIBYL_EOK)
+            goto err_close;
+    }
+
+    for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+        snprintf(fen, sizeof(fen), "fen %s", BENCH_POSITIONS[i]);
+        if (eng_set_ucifen(eng, fen) != CIBYL_EOK
+                || eng_set_option(eng, "Clear Hash", NULL) != CIBYL_EOK)
+            goto err_close;
+
+        /* Leave the position setup and the hash clear out of the counts. */
+        if (i == 0)
+            perfcnt_start(pc);
+        else
+            perfcnt_resume(pc);
+        eng_notify_go(eng, params);
+        eng_await_search(eng);
+        perfcnt_pause(pc);
+
+        pass->nodes += eng->result.nodes;
+        pass->qnodes += eng->result.qnodes;
+        pass->cutoffs += eng->result.cutoffs;
+        pass->first_cutoffs += eng->result.first_cutoffs;
+        pass->time_ns += eng->result.time_ns;
+    }
+
+    perfcnt_stop(pc);
+    return CIBYL_EOK;
+
+err_close:
+    perfcnt_close(pc);
+    return CIBYL_EABORT;
+}
+
+/**
+ * @breif Prints the counters of a pass from run_pass under its row, then closes them.
+ */
+static void print_pass_counters(bench_pass_t *pass)
+{
+    if (engbench_counters) {
+        perfcnt_print(stdout, &pass->pc, pass->nodes);
+        printf("\n");
+    }
+    perfcnt_close(&pass->pc);
+}
+
+cibyl_errno_t engbench_threads(engine_t *eng, int depth, int max_threads, bool ybwc)
+{
+    int64_t old_threads = eng->options[ENG_OPT_THREADS];
+    int64_t old_ybwc = eng->options[ENG_OPT_YBWC];
+    cibyl_errno_t result = CIBYL_EOK;
+    go_param_t params;
+    bench_pass_t pass;
+    bench_pass_t base = { 0 };
+    char threads[16];
+    int t;
+
+    clear_go_params(&params);
+    params.depth = depth;
+    if ((result = eng_set_option(eng, "YBWC", ybwc ? "true" : "false")) != CIBYL_EOK)
+        return result;
+
+    printf("%s time to depth %d over %d positions\n", ybwc ? "ybwc" : "lazy smp", depth,
+           BENCH_NUM_POSITIONS);
+    printf("%8s %10s %14s %12s %8s %8s %8s %8s\n", "threads", "time ms", "nodes", "nps",
+           "speedup", "nodes x", "qnodes %", "1st cut %");
+    eng->quiet = true;
+    for (t = 1; t <= max_threads; t++) {
+        snprintf(threads, sizeof(threads), "%d", t);
+        if ((result = eng_set_option(eng, "Threads", threads)) != CIBYL_EOK
+                || (result = run_pass(eng, &params, &pass)) != CIBYL_EOK)
+            break;
+        if (t == 1)
+            base = pass;
+
+        printf("%8d %10" PRIu64 " %14" PRIu64 " %12" PRIu64 " %8.2f %8.2f %8.1f %8.1f\n", t,
+               pass.time_ns / 1000000, pass.nodes,
+               pass.nodes * UINT64_C(1000000000) / (pass.time_ns + 1),
+               (double)base.time_ns / (pass.time_ns + 1),
+               (double)pass.nodes / (base.nodes + 1),
+               100.0 * pass.qnodes / (pass.nodes + 1),
+               100.0 * pass.first_cutoffs / (pass.cutoffs + 1));
+        print_pass_counters(&pass);
+    }
+    eng->quiet = false;
+
+    snprintf(threads, sizeof(threads), "%" PRId64, old_threads);
+    eng_set_option(eng, "Threads", threads);
+    eng_set_option(eng, "YBWC", old_ybwc ? "true" : "false");
+    return result;
+}
+
+/* The switches of the pruning techniques. */
+static const eng_opt_t PRUNING_OPTS[] = {
+    ENG_OPT_NULL_MOVE, ENG_OPT_LMR, ENG_OPT_RFP, ENG_OPT_FUTILITY, ENG_OPT_RAZORING
+};
+#define NUM_PRUNING_OPTS ((int)(sizeof(PRUNING_OPTS) / sizeof(PRUNING_OPTS[0])))
+
+/**
+ * @breif Switches the pruning techniques in mask on and the rest off.
+ */
+static cibyl_errno_t set_pruning(engine_t *eng, unsigned mask)
+{
+    cibyl_errno_t result;
+    int i;
+
+    for (i = 0; i < NUM_PRUNING_OPTS; i++) {
+        if ((result = eng_set_option(eng, ENG_OPTIONS[PRUNING_OPTS[i]].name,
+                                     mask & 1u << i ? "true" : "false")) != CIBYL_EOK)
+            return result;
+    }
+    return CIBYL_EOK;
+}
+
+cibyl_errno_t engbench_pruning(engine_t *eng, int depth)
+{
+    unsigned old_mask = 0;
+    unsigned all = (1u << NUM_PRUNING_OPTS) - 1;
+    cibyl_errno_t result = CIBYL_EOK;
+    go_param_t params;
+    bench_pass_t pass;
+    bench_pass_t base = { 0 };
+    int i;
+
+    for (i = 0; i < NUM_PRUNING_OPTS; i++)
+        old_mask |= eng->options[PRUNING_OPTS[i]] ? 1u << i : 0;
+    clear_go_params(&params);
+    params.depth = depth;
+
+    printf("pruning at depth %d over %d positions\n", depth, BENCH_NUM_POSITIONS);
+    printf("%22s %10s %14s %8s\n", "pruning", "time ms", "nodes", "nodes x");
+    eng->quiet = true;
+
+    /* Pass -1 has nothing on, the last pass has everything on. */
+    for (i = -1; i <= NUM_PRUNING_OPTS; i++) {
+        if ((result = set_pruning(eng, i < 0 ? 0 : i == NUM_PRUNING_OPTS ? all : 1u << i))
+                != CIBYL_EOK || (result = run_pass(eng, &params, &pass)) != CIBYL_EOK)
+            break;
+        if (i < 0)
+            base = pass;
+
+        printf("%22s %10" PRIu64 " %14" PRIu64 " %8.3f\n",
+               i < 0 ? "none" : i == NUM_PRUNING_OPTS ? "all"
+               : ENG_OPTIONS[PRUNING_OPTS[i]].name,
+               pass.time_ns / 1000000, pass.nodes, (double)pass.nodes / (base.nodes + 1));
+        print_pass_counters(&pass);
+    }
+    eng->quiet = false;
+
+    set_pruning(eng, old_mask);
+    return result;
+}
+
+cibyl_errno_t engbench_movegen(engine_t *eng, int depth)
+{
+    const eng_option_t *opt = &ENG_OPTIONS[ENG_OPT_MOVEGEN];
+    int64_t old_mode = eng->options[ENG_OPT_MOVEGEN];
+    cibyl_errno_t result = CIBYL_EOK;
+    go_param_t params;
+    bench_pass_t pass;
+    int mode;
+
+    clear_go_params(&params);
+    params.depth = depth;
+
+    printf("move generation at depth %d over %d positions\n", depth, BENCH_NUM_POSITIONS);
+    printf("%8s %10s %14s %10s %8s\n", "movegen", "time ms", "nodes", "ns/node", "qnodes %");
+    eng->quiet = true;
+    for (mode = 0; mode <= opt->max; mode++) {
+        if ((result = eng_set_option(eng, opt->name, opt->vars[mode])) != CIBYL_EOK
+                || (result = run_pass(eng, &params, &pass)) != CIBYL_EOK)
+            break;
+
+        printf("%8s %10" PRIu64 " %14" PRIu64 " %10.1f %8.1f\n", opt->vars[mode],
+               pass.time_ns / 1000000, pass.nodes, (double)pass.time_ns / (pass.nodes + 1),
+               100.0 * pass.qnodes / (pass.nodes + 1));
+        print_pass_counters(&pass);
+    }
+    eng->quiet = false;
+
+    eng_set_option(eng, opt->name, opt->vars[old_mode]);
+    return result;
+}
+
+/**
+ * @breif The ways bench_evals can score the children of a position.
+ */
+typedef enum {
+    EVAL_MODE_NONE,         /**< Only make and unmake the moves. */
+    EVAL_MODE_FULL,         /**< Walk the board of every child. */
+    EVAL_MODE_INCREMENTAL   /**< Update the eval terms of the parent. */
+} eval_mode_t;
+
+/**
+ * @breif Plays every move of a list iterations times and scores each child with mode. Returns
+ * the time it took.
+ */
+static uint64_t bench_evals(cb_board_t *board, const cb_mvlst_t *mvlst, int iterations,
+                            eval_mode_t mode)
+{
+    eval_state_t root, state;
+    uint64_t start = time_ns();
+    uint64_t sum = 0;
+    cb_move_t mv;
+    int i, j;
+
+    eval_state_init(&root, board);
+    for (i = 0; i < iterations; i++) {
+        for (j = 0; j < cb_mvlst_size((cb_mvlst_t *)mvlst); j++) {
+            mv = mvlst->moves[j];
+            state = root;
+            if (mode == EVAL_MODE_INCREMENTAL)
+                eval_state_make(&state, board, mv);
+            cb_make(board, mv);
+            if (mode == EVAL_MODE_FULL)
+                sum += eval(board);
+            else if (mode == EVAL_MODE_INCREMENTAL)
+                sum += eval_state_score(&state, board->turn);
+            cb_unmake(board);
+        }
+    }
+    bench_sink += sum;
+
+    return time_ns() - start;
+}
+
+/**
+ * @breif Counts the children of the board whose incremental eval is not the full eval.
+ */
+static int count_eval_mismatches(cb_board_t *board, const cb_mvlst_t *mvlst)
+{
+    eval_state_t root, state;
+    cb_move_t mv;
+    int mismatches = 0;
+    int j;
+
+    eval_state_init(&root, board);
+    for (j = 0; j < cb_mvlst_size((cb_mvlst_t *)mvlst); j++) {
+        mv = mvlst->moves[j];
+        state = root;
+        eval_state_make(&state, board, mv);
+        cb_make(board, mv);
+        mismatches += eval_state_score(&state, board->turn) != eval(board);
+        cb_unmake(board);
+    }
+
+    return mismatches;
+}
+
+/* The names of the eval modes as printed over their counters. */
+static const char *const EVAL_MODE_NAMES[] = { "make/unmake", "full", "incremental" };
+
+/**
+ * @breif Plays the moves of every bench position under hardware counters and prints them once
+ * for each eval mode. Counts the make and unmake of every mode, as in EVAL_MODE_NONE.
+ */
+static cibyl_errno_t count_evals(engine_t *eng, int iterations)
+{
+    cb_board_t *board = &eng->board;
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    perfcnt_t pc;
+    uint64_t evals;
+    char fen[256];
+    int mode, i;
+
+    for (mode = EVAL_MODE_NONE; mode <= EVAL_MODE_INCREMENTAL; mode++) {
+        printf("\n%s counters, per eval\n", EVAL_MODE_NAMES[mode]);
+        if (perfcnt_open(&pc) == 0)
+            printf("No hardware performance counters are available\n");
+
+        evals = 0;
+        for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+            snprintf(fen, sizeof(fen), "fen %s", BENCH_POSITIONS[i]);
+            if (eng_set_ucifen(eng, fen) != CIBYL_EOK) {
+                perfcnt_close(&pc);
+                return CIBYL_EABORT;
+            }
+
+            cb_gen_board_tables(&state, board);
+            cb_gen_moves(&mvlst, board, &state);
+            if (i == 0)
+                perfcnt_start(&pc);
+            else
+                perfcnt_resume(&pc);
+            bench_evals(board, &mvlst, iterations, mode);
+            perfcnt_pause(&pc);
+            evals += (uint64_t)iterations * cb_mvlst_size(&mvlst);
+        }
+        perfcnt_stop(&pc);
+        perfcnt_print(stdout, &pc, evals);
+        perfcnt_close(&pc);
+    }
+
+    return CIBYL_EOK;
+}
+
+cibyl_errno_t engbench_eval(engine_t *eng, int iterations)
+{
+    cb_board_t *board = &eng->board;
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    uint64_t base_ns = 0, full_ns = 0, inc_ns = 0, evals = 0;
+    double full_s, inc_s;
+    char fen[256];
+    int mismatches = 0;
+    int i;
+
+    for (i = 0; i < BENCH_NUM_POSITIONS; i++) {
+        snprintf(fen, sizeof(fen), "fen %s", BENCH_POSITIONS[i]);
+        if (eng_set_ucifen(eng, fen) != CIBYL_EOK)
+            return CIBYL_EABORT;
+
+        cb_gen_board_tables(&state, board);
+        cb_gen_moves(&mvlst, board, &state);
+        mismatches += count_eval_mismatches(board, &mvlst);
+        base_ns += bench_evals(board, &mvlst, iterations, EVAL_MODE_NONE);
+        full_ns += bench_evals(board, &mvlst, iterations, EVAL_MODE_FULL);
+        inc_ns += bench_evals(board, &mvlst, iterations, EVAL_MODE_INCREMENTAL);
+        evals += (uint64_t)iterations * cb_mvlst_size(&mvlst);
+    }
+
+    /* Without the time to make and unmake, and never below a nanosecond. */
+    full_s = (full_ns > base_ns ? full_ns - base_ns : 1) / 1e9;
+    inc_s = (inc_ns > base_ns ? inc_ns - base_ns : 1) / 1e9;
+    printf("eval over %d positions, %" PRIu64 " evals each\n", BENCH_NUM_POSITIONS, evals);
+    printf("%12s %10s %14s\n", "eval", "time ms", "evals/s");
+    printf("%12s %10.1f %14.0f\n", "full", full_s * 1e3, evals / full_s);
+    printf("%12s %10.1f %14.0f\n", "incremental", inc_s * 1e3, evals / inc_s);
+    printf("%d children disagree\n", mismatches);
+
+    if (engbench_counters && count_evals(eng, iterations) != CIBYL_EOK)
+        return CIBYL_EABORT;
+    return mismatches == 0 ? CIBYL_EOK : CIBYL_EABORT;
+}
+
+/* Positions the side to move can only draw. White is two rooks down but gives a perpetual with
+ * Qh5+ Kg8 Qe8+ Kh7. Then a queen up with every move running out the fifty move rule. */
+static const char *const DRAW_POSITIONS[] = {
+    "8/5ppk/8/8/8/8/rr3PPP/3Q2K1 w - - 0 1",
+    "8/8/8/4k3/8/8/8/KQ6 w - - 99 80",
+};
+#define NUM_DRAW_POSITIONS (int)(sizeof(DRAW_POSITIONS) / sizeof(DRAW_POSITIONS[0]))
+
+cibyl_errno_t engbench_draws(engine_t *eng, int depth)
+{
+    go_param_t params;
+    char fen[256];
+    int failures = 0;
+    int i;
+
+    clear_go_params(&params);
+    params.depth = depth;
+
+    printf("draws at depth %d\n", depth);
+    eng->quiet = true;
+    for (i = 0; i < NUM_DRAW_POSITIONS; i++) {
+        snprintf(fen, sizeof(fen), "fen %s", DRAW_POSITIONS[i]);
+        if (eng_set_ucifen(eng, fen) != CIBYL_EOK
+                || eng_set_option(eng, "Clear Hash", NULL) != CIBYL_EOK) {
+            eng->quiet = false;
+            return CIBYL_EABORT;
+        }
+
+        eng_notify_go(eng, &params);
+        eng_await_search(eng);
+        failures += eng->result.score != 0;
+        printf("%6s %6d  %s\n", eng->result.score == 0 ? "ok" : "FAIL", eng->result.score,
+               DRAW_POSITIONS[i]);
+    }
+    eng->quiet = false;
+
+    printf("%d of %d draws found\n", NUM_DRAW_POSITIONS - failures, NUM_DRAW_POSITIONS);
+    return failures == 0 ? CIBYL_EOK : CIBYL_EABORT;
+}
@@ -7,11 +7,69 @@
 #endif
 
 #include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <inttypes.h>
 #include "engine.h"
+#include "thinker.h"
+#include "split.h"
+#include "movepick.h"
+#include "crosstime.h"
 
-#define THINKER_POOL_COUNT 10
+#define THINKER_POOL_MAX 256
+#define ENG_FEN_LEN 8192
+#define STARTPOS_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+static const char *const MOVEGEN_VARS[] = { "legal", "pseudo" };
+
+const eng_option_t ENG_OPTIONS[ENG_OPT_COUNT] = {
+    [ENG_OPT_HASH] = { "Hash", ENG_OPT_SPIN, TT_DEFAULT_MB, 1, TT_MAX_MB },
+    [ENG_OPT_CLEAR_HASH] = { "Clear Hash", ENG_OPT_BUTTON, 0, 0, 0 },
+    [ENG_OPT_THREADS] = { "Threads", ENG_OPT_SPIN, 1, 1, THINKER_POOL_MAX },
+    [ENG_OPT_YBWC] = { "YBWC", ENG_OPT_CHECK, 0, 0, 1 },
+    [ENG_OPT_MOVE_OVERHEAD] = { "Move Overhead", ENG_OPT_SPIN, 30, 0, 5000 },
+    [ENG_OPT_PONDER] = { "Ponder", ENG_OPT_CHECK, 0, 0, 1 },
+    [ENG_OPT_NULL_MOVE] = { "NullMove", ENG_OPT_CHECK, 1, 0, 1 },
+    [ENG_OPT_NULL_MOVE_R] = { "NullMoveReduction", ENG_OPT_SPIN, 3, 1, 6 },
+    [ENG_OPT_NULL_VERIFY] = { "NullMoveVerifyDepth", ENG_OPT_SPIN, 10, 1, THINK_MAX_PLY },
+    [ENG_OPT_LMR] = { "LMR", ENG_OPT_CHECK, 1, 0, 1 },
+    [ENG_OPT_LMR_BASE] = { "LMRBase", ENG_OPT_SPIN, 75, 0, 300 },
+    [ENG_OPT_LMR_DIVISOR] = { "LMRDivisor", ENG_OPT_SPIN, 225, 100, 1000 },
+    [ENG_OPT_RFP] = { "ReverseFutility", ENG_OPT_CHECK, 1, 0, 1 },
+    [ENG_OPT_RFP_DEPTH] = { "ReverseFutilityDepth", ENG_OPT_SPIN, 6, 1, 16 },
+    [ENG_OPT_RFP_MARGIN] = { "ReverseFutilityMargin", ENG_OPT_SPIN, 80, 0, 1000 },
+    [ENG_OPT_FUTILITY] = { "Futility", ENG_OPT_CHECK, 1, 0, 1 },
+    [ENG_OPT_FUTILITY_DEPTH] = { "FutilityDepth", ENG_OPT_SPIN, 3, 1, 16 },
+    [ENG_OPT_FUTILITY_MARGIN] = { "FutilityMargin", ENG_OPT_SPIN, 120, 0, 1000 },
+    [ENG_OPT_RAZORING] = { "Razoring", ENG_OPT_CHECK, 1, 0, 1 },
+    [ENG_OPT_RAZOR_DEPTH] = { "RazorDepth", ENG_OPT_SPIN, 2, 1, 16 },
+    [ENG_OPT_RAZOR_MARGIN] = { "RazorMargin", ENG_OPT_SPIN, 250, 0, 2000 },
+    [ENG_OPT_MOVEGEN] = { "MoveGen", ENG_OPT_COMBO, ENG_MOVEGEN_LEGAL, 0, 1, MOVEGEN_VARS }
+};
+
+void eng_write_msg(engine_t *eng, char *format, ...)
+{
+    char buf[ENG_MSG_LEN];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    len = len < (int)sizeof(buf) ? len : (int)sizeof(buf) - 1;
+
+    /* Messages are shorter than PIPE_BUF, so a single write is never interleaved with the
+     * messages of another thread. */
+#ifdef _WIN32
+    WriteFile(eng->h_msg_write, buf, len, NULL, NULL);
+#else
+    if (write(eng->msg_pipe[1], buf, len) != len)
+        cibyl_write_log("eng_write_msg: write: %s\n", strerror(errno));
+#endif
+}
 
 /**
  * @breif Handles errors in a thinker thread.
@@ -55,16 +113,222 @@ int thinker_handle_err(engine_t *eng, char *format, ...)
     thrd_exit(1);
 }
 
-int thinker_entry(void *eng_addr)
+/**
+ * @breif Sends the bestmove of the main thinker. Called with sync_mtx held once every helper
+ * has stopped.
+ */
+static void report_bestmove(engine_t *eng)
 {
-    int result;
-    engine_t *eng = (engine_t *)eng_addr;
+    thinker_t *main = &eng->thinkers[0];
+    thinker_t *deepest = main;
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    char mv_str[6] = "0000";
+    char ponder_str[6];
+    int i;
+
+    /* The helpers may use up a node limit before the main thinker completes a depth. Take the
+     * deepest of theirs. Under YBWC they never complete one. */
+    for (i = 1; i < eng->num_thinkers && main->best_move == CB_INVALID_MOVE; i++) {
+        if (eng->thinkers[i].best_move != CB_INVALID_MOVE && (deepest == main
+                    || eng->thinkers[i].depth > deepest->depth))
+            deepest = &eng->thinkers[i];
+    }
+    if (deepest != main) {
+        main->best_move = deepest->best_move;
+        main->best_score = deepest->best_score;
+        main->depth = deepest->depth;
+        memcpy(main->best_pv, deepest->best_pv, deepest->best_pv_len * sizeof(cb_move_t));
+        main->best_pv_len = deepest->best_pv_len;
+    }
+
+    /* Stopped before the first depth completed. Any legal move beats none. */
+    if (main->best_move == CB_INVALID_MOVE) {
+        cb_gen_board_tables(&state, &eng->board);
+        cb_gen_moves(&mvlst, &eng->board, &state);
+        if (cb_mvlst_size(&mvlst) > 0)
+            main->best_move = cb_mvlst_at(&mvlst, 0);
+    }
+
+    eng->result.best_move = main->best_move;
+    eng->result.score = main->best_score;
+    eng->result.depth = main->depth;
+    eng->result.time_ns = time_ns() - eng->start_ns;
+    eng->result.nodes = 0;
+    eng->result.qnodes = 0;
+    eng->result.cutoffs = 0;
+    eng->result.first_cutoffs = 0;
+    for (i = 0; i < eng->num_thinkers; i++) {
+        eng->result.nodes += atomic_load(&eng->thinkers[i].nodes);
+        eng->result.qnodes += atomic_load(&eng->thinkers[i].qnodes);
+        eng->result.cutoffs += atomic_load(&eng->thinkers[i].cutoffs);
+        eng->result.first_cutoffs += atomic_load(&eng->thinkers[i].first_cutoffs);
+    }
+
+    if (main->best_move != CB_INVALID_MOVE)
+        cb_mv_to_uci_algbr(mv_str, main->best_move);
+    if (eng->quiet)
+        return;
+
+    /* The reply the line expects is the move to ponder on. */
+    if (main->best_pv_len >= 2 && main->best_pv[0] == main->best_move) {
+        cb_mv_to_uci_algbr(ponder_str, main->best_pv[1]);
+        eng_write_msg(eng, "bestmove %s ponder %s\n", mv_str, ponder_str);
+    } else {
+        eng_write_msg(eng, "bestmove %s\n", mv_str);
+    }
+}
+
+/**
+ * @breif Logs a ponder search that was stopped before a ponderhit. Called with sync_mtx held.
+ */
+static void report_ponder_miss(engine_t *eng)
+{
+    if (eng->quiet)
+        return;
+    eng_write_msg(eng, "info string ponder miss, stopped in %" PRIu64 " ms, hit rate %" PRIu64
+                  "/%" PRIu64 "\n", (time_ns() - eng->ponder.stop_ns) / 1000000,
+                  eng->ponder.hits, eng->ponder.searches);
+}
+
+int thinker_entry(void *thinker_addr)
+{
+    thinker_t *thinker = (thinker_t *)thinker_addr;
+    engine_t *eng = thinker->eng;
+    uint64_t search_id;
+
+    /* Read the move generation tables from this thread's NUMA node. */
+    cb_tables_bind_thread();
+
+    if (mtx_lock(&eng->sync_mtx))
+        thinker_handle_err(eng, "thinker: mtx_lock failed\n");
+    search_id = eng->search_id;
+    eng->rdy_thrds++;
+    cnd_broadcast(&eng->sync_cnd);
 
     while (true) {
-        if ((result = mtx_lock(&eng->sync_mtx)))
-            thinker_handle_err(eng, "thinker: mtx_lock: %s\n");
+        /* Sleep until the next go or until the pool is torn down. */
+        while (!atomic_load(&eng->exit_flag) && eng->search_id == search_id)
+            cnd_wait(&eng->sync_cnd, &eng->sync_mtx);
+        if (atomic_load(&eng->exit_flag))
+            break;
+        search_id = eng->search_id;
+        mtx_unlock(&eng->sync_mtx);
+
+        thinker_search(thinker);
+
+        if (mtx_lock(&eng->sync_mtx))
+            thinker_handle_err(eng, "thinker: mtx_lock failed\n");
+        if (thinker->id == 0) {
+            /* An infinite or ponder search only ends on stop, or on ponderhit for a ponder
+             * search that ran out of depth. Then the helpers are stopped and waited on so that
+             * the next go finds every thinker asleep. */
+            while ((eng->go_params.infinite || atomic_load(&eng->pondering))
+                    && !atomic_load(&eng->stop_flag))
+                cnd_wait(&eng->sync_cnd, &eng->sync_mtx);
+            atomic_store(&eng->stop_flag, true);
+            while (eng->busy_thrds > 1)
+                cnd_wait(&eng->sync_cnd, &eng->sync_mtx);
+            if (atomic_exchange(&eng->pondering, false))
+                report_ponder_miss(eng);
+            report_bestmove(eng);
+            eng->searching = false;
+        }
+        eng->busy_thrds--;
+        cnd_broadcast(&eng->sync_cnd);
     }
 
+    eng->rdy_thrds--;
+    mtx_unlock(&eng->sync_mtx);
+    return CIBYL_EOK;
+}
+
+/**
+ * @breif Stops and frees every thinker. No search may be running.
+ */
+static void join_thinkers(engine_t *eng)
+{
+    int i;
+
+    mtx_lock(&eng->sync_mtx);
+    atomic_store(&eng->exit_flag, true);
+    cnd_broadcast(&eng->sync_cnd);
+    mtx_unlock(&eng->sync_mtx);
+
+    for (i = 0; i < eng->num_thinkers; i++) {
+        thrd_join(eng->thinkers[i].thread, NULL);
+        cb_board_free(&eng->thinkers[i].board);
+        sp_deque_destroy(&eng->thinkers[i].deque);
+    }
+    free(eng->thinkers);
+    eng->thinkers = NULL;
+    eng->num_thinkers = 0;
+    atomic_store(&eng->exit_flag, false);
+}
+
+/**
+ * @breif Spawns a pool of thinkers and waits for every one of them to go to sleep.
+ */
+static cibyl_errno_t spawn_thinkers(engine_t *eng, int count)
+{
+    cb_error_t err;
+
+    if ((eng->thinkers = calloc(count, sizeof(thinker_t))) == NULL) {
+        cibyl_write_log("spawn_thinkers: calloc: %s\n", strerror(errno));
+        return CIBYL_ENOMEM;
+    }
+
+    for (eng->num_thinkers = 0; eng->num_thinkers < count; eng->num_thinkers++) {
+        thinker_t *thinker = &eng->thinkers[eng->num_thinkers];
+        thinker->eng = eng;
+        thinker->id = eng->num_thinkers;
+        thinker->ttable = &eng->ttable;
+        mp_clear_tables(thinker);
+        if (cb_board_init(&err, &thinker->board) != 0) {
+            cibyl_write_log("spawn_thinkers: %s\n", err.desc);
+            goto err_join;
+        }
+        if (sp_deque_init(&thinker->deque) != CIBYL_EOK) {
+            cb_board_free(&thinker->board);
+            goto err_join;
+        }
+        if (thrd_create(&thinker->thread, thinker_entry, thinker) != thrd_success) {
+            cibyl_write_log("spawn_thinkers: thrd_create failed\n");
+            cb_board_free(&thinker->board);
+            sp_deque_destroy(&thinker->deque);
+            goto err_join;
+        }
+    }
+
+    mtx_lock(&eng->sync_mtx);
+    while (eng->rdy_thrds < eng->num_thinkers)
+        cnd_wait(&eng->sync_cnd, &eng->sync_mtx);
+    mtx_unlock(&eng->sync_mtx);
+    return CIBYL_EOK;
+
+err_join:
+    join_thinkers(eng);
+    return CIBYL_EABORT;
+}
+
+/**
+ * @breif Copies a position and its history into a thinker's board, with room to search.
+ */
+static cibyl_errno_t clone_board(cb_board_t *dst, const cb_board_t *src)
+{
+    cb_error_t err;
+
+    dst->hist.count = 0;
+    if (cb_reserve_for_make(&err, dst, src->hist.count + THINK_MAX_PLY) != 0) {
+        cibyl_write_log("clone_board: %s\n", err.desc);
+        return CIBYL_ENOMEM;
+    }
+    dst->bb = src->bb;
+    dst->mb = src->mb;
+    dst->turn = src->turn;
+    dst->fullmove_num = src->fullmove_num;
+    memcpy(dst->hist.data, src->hist.data, src->hist.count * sizeof(cb_hist_ele_t));
+    dst->hist.count = src->hist.count;
     return CIBYL_EOK;
 }
 
@@ -78,24 +342,63 @@ int thinker_entry(void *eng_addr)
 int mgr_entry(void *eng_addr)
 {
     engine_t *eng = (engine_t *)eng_addr;
-    int i;
+    cibyl_errno_t result = CIBYL_EOK;
+    char fen[] = STARTPOS_FEN;
+    cb_error_t err;
 
-    /* Spawn all of the thinkers. */
-    for (i = 0; i < THINKER_POOL_COUNT; i++) {
-        if (thrd_create(&eng->mgr, thinker_entry, eng_addr))
-            goto err_close_thrds;
+    /* Build the move generation tables and the transposition table. */
+    if (cb_tables_init(&err) != 0) {
+        cibyl_write_log("cb_tables_init: %s\n", err.desc);
+        result = CIBYL_EABORT;
+        goto out;
     }
-
-err_close_thrds:
-    for (; i > 0; i--) {
+    if ((result = tt_init(&eng->ttable, eng->options[ENG_OPT_HASH])) != CIBYL_EOK)
+        goto out;
+    if (cb_board_init(&err, &eng->board) != 0 || cb_board_from_fen(&err, &eng->board, fen) != 0) {
+        cibyl_write_log("mgr: %s\n", err.desc);
+        result = CIBYL_EABORT;
+        goto out;
     }
 
-    return CIBYL_EOK;
+    /* Spawn all of the thinkers. */
+    result = spawn_thinkers(eng, eng->options[ENG_OPT_THREADS]);
+
+out:
+    /* Wake up anyone waiting on isready. */
+    mtx_lock(&eng->sync_mtx);
+    eng->init_result = result;
+    eng->initialized = true;
+    cnd_broadcast(&eng->sync_cnd);
+    mtx_unlock(&eng->sync_mtx);
+    return result;
 }
 
 cibyl_errno_t eng_begin_init(engine_t *eng)
 {
     cibyl_errno_t result = CIBYL_EOK;
+    int i;
+
+    /* Every option starts at its default. */
+    for (i = 0; i < ENG_OPT_COUNT; i++)
+        eng->options[i] = ENG_OPTIONS[i].def;
+    thinker_init_reductions(eng);
+    eng->initialized = false;
+    eng->searching = false;
+    eng->quiet = false;
+    eng->search_id = 0;
+    eng->rdy_thrds = 0;
+    eng->busy_thrds = 0;
+    eng->thinkers = NULL;
+    eng->num_thinkers = 0;
+    atomic_store(&eng->stop_flag, false);
+    atomic_store(&eng->exit_flag, false);
+    atomic_store(&eng->pondering, false);
+    eng->ponder = (ponder_stats_t) { 0 };
+    if (mtx_init(&eng->sync_mtx, mtx_plain) != thrd_success
+            || cnd_init(&eng->sync_cnd) != thrd_success) {
+        cibyl_write_log("eng_begin_init: failed to create the sync primitives\n");
+        return CIBYL_EABORT;
+    }
 
     /* Create the message pipe. */
 #ifdef _WIN32
@@ -135,3 +438,245 @@ out:
     return result;
 }
 
+
+cibyl_errno_t eng_await_isready(engine_t *eng)
+{
+    mtx_lock(&eng->sync_mtx);
+    while (!eng->initialized)
+        cnd_wait(&eng->sync_cnd, &eng->sync_mtx);
+    mtx_unlock(&eng->sync_mtx);
+    return eng->init_result;
+}
+
+cibyl_errno_t eng_cleanup(engine_t *eng)
+{
+    int result;
+
+    /* The manager is done once initialization is. */
+    thrd_join(eng->mgr, &result);
+    if (eng->init_result == CIBYL_EOK) {
+        eng_notify_stop(eng);
+        eng_await_search(eng);
+        join_thinkers(eng);
+        tt_free(&eng->ttable);
+        cb_board_free(&eng->board);
+        cb_tables_free();
+    }
+
+    /* Closing the write end tells the reader that no more messages will come. */
+#ifdef _WIN32
+    CloseHandle(eng->h_msg_write);
+#else
+    close(eng->msg_pipe[1]);
+#endif
+    mtx_destroy(&eng->sync_mtx);
+    cnd_destroy(&eng->sync_cnd);
+    return result == CIBYL_EOK ? CIBYL_EOK : CIBYL_EABORT;
+}
+
+void eng_newgame(engine_t *eng)
+{
+    int i;
+
+    if (eng_await_isready(eng) != CIBYL_EOK)
+        return;
+    eng_await_search(eng);
+    tt_age(&eng->ttable);
+    for (i = 0; i < eng->num_thinkers; i++)
+        mp_clear_tables(&eng->thinkers[i]);
+}
+
+cibyl_errno_t eng_respawn_thinkers(engine_t *eng)
+{
+    int count = eng->num_thinkers;
+
+    join_thinkers(eng);
+    return spawn_thinkers(eng, count);
+}
+
+cibyl_errno_t eng_set_ucifen(engine_t *eng, char *fen)
+{
+    char buf[ENG_FEN_LEN];
+    char startpos[] = STARTPOS_FEN;
+    cb_error_t err;
+
+    if (eng_await_isready(eng) != CIBYL_EOK)
+        return CIBYL_EABORT;
+    eng_await_search(eng);
+
+    /* Turn "startpos [moves ...]" and "fen <fen> [moves ...]" into a plain uci fen. */
+    if (strncmp(fen, "startpos", 8) == 0) {
+        snprintf(buf, sizeof(buf), "%s%s", STARTPOS_FEN, fen + 8);
+    } else if (strncmp(fen, "fen ", 4) == 0) {
+        snprintf(buf, sizeof(buf), "%s", fen + 4);
+    } else {
+        cibyl_write_log("eng_set_ucifen: expected startpos or fen: %s\n", fen);
+        return CIBYL_EABORT;
+    }
+
+    /* Never leave the engine on half a position. */
+    if (cb_board_from_uci(&err, &eng->board, buf) != 0) {
+        cibyl_write_log("cb_board_from_uci: %s\n", err.desc);
+        cb_board_from_fen(&err, &eng->board, startpos);
+        return CIBYL_EABORT;
+    }
+
+    return CIBYL_EOK;
+}
+
+cibyl_errno_t eng_set_option(engine_t *eng, const char *name, const char *value)
+{
+    const eng_option_t *opt;
+    int64_t val = 0;
+    char *endp;
+    int i;
+
+    if (eng_await_isready(eng) != CIBYL_EOK)
+        return CIBYL_EABORT;
+    eng_await_search(eng);
+
+    /* Find the option. */
+    for (i = 0; i < ENG_OPT_COUNT && strcasecmp(ENG_OPTIONS[i].name, name) != 0; i++);
+    if (i == ENG_OPT_COUNT) {
+        cibyl_write_log("eng_set_option: no such option: %s\n", name);
+        return CIBYL_EABORT;
+    }
+    opt = &ENG_OPTIONS[i];
+
+    /* Parse the value. */
+    if (opt->type == ENG_OPT_SPIN) {
+        if (value == NULL || (val = strtoll(value, &endp, 10), *endp != '\0')) {
+            cibyl_write_log("eng_set_option: %s expects an integer\n", opt->name);
+            return CIBYL_EABORT;
+        }
+        val = val < opt->min ? opt->min : val > opt->max ? opt->max : val;
+    } else if (opt->type == ENG_OPT_CHECK) {
+        if (value == NULL || (strcmp(value, "true") != 0 && strcmp(value, "false") != 0)) {
+            cibyl_write_log("eng_set_option: %s expects true or false\n", opt->name);
+            return CIBYL_EABORT;
+        }
+        val = strcmp(value, "true") == 0;
+    } else if (opt->type == ENG_OPT_COMBO) {
+        for (val = 0; val <= opt->max && (value == NULL || strcasecmp(opt->vars[val], value) != 0);
+             val++);
+        if (val > opt->max) {
+            cibyl_write_log("eng_set_option: %s expects one of its vars\n", opt->name);
+            return CIBYL_EABORT;
+        }
+    }
+    eng->options[i] = val;
+
+    /* Apply the options that are more than a number read at the start of a search. */
+    switch (i) {
+    case ENG_OPT_HASH:
+        if (val != (int64_t)eng->ttable.mb)
+            return tt_resize(&eng->ttable, val);
+        break;
+    case ENG_OPT_CLEAR_HASH:
+        tt_clear(&eng->ttable);
+        break;
+    case ENG_OPT_THREADS:
+        if (val != eng->num_thinkers) {
+            join_thinkers(eng);
+            return spawn_thinkers(eng, val);
+        }
+        break;
+    case ENG_OPT_LMR_BASE:
+    case ENG_OPT_LMR_DIVISOR:
+        thinker_init_reductions(eng);
+        break;
+    }
+
+    return CIBYL_EOK;
+}
+
+void eng_notify_go(engine_t *eng, const go_param_t *opts)
+{
+    int i;
+
+    if (eng_await_isready(eng) != CIBYL_EOK)
+        return;
+
+    /* A go in the middle of a search ends the old search first. */
+    eng_notify_stop(eng);
+    eng_await_search(eng);
+
+    /* Every thinker searches its own copy of the position. */
+    for (i = 0; i < eng->num_thinkers; i++) {
+        if (clone_board(&eng->thinkers[i].board, &eng->board) != CIBYL_EOK) {
+            eng_write_msg(eng, "bestmove 0000\n");
+            return;
+        }
+        atomic_store(&eng->thinkers[i].nodes, 0);
+        atomic_store(&eng->thinkers[i].qnodes, 0);
+        atomic_store(&eng->thinkers[i].cutoffs, 0);
+        atomic_store(&eng->thinkers[i].first_cutoffs, 0);
+        eng->thinkers[i].depth = 0;
+        eng->thinkers[i].best_move = CB_INVALID_MOVE;
+        eng->thinkers[i].best_score = 0;
+    }
+
+    tm_init(&eng->tm, eng->board.turn == CB_WHITE ? opts->wtime : opts->btime,
+            eng->board.turn == CB_WHITE ? opts->winc : opts->binc, opts->movestogo,
+            opts->movetime, eng->options[ENG_OPT_MOVE_OVERHEAD]);
+
+    /* Wake the pool. */
+    mtx_lock(&eng->sync_mtx);
+    eng->go_params = *opts;
+    tt_age(&eng->ttable);
+    eng->start_ns = time_ns();
+    atomic_store(&eng->clock_ns, eng->start_ns);
+    atomic_store(&eng->pondering, opts->ponder);
+    eng->ponder.searches += opts->ponder;
+    atomic_store(&eng->stop_flag, false);
+    eng->busy_thrds = eng->num_thinkers;
+    eng->searching = true;
+    eng->search_id++;
+    cnd_broadcast(&eng->sync_cnd);
+    mtx_unlock(&eng->sync_mtx);
+}
+
+void eng_await_search(engine_t *eng)
+{
+    mtx_lock(&eng->sync_mtx);
+    while (eng->searching)
+        cnd_wait(&eng->sync_cnd, &eng->sync_mtx);
+    mtx_unlock(&eng->sync_mtx);
+}
+
+void eng_notify_stop(engine_t *eng)
+{
+    mtx_lock(&eng->sync_mtx);
+    eng->ponder.stop_ns = time_ns();
+    atomic_store(&eng->stop_flag, true);
+    cnd_broadcast(&eng->sync_cnd);
+    mtx_unlock(&eng->sync_mtx);
+}
+
+void eng_notify_ponderhit(engine_t *eng)
+{
+    uint64_t now = time_ns();
+    uint64_t pondered;
+
+    mtx_lock(&eng->sync_mtx);
+    if (!eng->searching || !atomic_load(&eng->pondering)) {
+        mtx_unlock(&eng->sync_mtx);
+        return;
+    }
+
+    /* The hard limit counts from now. The soft limit still counts from the go. */
+    pondered = now - eng->start_ns;
+    atomic_store(&eng->clock_ns, now);
+    atomic_store(&eng->pondering, false);
+    eng->ponder.hits++;
+    eng->ponder.saved_ns += pondered;
+    if (eng->tm.active && pondered >= eng->tm.soft_ns)
+        atomic_store(&eng->stop_flag, true);
+    cnd_broadcast(&eng->sync_cnd);
+
+    if (!eng->quiet)
+        eng_write_msg(eng, "info string ponderhit after %" PRIu64 " ms, hit rate %" PRIu64 "/%"
+                      PRIu64 ", %" PRIu64 " ms saved in total\n", pondered / 1000000,
+                      eng->ponder.hits, eng->ponder.searches, eng->ponder.saved_ns / 1000000);
+    mtx_unlock(&eng->sync_mtx);
+}
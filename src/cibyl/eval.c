@@ -1,73 +1,310 @@
 
-#include <float.h>
-
+#include "cb_bitutil.h"
+#include "cb_board.h"
+#include "cb_move.h"
+#include "cb_tables.h"
 #include "eval.h"
 
-#define ALPHA_BETA_MAX_DEPTH 30
+/* The longest capture sequence on one square, with every piece on the board taking part. */
+#define SEE_MAX_DEPTH 32
+
+const int PIECE_VALUES[7] = { 100, 320, 330, 500, 900, 0, 0 };
+
+/* A king can only take last. Pricing it above everything else makes any other order lose. */
+static const int SEE_VALUES[7] = { 100, 320, 330, 500, 900, 20000, 0 };
+
+/* The material of each piece type in the midgame and in the endgame. */
+static const int MG_VALUES[6] = { 82, 337, 365, 477, 1025, 0 };
+static const int EG_VALUES[6] = { 94, 281, 297, 512, 936, 0 };
+
+/* What each piece type adds to the phase. The starting position sums to EVAL_MAX_PHASE. */
+static const int PHASE_WEIGHTS[7] = { 0, 1, 1, 2, 4, 0, 0 };
+
+/* The piece-square tables, laid out like the board from a8 to h1 as seen by white. Black reads
+ * them mirrored across the middle rank. */
+static const int MG_PST[6][64] = {
+    [CB_PTYPE_PAWN] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+         98, 134,  61,  95,  68, 126,  34, -11,
+         -6,   7,  26,  31,  65,  56,  25, -20,
+        -14,  13,   6,  21,  23,  12,  17, -23,
+        -27,  -2,  -5,  12,  17,   6,  10, -25,
+        -26,  -4,  -4, -10,   3,   3,  33, -12,
+        -35,  -1, -20, -23, -15,  24,  38, -22,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [CB_PTYPE_KNIGHT] = {
+        -167, -89, -34, -49,  61, -97, -15, -107,
+         -73, -41,  72,  36,  23,  62,   7,  -17,
+         -47,  60,  37,  65,  84, 129,  73,   44,
+          -9,  17,  19,  53,  37,  69,  18,   22,
+         -13,   4,  16,  13,  28,  19,  21,   -8,
+         -23,  -9,  12,  10,  19,  17,  25,  -16,
+         -29, -53, -12,  -3,  -1,  18, -14,  -19,
+        -105, -21, -58, -33, -17, -28, -19,  -23,
+    },
+    [CB_PTYPE_BISHOP] = {
+        -29,   4, -82, -37, -25, -42,   7,  -8,
+        -26,  16, -18, -13,  30,  59,  18, -47,
+        -16,  37,  43,  40,  35,  50,  37,  -2,
+         -4,   5,  19,  50,  37,  37,   7,  -2,
+         -6,  13,  13,  26,  34,  12,  10,   4,
+          0,  15,  15,  15,  14,  27,  18,  10,
+          4,  15,  16,   0,   7,  21,  33,   1,
+        -33,  -3, -14, -21, -13, -12, -39, -21,
+    },
+    [CB_PTYPE_ROOK] = {
+         32,  42,  32,  51,  63,   9,  31,  43,
+         27,  32,  58,  62,  80,  67,  26,  44,
+         -5,  19,  26,  36,  17,  45,  61,  16,
+        -24, -11,   7,  26,  24,  35,  -8, -20,
+        -36, -26, -12,  -1,   9,  -7,   6, -23,
+        -45, -25, -16, -17,   3,   0,  -5, -33,
+        -44, -16, -20,  -9,  -1,  11,  -6, -71,
+        -19, -13,   1,  17,  16,   7, -37, -26,
+    },
+    [CB_PTYPE_QUEEN] = {
+        -28,   0,  29,  12,  59,  44,  43,  45,
+        -24, -39,  -5,   1, -16,  57,  28,  54,
+        -13, -17,   7,   8,  29,  56,  47,  57,
+        -27, -27, -16, -16,  -1,  17,  -2,   1,
+         -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+        -14,   2, -11,  -2,  -5,   2,  14,   5,
+        -35,  -8,  11,   2,   8,  15,  -3,   1,
+         -1, -18,  -9,  10, -15, -25, -31, -50,
+    },
+    [CB_PTYPE_KING] = {
+        -65,  23,  16, -15, -56, -34,   2,  13,
+         29,  -1, -20,  -7,  -8,  -4, -38, -29,
+         -9,  24,   2, -16, -20,   6,  22, -22,
+        -17, -20, -12, -27, -30, -25, -14, -36,
+        -49,  -1, -27, -39, -46, -44, -33, -51,
+        -14, -14, -22, -46, -44, -30, -15, -27,
+          1,   7,  -8, -64, -43, -16,   9,   8,
+        -15,  36,  12, -54,   8, -28,  24,  14,
+    },
+};
+
+static const int EG_PST[6][64] = {
+    [CB_PTYPE_PAWN] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+        178, 173, 158, 134, 147, 132, 165, 187,
+         94, 100,  85,  67,  56,  53,  82,  84,
+         32,  24,  13,   5,  -2,   4,  17,  17,
+         13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+          4,   7,  -6,   1,   0,  -5,  -1,  -8,
+         13,   8,   8,  10,  13,   0,   2,  -7,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [CB_PTYPE_KNIGHT] = {
+        -58, -38, -13, -28, -31, -27, -63, -99,
+        -25,  -8, -25,  -2,  -9, -25, -24, -52,
+        -24, -20,  10,   9,  -1,  -9, -19, -41,
+        -17,   3,  22,  22,  22,  11,   8, -18,
+        -18,  -6,  16,  25,  16,  17,   4, -18,
+        -23,  -3,  -1,  15,  10,  -3, -20, -22,
+        -42, -20, -10,  -5,  -2, -20, -23, -44,
+        -29, -51, -23, -15, -22, -18, -50, -64,
+    },
+    [CB_PTYPE_BISHOP] = {
+        -14, -21, -11,  -8,  -7,  -9, -17, -24,
+         -8,  -4,   7, -12,  -3, -13,  -4, -14,
+          2,  -8,   0,  -1,  -2,   6,   0,   4,
+         -3,   9,  12,   9,  14,  10,   3,   2,
+         -6,   3,  13,  19,   7,  10,  -3,  -9,
+        -12,  -3,   8,  10,  13,   3,  -7, -15,
+        -14, -18,  -7,  -1,   4,  -9, -15, -27,
+        -23,  -9, -23,  -5,  -9, -16,  -5, -17,
+    },
+    [CB_PTYPE_ROOK] = {
+         13,  10,  18,  15,  12,  12,   8,   5,
+         11,  13,  13,  11,  -3,   3,   8,   3,
+          7,   7,   7,   5,   4,  -3,  -5,  -3,
+          4,   3,  13,   1,   2,   1,  -1,   2,
+          3,   5,   8,   4,  -5,  -6,  -8, -11,
+         -4,   0,  -5,  -1,  -7, -12,  -8, -16,
+         -6,  -6,   0,   2,  -9,  -9, -11,  -3,
+         -9,   2,   3,  -1,  -5, -13,   4, -20,
+    },
+    [CB_PTYPE_QUEEN] = {
+         -9,  22,  22,  27,  27,  19,  10,  20,
+        -17,  20,  32,  41,  58,  25,  30,   0,
+        -20,   6,   9,  49,  47,  35,  19,   9,
+          3,  22,  24,  45,  57,  40,  57,  36,
+        -18,  28,  19,  47,  31,  34,  39,  23,
+        -16, -27,  15,   6,   9,  17,  10,   5,
+        -22, -23, -30, -16, -16, -23, -36, -32,
+        -33, -28, -22, -43,  -5, -32, -20, -41,
+    },
+    [CB_PTYPE_KING] = {
+        -74, -35, -18, -18, -11,  15,   4, -17,
+        -12,  17,  14,  17,  17,  38,  23,  11,
+         10,  17,  23,  15,  20,  45,  44,  13,
+         -8,  22,  24,  27,  26,  33,  26,   3,
+        -18,  -4,  21,  24,  27,  23,   9, -11,
+        -19,  -3,  11,  21,  23,  16,   7,  -9,
+        -27, -11,   4,  13,  14,   4,  -5, -17,
+        -53, -34, -21, -11, -28, -14, -24, -43,
+    },
+};
+
+/**
+ * Adds a piece of color on sq to the state if sign is 1, or takes it away if sign is -1.
+ */
+static inline void toggle_piece(eval_state_t *state, cb_color_t color, cb_ptype_t ptype,
+                                uint8_t sq, int sign)
+{
+    uint8_t rel = color == CB_WHITE ? sq : sq ^ 56;
+    int side = color == CB_WHITE ? sign : -sign;
+
+    state->mg += side * (MG_VALUES[ptype] + MG_PST[ptype][rel]);
+    state->eg += side * (EG_VALUES[ptype] + EG_PST[ptype][rel]);
+    state->phase += sign * PHASE_WEIGHTS[ptype];
+}
+
+void eval_state_init(eval_state_t *state, const cb_board_t *board)
+{
+    uint64_t pieces;
+    int color, ptype;
+
+    state->mg = 0;
+    state->eg = 0;
+    state->phase = 0;
+    for (color = CB_BLACK; color <= CB_WHITE; color++) {
+        for (ptype = CB_PTYPE_PAWN; ptype <= CB_PTYPE_KING; ptype++) {
+            for (pieces = board->bb.piece[color][ptype]; pieces; pieces &= pieces - 1)
+                toggle_piece(state, color, ptype, peek_rbit(pieces), 1);
+        }
+    }
+}
+
+void eval_state_make(eval_state_t *state, const cb_board_t *board, cb_move_t mv)
+{
+    uint16_t flags = cb_mv_get_flags(mv);
+    uint8_t from = cb_mv_get_from(mv);
+    uint8_t to = cb_mv_get_to(mv);
+    cb_color_t turn = board->turn;
+    uint8_t cap_sq = flags == CB_MV_ENPASSANT ? (turn == CB_WHITE ? to + 8 : to - 8) : to;
+    cb_ptype_t ptype = cb_ptype_at_sq(board, from);
+    cb_ptype_t cap_ptype = cb_ptype_at_sq(board, cap_sq);
+    cb_ptype_t new_ptype = ptype;
 
-#define MIN(x, y) (x > y ? y : x)
-#define MAX(x, y) (x > y ? x : y)
+    if (flags & CB_MV_KNIGHT_PROMO)
+        new_ptype = CB_PTYPE_KNIGHT + ((flags >> 12) & 3);
+
+    toggle_piece(state, turn, ptype, from, -1);
+    toggle_piece(state, turn, new_ptype, to, 1);
+    if (cap_ptype != CB_PTYPE_EMPTY)
+        toggle_piece(state, !turn, cap_ptype, cap_sq, -1);
+
+    /* The rook of a castle lands on the other side of the king. */
+    if (flags == CB_MV_KING_SIDE_CASTLE) {
+        toggle_piece(state, turn, CB_PTYPE_ROOK, to + 1, -1);
+        toggle_piece(state, turn, CB_PTYPE_ROOK, to - 1, 1);
+    } else if (flags == CB_MV_QUEEN_SIDE_CASTLE) {
+        toggle_piece(state, turn, CB_PTYPE_ROOK, to - 2, -1);
+        toggle_piece(state, turn, CB_PTYPE_ROOK, to + 1, 1);
+    }
+}
 
-float piece_differential(const cb_board_t *board)
+int eval(const cb_board_t *board)
 {
-    if (board->bb.piece[board->turn][CB_PTYPE_KING] == 0)
-        return board->turn ? FLT_MIN : FLT_MAX;
+    eval_state_t state;
 
+    eval_state_init(&state, board);
+    return eval_state_score(&state, board->turn);
 }
 
-float eval(const cb_board_t *board)
+/**
+ * Returns the pieces of either color that attack sq through the occupancy occ.
+ */
+static inline uint64_t attackers_to(const cb_board_t *board, uint8_t sq, uint64_t occ)
 {
-    return piece_differential(board);
+    const uint64_t (*piece)[6] = board->bb.piece;
+
+    return (cb_read_pawn_atk_msk(sq, CB_BLACK) & piece[CB_WHITE][CB_PTYPE_PAWN])
+        | (cb_read_pawn_atk_msk(sq, CB_WHITE) & piece[CB_BLACK][CB_PTYPE_PAWN])
+        | (cb_read_knight_atk_msk(sq)
+                & (piece[CB_WHITE][CB_PTYPE_KNIGHT] | piece[CB_BLACK][CB_PTYPE_KNIGHT]))
+        | (cb_read_king_atk_msk(sq)
+                & (piece[CB_WHITE][CB_PTYPE_KING] | piece[CB_BLACK][CB_PTYPE_KING]))
+        | (cb_read_bishop_atk_msk(sq, occ)
+                & (piece[CB_WHITE][CB_PTYPE_BISHOP] | piece[CB_BLACK][CB_PTYPE_BISHOP]
+                    | piece[CB_WHITE][CB_PTYPE_QUEEN] | piece[CB_BLACK][CB_PTYPE_QUEEN]))
+        | (cb_read_rook_atk_msk(sq, occ)
+                & (piece[CB_WHITE][CB_PTYPE_ROOK] | piece[CB_BLACK][CB_PTYPE_ROOK]
+                    | piece[CB_WHITE][CB_PTYPE_QUEEN] | piece[CB_BLACK][CB_PTYPE_QUEEN]));
 }
 
-/* This is just a minimax search for now. I'll flesh it out into alphabeta later. */
-float searching(cb_board_t *board, cb_state_tables_t *state, int depth)
+/**
+ * Finds the least valuable piece of color in attackers. Returns CB_PTYPE_EMPTY if there is none.
+ */
+static inline cb_ptype_t least_valuable(const cb_board_t *board, uint64_t attackers,
+                                        cb_color_t color, uint8_t *sq)
 {
-    cb_mvlst_t mvlst;
-    cb_move_t mv;
-    float value = FLT_MAX;
-    float result;
-    int i;
-
-    /* Perform static evaluation if we are ready to evaluate as is. */
-    if (depth < 1)
-        return eval(board);
-
-    /* Make moves down the tree. */
-    for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
-        mv = cb_mvlst_at(&mvlst, i);
-        cb_make(board, mv);
-        result = searching(board, state, depth - 1);
-        value = board->turn ? MAX(result, value) : MIN(result, value);
-        cb_unmake(board);
+    int ptype;
+
+    for (ptype = CB_PTYPE_PAWN; ptype <= CB_PTYPE_KING; ptype++) {
+        if (attackers & board->bb.piece[color][ptype]) {
+            *sq = peek_rbit(attackers & board->bb.piece[color][ptype]);
+            return ptype;
+        }
     }
 
-    return value;
+    return CB_PTYPE_EMPTY;
 }
 
-cb_move_t alphabeta(cb_board_t *board, int base_depth)
+int see(const cb_board_t *board, cb_move_t mv)
 {
-    cb_errno_t result;
-    cb_error_t err;
-    cb_mvlst_t mvlst;
-    cb_move_t mv;
-    uint64_t perft_results[CB_MAX_NUM_MOVES];
-    cb_state_tables_t state;
-    uint64_t cnt = 0;
-    uint64_t total = 0;
-    char buf[6];
-    int i;
-
-    /* Exit early if depth is less than 1. */
-    if (base_depth < 1) {
-        printf("Can't alphabeta with a depth below 1\n");
-        return CB_INVALID_MOVE;
+    const uint64_t (*piece)[6] = board->bb.piece;
+    uint8_t from = cb_mv_get_from(mv);
+    uint8_t to = cb_mv_get_to(mv);
+    uint16_t flags = cb_mv_get_flags(mv);
+    uint64_t occ = board->bb.occ;
+    uint64_t diagonal = piece[CB_WHITE][CB_PTYPE_BISHOP] | piece[CB_BLACK][CB_PTYPE_BISHOP]
+        | piece[CB_WHITE][CB_PTYPE_QUEEN] | piece[CB_BLACK][CB_PTYPE_QUEEN];
+    uint64_t straight = piece[CB_WHITE][CB_PTYPE_ROOK] | piece[CB_BLACK][CB_PTYPE_ROOK]
+        | piece[CB_WHITE][CB_PTYPE_QUEEN] | piece[CB_BLACK][CB_PTYPE_QUEEN];
+    uint64_t attackers;
+    int gain[SEE_MAX_DEPTH];
+    cb_ptype_t attacker = cb_ptype_at_sq(board, from);
+    cb_color_t color = board->turn;
+    int d = 0;
+
+    /* The first capture. An enpassant pawn is not on the target square. */
+    if (flags == CB_MV_ENPASSANT) {
+        gain[0] = SEE_VALUES[CB_PTYPE_PAWN];
+        occ ^= UINT64_C(1) << (board->turn == CB_WHITE ? to + 8 : to - 8);
+    } else {
+        gain[0] = SEE_VALUES[cb_ptype_at_sq(board, to)];
     }
+    if (flags & CB_MV_KNIGHT_PROMO) {
+        attacker = CB_PTYPE_KNIGHT + ((flags >> 12) & 3);
+        gain[0] += SEE_VALUES[attacker] - SEE_VALUES[CB_PTYPE_PAWN];
+    }
+    occ ^= UINT64_C(1) << from;
+    attackers = attackers_to(board, to, occ) & occ;
+
+    /* Each side takes back with its least valuable piece. Gain d is the material won up to
+     * capture d if the piece that made it is then taken. */
+    while (d + 1 < SEE_MAX_DEPTH) {
+        d++;
+        color = !color;
+        gain[d] = SEE_VALUES[attacker] - gain[d - 1];
+        if ((-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]) < 0)
+            break;
+        if ((attacker = least_valuable(board, attackers, color, &from)) == CB_PTYPE_EMPTY)
+            break;
 
-    /* Reserve the board history. This line guarantees that make will never write
-     * past its proper bounds. */
-    if ((result = cb_reserve_for_make(&err, board, ALPHA_BETA_MAX_DEPTH)) != 0) {
-        fprintf(stderr, "cb_reserve_for_make: %s\n", err.desc);
-        return CB_INVALID_MOVE;
+        /* Sliders behind the piece that takes join in. */
+        occ ^= UINT64_C(1) << from;
+        attackers |= (cb_read_bishop_atk_msk(to, occ) & diagonal)
+            | (cb_read_rook_atk_msk(to, occ) & straight);
+        attackers &= occ;
     }
+
+    /* Either side may stop taking when it would lose by going on. */
+    while (--d)
+        gain[d - 1] = -(-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]);
+    return gain[0];
 }
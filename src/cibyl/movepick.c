@@ -0,0 +1,290 @@
+
+#include <string.h>
+
+#include "cb_lib.h"
+#include "cb_board.h"
+#include "eval.h"
+#include "movepick.h"
+
+/* The largest history bonus, reached at a depth of 16. */
+#define HISTORY_BONUS_MAX 256
+
+int mp_capture_value(const cb_board_t *board, cb_move_t mv)
+{
+    uint16_t flags = cb_mv_get_flags(mv);
+    int value = flags == CB_MV_ENPASSANT ? PIECE_VALUES[CB_PTYPE_PAWN]
+        : PIECE_VALUES[cb_ptype_at_sq(board, cb_mv_get_to(mv))];
+
+    if (flags & CB_MV_KNIGHT_PROMO)
+        value += PIECE_VALUES[CB_PTYPE_KNIGHT + ((flags >> 12) & 3)] - PIECE_VALUES[CB_PTYPE_PAWN];
+    return value;
+}
+
+/**
+ * Returns the MVV-LVA key of a capture. Larger is tried first.
+ */
+static inline int mvv_lva(const cb_board_t *board, cb_move_t mv)
+{
+    return mp_capture_value(board, mv) * 8 - cb_ptype_at_sq(board, cb_mv_get_from(mv));
+}
+
+void mp_sort_captures(const cb_board_t *board, cb_mvlst_t *mvlst)
+{
+    int keys[CB_MAX_NUM_MOVES];
+    cb_move_t mv;
+    int key, i, j;
+
+    for (i = 0; i < cb_mvlst_size(mvlst); i++) {
+        mv = mvlst->moves[i];
+        key = mvv_lva(board, mv);
+        for (j = i; j > 0 && keys[j - 1] < key; j--) {
+            keys[j] = keys[j - 1];
+            mvlst->moves[j] = mvlst->moves[j - 1];
+        }
+        keys[j] = key;
+        mvlst->moves[j] = mv;
+    }
+}
+
+void mp_init(move_picker_t *mp, const thinker_t *thinker, cb_state_tables_t *state,
+             const cb_pseudo_tables_t *pstate, cb_move_t hash_move, int ply)
+{
+    const cb_board_t *board = &thinker->board;
+    cb_move_t prev = board->hist.data[board->hist.count - 1].move;
+    cb_move_t mv;
+    int i;
+
+    mp->board = board;
+    mp->thinker = thinker;
+    mp->pseudo = state == NULL;
+    if (mp->pseudo) {
+        mp->pstate = *pstate;
+        cb_gen_pseudo_moves(&mp->moves, (cb_board_t *)board, &mp->pstate);
+    } else {
+        cb_gen_moves(&mp->moves, (cb_board_t *)board, state);
+    }
+
+    /* Captures and promotions to the front. */
+    mp->num_captures = 0;
+    for (i = 0; i < cb_mvlst_size(&mp->moves); i++) {
+        mv = mp->moves.moves[i];
+        if (!mp_is_quiet(mv)) {
+            mp->moves.moves[i] = mp->moves.moves[mp->num_captures];
+            mp->moves.moves[mp->num_captures++] = mv;
+        }
+    }
+
+    mp->cur = 0;
+    mp->num_bad = 0;
+    mp->cur_bad = 0;
+    mp->hash_move = hash_move;
+    mp->refutations[0] = thinker->killers[ply][0];
+    mp->refutations[1] = thinker->killers[ply][1];
+    mp->refutations[2] = thinker->counters[cb_mv_get_from(prev)][cb_mv_get_to(prev)];
+    mp->cur_ref = 0;
+    mp->stage = MP_HASH;
+}
+
+/**
+ * Returns true if mv is one of the quiet moves of the picker.
+ */
+static bool is_quiet_move(const move_picker_t *mp, cb_move_t mv)
+{
+    int i;
+
+    for (i = mp->num_captures; i < cb_mvlst_size((cb_mvlst_t *)&mp->moves); i++) {
+        if (mp->moves.moves[i] == mv)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Returns true if mv was already handed out ahead of its stage.
+ */
+static inline bool handed_out(const move_picker_t *mp, cb_move_t mv)
+{
+    return mv == mp->hash_move || (mp_is_quiet(mv) && (mv == mp->refutations[0]
+                || mv == mp->refutations[1] || mv == mp->refutations[2]));
+}
+
+/**
+ * Swaps the move with the best score from cur up to end into cur and returns it.
+ */
+static inline cb_move_t pick_best(move_picker_t *mp, int end)
+{
+    cb_move_t mv;
+    int best = mp->cur;
+    int score, i;
+
+    for (i = mp->cur + 1; i < end; i++) {
+        if (mp->scores[i] > mp->scores[best])
+            best = i;
+    }
+
+    mv = mp->moves.moves[best];
+    score = mp->scores[best];
+    mp->moves.moves[best] = mp->moves.moves[mp->cur];
+    mp->scores[best] = mp->scores[mp->cur];
+    mp->moves.moves[mp->cur] = mv;
+    mp->scores[mp->cur] = score;
+    return mp->moves.moves[mp->cur++];
+}
+
+/**
+ * Returns the next move of the stages, legal or not.
+ */
+static cb_move_t next_move(move_picker_t *mp)
+{
+    const cb_board_t *board = mp->board;
+    cb_move_t mv;
+    int i;
+
+    switch (mp->stage) {
+    case MP_HASH:
+        mp->stage = MP_INIT_CAPTURES;
+        if (mp->hash_move != CB_INVALID_MOVE) {
+            for (i = 0; i < cb_mvlst_size(&mp->moves); i++) {
+                if (mp->moves.moves[i] == mp->hash_move)
+                    return mp->hash_move;
+            }
+            mp->hash_move = CB_INVALID_MOVE;
+        }
+        /* fallthrough */
+    case MP_INIT_CAPTURES:
+        for (i = 0; i < mp->num_captures; i++)
+            mp->scores[i] = mvv_lva(board, mp->moves.moves[i]);
+        mp->stage = MP_GOOD_CAPTURES;
+        /* fallthrough */
+    case MP_GOOD_CAPTURES:
+        while (mp->cur < mp->num_captures) {
+            mv = pick_best(mp, mp->num_captures);
+            if (mv == mp->hash_move)
+                continue;
+            if (see(board, mv) < 0) {
+                mp->bad[mp->num_bad++] = mv;
+                continue;
+            }
+            return mv;
+        }
+        mp->stage = MP_REFUTATIONS;
+        /* fallthrough */
+    case MP_REFUTATIONS:
+        while (mp->cur_ref < 3) {
+            mv = mp->refutations[mp->cur_ref++];
+
+            /* The countermove may be one of the killers. */
+            if (mv == CB_INVALID_MOVE || mv == mp->hash_move || !mp_is_quiet(mv)
+                    || (mp->cur_ref == 2 && mv == mp->refutations[0])
+                    || (mp->cur_ref == 3 && (mv == mp->refutations[0]
+                            || mv == mp->refutations[1]))
+                    || !is_quiet_move(mp, mv))
+                continue;
+            return mv;
+        }
+        mp->stage = MP_INIT_QUIETS;
+        /* fallthrough */
+    case MP_INIT_QUIETS:
+        for (i = mp->num_captures; i < cb_mvlst_size(&mp->moves); i++) {
+            mv = mp->moves.moves[i];
+            mp->scores[i] = mp->thinker->history[board->turn][cb_mv_get_from(mv)]
+                [cb_mv_get_to(mv)];
+        }
+        mp->stage = MP_QUIETS;
+        /* fallthrough */
+    case MP_QUIETS:
+        while (mp->cur < cb_mvlst_size(&mp->moves)) {
+            mv = pick_best(mp, cb_mvlst_size(&mp->moves));
+            if (!handed_out(mp, mv))
+                return mv;
+        }
+        mp->stage = MP_BAD_CAPTURES;
+        /* fallthrough */
+    case MP_BAD_CAPTURES:
+        if (mp->cur_bad < mp->num_bad)
+            return mp->bad[mp->cur_bad++];
+        mp->stage = MP_DONE;
+        /* fallthrough */
+    case MP_DONE:
+        break;
+    }
+
+    return CB_INVALID_MOVE;
+}
+
+cb_move_t mp_next(move_picker_t *mp)
+{
+    cb_move_t mv;
+
+    do {
+        mv = next_move(mp);
+    } while (mp->pseudo && mv != CB_INVALID_MOVE
+            && !cb_is_legal((cb_board_t *)mp->board, &mp->pstate, mv));
+    return mv;
+}
+
+void mp_drain(move_picker_t *mp, cb_mvlst_t *out, bool *late)
+{
+    cb_move_t mv;
+
+    cb_mvlst_clear(out);
+    while ((mv = mp_next(mp)) != CB_INVALID_MOVE) {
+        late[cb_mvlst_size(out)] = mp->stage == MP_QUIETS;
+        cb_mvlst_push(out, mv);
+    }
+}
+
+/**
+ * Moves a history score towards the bound of the sign of bonus. The closer it already is, the
+ * less it moves, so scores never leave plus or minus HISTORY_MAX.
+ */
+static inline void update_history(int *entry, int bonus)
+{
+    *entry += bonus - *entry * (bonus < 0 ? -bonus : bonus) / HISTORY_MAX;
+}
+
+void mp_reward_quiet(thinker_t *thinker, cb_move_t mv, int depth, int ply,
+                     const cb_move_t *tried, int num_tried)
+{
+    const cb_board_t *board = &thinker->board;
+    cb_move_t prev = board->hist.data[board->hist.count - 1].move;
+    int (*history)[64] = thinker->history[board->turn];
+    int bonus = depth * depth < HISTORY_BONUS_MAX ? depth * depth : HISTORY_BONUS_MAX;
+    int i;
+
+    if (thinker->killers[ply][0] != mv) {
+        thinker->killers[ply][1] = thinker->killers[ply][0];
+        thinker->killers[ply][0] = mv;
+    }
+    thinker->counters[cb_mv_get_from(prev)][cb_mv_get_to(prev)] = mv;
+
+    update_history(&history[cb_mv_get_from(mv)][cb_mv_get_to(mv)], bonus);
+    for (i = 0; i < num_tried; i++)
+        update_history(&history[cb_mv_get_from(tried[i])][cb_mv_get_to(tried[i])], -bonus);
+}
+
+void mp_age_tables(thinker_t *thinker)
+{
+    int color, from, to, ply;
+
+    for (ply = 0; ply < THINK_MAX_PLY; ply++)
+        thinker->killers[ply][0] = thinker->killers[ply][1] = CB_INVALID_MOVE;
+    for (color = 0; color < 2; color++) {
+        for (from = 0; from < 64; from++) {
+            for (to = 0; to < 64; to++)
+                thinker->history[color][from][to] /= 2;
+        }
+    }
+}
+
+void mp_clear_tables(thinker_t *thinker)
+{
+    int from, to;
+
+    mp_age_tables(thinker);
+    memset(thinker->history, 0, sizeof(thinker->history));
+    for (from = 0; from < 64; from++) {
+        for (to = 0; to < 64; to++)
+            thinker->counters[from][to] = CB_INVALID_MOVE;
+    }
+}
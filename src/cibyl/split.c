@@ -0,0 +1,155 @@
+
+#include <string.h>
+
+#include "split.h"
+
+cibyl_errno_t sp_deque_init(sp_deque_t *dq)
+{
+    dq->count = 0;
+    if (mtx_init(&dq->lock, mtx_plain) != thrd_success) {
+        cibyl_write_log("sp_deque_init: mtx_init failed\n");
+        return CIBYL_EABORT;
+    }
+    return CIBYL_EOK;
+}
+
+void sp_deque_destroy(sp_deque_t *dq)
+{
+    mtx_destroy(&dq->lock);
+}
+
+bool sp_deque_has_room(sp_deque_t *dq)
+{
+    /* Only the owner changes the count, so it can read it without the lock. */
+    return dq->count < SPLIT_DEQUE_LEN;
+}
+
+cibyl_errno_t sp_open(split_point_t *sp, thinker_t *owner, const cb_mvlst_t *mvlst,
+                      const bool *late, int first, int alpha, int beta, int best,
+                      cb_move_t best_move, int depth, int ply, bool pv_node, bool futile,
+                      bool lmr)
+{
+    const cb_board_t *board = &owner->board;
+    int i;
+
+    if (mtx_init(&sp->lock, mtx_plain) != thrd_success) {
+        cibyl_write_log("sp_open: mtx_init failed\n");
+        return CIBYL_EABORT;
+    }
+    sp->parent = owner->sp;
+    sp->path_len = 0;
+    for (i = owner->root_count; i < board->hist.count; i++)
+        sp->path[sp->path_len++] = board->hist.data[i].move;
+    sp->moves = *mvlst;
+    memcpy(sp->late, late, cb_mvlst_size((cb_mvlst_t *)mvlst) * sizeof(bool));
+    sp->pv_node = pv_node;
+    sp->futile = futile;
+    sp->lmr = lmr;
+    sp->next = first;
+    sp->alpha = alpha;
+    sp->beta = beta;
+    sp->best = best;
+    sp->best_move = best_move;
+    sp->depth = depth;
+    sp->ply = ply;
+    sp->helpers = 0;
+    atomic_store(&sp->cutoff, false);
+
+    mtx_lock(&owner->deque.lock);
+    owner->deque.sps[owner->deque.count++] = sp;
+    mtx_unlock(&owner->deque.lock);
+    return CIBYL_EOK;
+}
+
+void sp_close(split_point_t *sp, thinker_t *owner)
+{
+    int helpers;
+
+    /* No thief can join once the split point is off the deque. */
+    mtx_lock(&owner->deque.lock);
+    owner->deque.count--;
+    mtx_unlock(&owner->deque.lock);
+
+    /* The helpers are searching subtrees of this node, so the owner has nothing else to do.
+     * Cutoffs abort them quickly. */
+    do {
+        mtx_lock(&sp->lock);
+        helpers = sp->helpers;
+        mtx_unlock(&sp->lock);
+        if (helpers > 0)
+            thrd_yield();
+    } while (helpers > 0);
+
+    mtx_destroy(&sp->lock);
+}
+
+split_point_t *sp_steal(engine_t *eng, thinker_t *thief)
+{
+    sp_deque_t *dq;
+    split_point_t *sp;
+    int i, j;
+
+    /* Start with the next thinker so thieves spread out over the owners. */
+    for (i = 1; i < eng->num_thinkers; i++) {
+        dq = &eng->thinkers[(thief->id + i) % eng->num_thinkers].deque;
+        mtx_lock(&dq->lock);
+        for (j = 0; j < dq->count; j++) {
+            sp = dq->sps[j];
+            mtx_lock(&sp->lock);
+            if (sp->next < cb_mvlst_size(&sp->moves) && !atomic_load(&sp->cutoff)) {
+                sp->helpers++;
+                mtx_unlock(&sp->lock);
+                mtx_unlock(&dq->lock);
+                return sp;
+            }
+            mtx_unlock(&sp->lock);
+        }
+        mtx_unlock(&dq->lock);
+    }
+
+    return NULL;
+}
+
+void sp_leave(split_point_t *sp)
+{
+    mtx_lock(&sp->lock);
+    sp->helpers--;
+    mtx_unlock(&sp->lock);
+}
+
+bool sp_next_move(split_point_t *sp, cb_move_t *mv, int *idx, int *alpha, int *best)
+{
+    bool found = false;
+
+    mtx_lock(&sp->lock);
+    if (sp->next < cb_mvlst_size(&sp->moves) && !atomic_load(&sp->cutoff)) {
+        *idx = sp->next;
+        *mv = sp->moves.moves[sp->next++];
+        *alpha = sp->alpha;
+        *best = sp->best;
+        found = true;
+    }
+    mtx_unlock(&sp->lock);
+    return found;
+}
+
+bool sp_update(split_point_t *sp, cb_move_t mv, int score, bool *cut)
+{
+    bool raised = false;
+
+    mtx_lock(&sp->lock);
+    if (score > sp->best) {
+        sp->best = score;
+        sp->best_move = mv;
+        if (score > sp->alpha) {
+            sp->alpha = score;
+            raised = true;
+        }
+        if (sp->alpha >= sp->beta && !atomic_load(&sp->cutoff)) {
+            atomic_store(&sp->cutoff, true);
+            *cut = true;
+        }
+    }
+    mtx_unlock(&sp->lock);
+    return raised;
+}
@@ -0,0 +1,1031 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "cb_lib.h"
+#include "cb_board.h"
+#include "cb_const.h"
+#include "cb_move.h"
+#include "cb_zobrist.h"
+#include "cb_visit.h"
+#include "crosstime.h"
+#include "eval.h"
+#include "split.h"
+#include "movepick.h"
+#include "thinker.h"
+
+/* The thinkers between them check the limits about every this many nodes. Each one checks at
+ * most every LIMIT_CHECK_MIN nodes of its own. Both must be powers of two. */
+#define LIMIT_CHECK_NODES 1024
+#define LIMIT_CHECK_MIN 64
+
+/* A capture that cannot lift the stand pat this close to alpha is not searched in quiescence. */
+#define DELTA_MARGIN 200
+
+/* Null moves are only tried this deep. Late moves are only reduced this deep. */
+#define NULL_MOVE_MIN_DEPTH 3
+#define LMR_MIN_DEPTH 3
+
+/* Iterations from this depth on start with a window around the last score. */
+#define ASPIRATION_MIN_DEPTH 5
+#define ASPIRATION_WINDOW 25
+
+/**
+ * Returns true once the engine wants the thinkers to stop, or once a split point this thinker
+ * is working under has cut off.
+ */
+static inline bool should_stop(thinker_t *thinker)
+{
+    return atomic_load_explicit(&thinker->eng->stop_flag, memory_order_relaxed)
+        || (thinker->sp != NULL && sp_aborted(thinker->sp));
+}
+
+/**
+ * Returns the number of nodes searched by every thinker of the engine.
+ */
+static uint64_t total_nodes(engine_t *eng)
+{
+    uint64_t nodes = 0;
+    int i;
+
+    for (i = 0; i < eng->num_thinkers; i++)
+        nodes += atomic_load_explicit(&eng->thinkers[i].nodes, memory_order_relaxed);
+    return nodes;
+}
+
+/**
+ * Stops the search once the node limit of the go command or the hard time limit is reached.
+ * The clock only runs once a ponder search is hit.
+ */
+static void check_limits(thinker_t *thinker)
+{
+    engine_t *eng = thinker->eng;
+    const go_param_t *params = &eng->go_params;
+
+    if ((params->nodes > 0 && total_nodes(eng) >= (uint64_t)params->nodes)
+            || (!atomic_load_explicit(&eng->pondering, memory_order_relaxed)
+                && tm_hard_expired(&eng->tm, atomic_load(&eng->clock_ns), time_ns())))
+        atomic_store(&eng->stop_flag, true);
+}
+
+/**
+ * Counts a node. Only the owning thread writes the counter, so no read-modify-write is needed.
+ * Every thinker checks the limits of the search, each one its share of LIMIT_CHECK_NODES. The
+ * main thinker alone would leave them unchecked while it waits at a split point for its helpers.
+ */
+static inline void count_node(thinker_t *thinker)
+{
+    uint64_t nodes = atomic_load_explicit(&thinker->nodes, memory_order_relaxed) + 1;
+
+    atomic_store_explicit(&thinker->nodes, nodes, memory_order_relaxed);
+    if ((nodes & thinker->limit_mask) == 0)
+        check_limits(thinker);
+}
+
+/**
+ * Counts a node of quiescence search. It is counted in nodes as well.
+ */
+static inline void count_qnode(thinker_t *thinker)
+{
+    atomic_store_explicit(&thinker->qnodes,
+            atomic_load_explicit(&thinker->qnodes, memory_order_relaxed) + 1,
+            memory_order_relaxed);
+    count_node(thinker);
+}
+
+/**
+ * Counts a beta cutoff of the main search, and whether the first move tried made it.
+ */
+static inline void count_cutoff(thinker_t *thinker, bool first)
+{
+    atomic_store_explicit(&thinker->cutoffs,
+            atomic_load_explicit(&thinker->cutoffs, memory_order_relaxed) + 1,
+            memory_order_relaxed);
+    if (first)
+        atomic_store_explicit(&thinker->first_cutoffs,
+                atomic_load_explicit(&thinker->first_cutoffs, memory_order_relaxed) + 1,
+                memory_order_relaxed);
+}
+
+/**
+ * Returns true if the position is drawn by the fifty move rule or by a repetition since the
+ * last capture or pawn move.
+ */
+static bool is_draw(const cb_board_t *board)
+{
+    int clock = cb_hist_halfmove_clk(board->hist.data[board->hist.count - 1].hist);
+    uint64_t key = cb_board_key(board);
+    int i;
+
+    if (clock >= 100)
+        return true;
+    for (i = board->hist.count - 3; i >= 0 && i >= board->hist.count - 1 - clock; i -= 2) {
+        if (board->hist.data[i].key == key)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Mate scores are stored relative to the node rather than the root, so a mate found through a
+ * transposition at a different ply keeps its distance.
+ */
+static inline int score_to_tt(int score, int ply)
+{
+    return score > SCORE_MATE_BOUND ? score + ply : score < -SCORE_MATE_BOUND ? score - ply : score;
+}
+
+static inline int score_from_tt(int score, int ply)
+{
+    return score > SCORE_MATE_BOUND ? score - ply : score < -SCORE_MATE_BOUND ? score + ply : score;
+}
+
+/**
+ * Makes mv followed by the principal variation of the next ply the principal variation of ply.
+ */
+static inline void update_pv(thinker_t *thinker, int ply, cb_move_t mv)
+{
+    thinker->pv[ply][0] = mv;
+    memcpy(&thinker->pv[ply][1], thinker->pv[ply + 1], thinker->pv_len[ply + 1] * sizeof(cb_move_t));
+    thinker->pv_len[ply] = thinker->pv_len[ply + 1] + 1;
+}
+
+/**
+ * Moves mv to the front of the list if it is in it.
+ */
+static void move_to_front(cb_mvlst_t *mvlst, cb_move_t mv)
+{
+    int i;
+
+    for (i = 0; i < cb_mvlst_size(mvlst); i++) {
+        if (mvlst->moves[i] == mv) {
+            mvlst->moves[i] = mvlst->moves[0];
+            mvlst->moves[0] = mv;
+            return;
+        }
+    }
+}
+
+static int pvs(thinker_t *thinker, int alpha, int beta, int depth, int ply);
+
+/**
+ * Returns true if the side to move has a piece other than pawns and its king. Without one,
+ * passing may be the only thing that does not lose and null move pruning is unsound.
+ */
+static inline bool has_pieces(const cb_board_t *board)
+{
+    const uint64_t *piece = board->bb.piece[board->turn];
+
+    return (board->bb.color[board->turn] & ~(piece[CB_PTYPE_PAWN] | piece[CB_PTYPE_KING])) != 0;
+}
+
+/**
+ * Returns the ply of the thinker's board from the root. Null moves count.
+ */
+static inline int board_ply(const thinker_t *thinker)
+{
+    return thinker->board.hist.count - thinker->root_count;
+}
+
+/**
+ * Makes a move on the thinker's board and carries the eval terms of its ply over to the next.
+ * cb_unmake takes it back, as the terms of the ply below are still in place.
+ */
+static inline void make_move(thinker_t *thinker, cb_move_t mv)
+{
+    eval_state_t *state = &thinker->evals[board_ply(thinker)];
+
+    state[1] = state[0];
+    eval_state_make(&state[1], &thinker->board, mv);
+    cb_make(&thinker->board, mv);
+}
+
+/**
+ * Passes on the thinker's board. Nothing on the board moves, so neither do the eval terms.
+ */
+static inline void make_null(thinker_t *thinker)
+{
+    eval_state_t *state = &thinker->evals[board_ply(thinker)];
+
+    state[1] = state[0];
+    cb_make_null(&thinker->board);
+}
+
+/**
+ * Returns the static eval of the thinker's board from the side to move.
+ */
+static inline int evaluate(const thinker_t *thinker)
+{
+    return eval_state_score(&thinker->evals[board_ply(thinker)], thinker->board.turn);
+}
+
+/**
+ * Lets the opponent move twice in a row with a reduced search. If they still cannot get below
+ * beta the node fails high. From the verify depth on the cutoff is only trusted once a reduced
+ * search of the node itself agrees, with null moves kept out of the plies near it, so that
+ * zugzwang positions are not pruned.
+ */
+static int null_move(thinker_t *thinker, int beta, int depth, int ply)
+{
+    cb_board_t *board = &thinker->board;
+    const int64_t *opts = thinker->eng->options;
+    int reduction = opts[ENG_OPT_NULL_MOVE_R] + depth / 4;
+    int old_min_ply = thinker->null_min_ply;
+    int score, verified;
+
+    make_null(thinker);
+    score = -pvs(thinker, -beta, -beta + 1, depth - 1 - reduction, ply + 1);
+    cb_unmake_null(board);
+    if (score < beta || should_stop(thinker))
+        return score;
+
+    /* A mate found by passing is no proof of one. */
+    score = score > SCORE_MATE_BOUND ? beta : score;
+    if (depth < opts[ENG_OPT_NULL_VERIFY])
+        return score;
+
+    thinker->null_min_ply = ply + 3 * (depth - reduction) / 4;
+    verified = pvs(thinker, beta - 1, beta, depth - reduction, ply);
+    thinker->null_min_ply = old_min_ply;
+    return verified >= beta ? score : -SCORE_INF;
+}
+
+/**
+ * Returns true for a capture that can reach alpha even unanswered and does not lose material.
+ * Knight promotions gain their material without a capture and always pass the first test.
+ */
+static inline bool qsearch_keeps(const cb_board_t *board, cb_move_t mv, int stand_pat, int alpha)
+{
+    return ((cb_mv_get_flags(mv) & CB_MV_KNIGHT_PROMO)
+            || stand_pat + mp_capture_value(board, mv) + DELTA_MARGIN > alpha)
+        && see(board, mv) >= 0;
+}
+
+/**
+ * @breif The list that qsearch_visitor fills and the bounds it prunes against.
+ */
+typedef struct {
+    const cb_board_t *board;    /**< The board the moves are generated on. */
+    cb_mvlst_t *mvlst;          /**< The captures that survive the pruning. */
+    int stand_pat;              /**< The static eval of the board. */
+    int alpha;                  /**< Alpha once raised to the stand pat. */
+} qsearch_gen_t;
+
+static bool qsearch_visitor(void *ctx, cb_move_t mv)
+{
+    qsearch_gen_t *gen = ctx;
+
+    if (qsearch_keeps(gen->board, mv, gen->stand_pat, gen->alpha))
+        cb_mvlst_push(gen->mvlst, mv);
+    return false;
+}
+
+/**
+ * Generates the moves of the thinker's board for quiescence. Evasions in check, otherwise the
+ * captures and promotions that qsearch_keeps. The legal captures are pruned as the generator
+ * visits them, so the rest never reach the list or the sort. Pseudo-legal generation has no
+ * noisy-only variant, so the full list is filtered down instead.
+ */
+static void gen_qsearch_moves(thinker_t *thinker, cb_mvlst_t *mvlst, cb_state_tables_t *state,
+                              cb_pseudo_tables_t *pstate, bool pseudo, int stand_pat, int alpha)
+{
+    cb_board_t *board = &thinker->board;
+    qsearch_gen_t gen = { board, mvlst, stand_pat, alpha };
+    uint64_t checks = pseudo ? pstate->checks : state->checks;
+    int i, n = 0;
+
+    if (!pseudo && checks) {
+        cb_gen_moves(mvlst, board, state);
+        return;
+    } else if (!pseudo) {
+        cb_mvlst_clear(mvlst);
+        cb_visit_noisy_and_checks(board, state, NULL, qsearch_visitor, &gen);
+        return;
+    }
+
+    cb_gen_pseudo_moves(mvlst, board, pstate);
+    if (checks)
+        return;
+    for (i = 0; i < cb_mvlst_size(mvlst); i++) {
+        if (!mp_is_quiet(mvlst->moves[i])
+                && qsearch_keeps(board, mvlst->moves[i], stand_pat, alpha))
+            mvlst->moves[n++] = mvlst->moves[i];
+    }
+    mvlst->head = n;
+}
+
+/**
+ * Searches captures and promotions until the position is quiet, so that no leaf is scored in
+ * the middle of an exchange. In check every evasion is searched instead.
+ */
+static int qsearch(thinker_t *thinker, int alpha, int beta, int ply)
+{
+    cb_board_t *board = &thinker->board;
+    uint64_t key = cb_board_key(board);
+    bool pseudo = thinker->eng->options[ENG_OPT_MOVEGEN] == ENG_MOVEGEN_PSEUDO;
+    cb_state_tables_t state;
+    cb_pseudo_tables_t pstate;
+    cb_mvlst_t mvlst;
+    tt_data_t tte;
+    cb_move_t mv, best_move = CB_INVALID_MOVE;
+    uint64_t checks;
+    bool tt_hit;
+    int old_alpha = alpha;
+    int stand_pat, best, score, i;
+
+    count_qnode(thinker);
+    thinker->pv_len[ply] = 0;
+    thinker->seldepth = ply > thinker->seldepth ? ply : thinker->seldepth;
+    if (is_draw(board))
+        return 0;
+    if (ply >= THINK_MAX_PLY - 1)
+        return evaluate(thinker);
+
+    /* Any entry is at least as deep as quiescence. */
+    if ((tt_hit = tt_probe(thinker->ttable, key, &tte))) {
+        score = score_from_tt(tte.score, ply);
+        if (beta - alpha == 1 && (tte.bound == TT_BOUND_EXACT
+                    || (tte.bound == TT_BOUND_LOWER && score >= beta)
+                    || (tte.bound == TT_BOUND_UPPER && score <= alpha)))
+            return score;
+    }
+
+    /* Out of check the side to move may decline every capture, before any are generated. */
+    if (pseudo)
+        cb_gen_pseudo_tables(&pstate, board);
+    else
+        cb_gen_board_tables(&state, board);
+    checks = pseudo ? pstate.checks : state.checks;
+    if (checks) {
+        stand_pat = -SCORE_INF;
+    } else {
+        stand_pat = tt_hit && tte.eval != TT_EVAL_NONE ? tte.eval : evaluate(thinker);
+        if (stand_pat >= beta)
+            return stand_pat;
+        alpha = stand_pat > alpha ? stand_pat : alpha;
+    }
+    best = stand_pat;
+    gen_qsearch_moves(thinker, &mvlst, &state, &pstate, pseudo, stand_pat, alpha);
+    mp_sort_captures(board, &mvlst);
+
+    for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
+        mv = cb_mvlst_at(&mvlst, i);
+
+        /* The generator pruned against alpha at the stand pat. Prune again as alpha rises.
+         * Evasions are never skipped. */
+        if (!checks && !(cb_mv_get_flags(mv) & CB_MV_KNIGHT_PROMO)
+                && stand_pat + mp_capture_value(board, mv) + DELTA_MARGIN <= alpha)
+            continue;
+        if (pseudo && !cb_is_legal(board, &pstate, mv))
+            continue;
+
+        make_move(thinker, mv);
+        score = -qsearch(thinker, -beta, -alpha, ply + 1);
+        cb_unmake(board);
+        if (should_stop(thinker))
+            return 0;
+
+        if (score > best) {
+            best = score;
+            best_move = mv;
+            if (score > alpha)
+                alpha = score;
+            if (alpha >= beta)
+                break;
+        }
+    }
+
+    /* In check with no legal evasion. */
+    if (best == -SCORE_INF)
+        return -SCORE_MATE + ply;
+
+    tt_store(thinker->ttable, key, &(tt_data_t) {
+        .move = best_move,
+        .score = score_to_tt(best, ply),
+        .eval = checks ? TT_EVAL_NONE : stand_pat,
+        .depth = 0,
+        .bound = best >= beta ? TT_BOUND_LOWER : best > old_alpha ? TT_BOUND_EXACT
+            : TT_BOUND_UPPER
+    });
+    return best;
+}
+
+/**
+ * Searches one move of a node with a null window, and again with the full window if it lands
+ * inside it. The eldest brother goes straight to the full window. A reduced move that beats
+ * alpha is searched again to the full depth first.
+ */
+static inline int search_move(thinker_t *thinker, cb_move_t mv, bool eldest, int alpha, int beta,
+                              int depth, int ply, int reduction)
+{
+    cb_board_t *board = &thinker->board;
+    int score;
+
+    make_move(thinker, mv);
+    if (eldest) {
+        score = -pvs(thinker, -beta, -alpha, depth - 1, ply + 1);
+    } else {
+        score = -pvs(thinker, -alpha - 1, -alpha, depth - 1 - reduction, ply + 1);
+        if (score > alpha && reduction > 0 && !should_stop(thinker))
+            score = -pvs(thinker, -alpha - 1, -alpha, depth - 1, ply + 1);
+        if (score > alpha && score < beta && !should_stop(thinker))
+            score = -pvs(thinker, -beta, -alpha, depth - 1, ply + 1);
+    }
+    cb_unmake(board);
+
+    return score;
+}
+
+/**
+ * Returns how far a late quiet move of a node is reduced, or -1 if it is pruned by futility.
+ * Moves that give check are neither. i is the index of the move at its node and best the best
+ * score found there so far. The check info is only made once a move needs it.
+ */
+static inline int late_move_rule(thinker_t *thinker, cb_check_info_t *info, bool *info_ready,
+                                 cb_move_t mv, int i, int depth, int best, bool pv_node,
+                                 bool futile, bool lmr)
+{
+    cb_board_t *board = &thinker->board;
+    int reduction;
+
+    if (!*info_ready) {
+        cb_gen_check_info(info, board);
+        *info_ready = true;
+    }
+    if (cb_quiet_gives_check(board, info, mv))
+        return 0;
+    if (futile && best > -SCORE_MATE_BOUND)
+        return -1;
+    if (!lmr)
+        return 0;
+
+    reduction = thinker->eng->reductions[depth < 64 ? depth : 63][i < 64 ? i : 63] - pv_node;
+    return reduction < 0 ? 0 : reduction > depth - 2 ? depth - 2 : reduction;
+}
+
+/**
+ * Searches the moves of a split point until they run out or it cuts off. The board must be at
+ * the node of the split point. Late quiet moves are pruned and reduced as in pvs, and a cutoff
+ * is counted and learned from by the thinker that made it. Returns true if that was this one.
+ */
+static bool work_split(thinker_t *thinker, split_point_t *sp, bool owner)
+{
+    split_point_t *parent = thinker->sp;
+    cb_check_info_t info;
+    cb_move_t quiets[CB_MAX_NUM_MOVES];
+    cb_move_t mv;
+    bool info_ready = false;
+    bool cut = false;
+    int num_quiets = 0;
+    int alpha, best, score, reduction, k;
+
+    thinker->sp = sp;
+    while (sp_next_move(sp, &mv, &k, &alpha, &best)) {
+        reduction = 0;
+        if (sp->late[k] && (sp->futile || sp->lmr)) {
+            reduction = late_move_rule(thinker, &info, &info_ready, mv, k + 1, sp->depth, best,
+                                       sp->pv_node, sp->futile, sp->lmr);
+            if (reduction < 0)
+                continue;
+        }
+
+        score = search_move(thinker, mv, false, alpha, sp->beta, sp->depth, sp->ply, reduction);
+        if (should_stop(thinker))
+            break;
+
+        /* Only the owner's table holds the line below the node. */
+        if (sp_update(sp, mv, score, &cut) && owner)
+            update_pv(thinker, sp->ply, mv);
+        if (cut) {
+            count_cutoff(thinker, false);
+            if (mp_is_quiet(mv))
+                mp_reward_quiet(thinker, mv, sp->depth, sp->ply, quiets, num_quiets);
+            break;
+        }
+        if (mp_is_quiet(mv))
+            quiets[num_quiets++] = mv;
+    }
+    thinker->sp = parent;
+    return cut;
+}
+
+/**
+ * Searches the moves of a node from first on alone, with the same rules as work_split. Used
+ * when a split point cannot be made. The moves were drained from the picker, so nothing else
+ * will search them.
+ */
+static int search_drained(thinker_t *thinker, const cb_mvlst_t *mvlst, const bool *late,
+                          int first, int alpha, int beta, int best, cb_move_t *best_move,
+                          int depth, int ply, bool pv_node, bool futile, bool lmr,
+                          cb_move_t *quiets, int num_quiets)
+{
+    cb_check_info_t info;
+    cb_move_t mv;
+    bool info_ready = false;
+    int score, reduction, k;
+
+    for (k = first; k < cb_mvlst_size((cb_mvlst_t *)mvlst); k++) {
+        mv = mvlst->moves[k];
+        reduction = 0;
+        if (late[k] && (futile || lmr)) {
+            reduction = late_move_rule(thinker, &info, &info_ready, mv, k + 1, depth, best,
+                                       pv_node, futile, lmr);
+            if (reduction < 0)
+                continue;
+        }
+
+        score = search_move(thinker, mv, false, alpha, beta, depth, ply, reduction);
+        if (should_stop(thinker))
+            break;
+        if (score > best) {
+            best = score;
+            *best_move = mv;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(thinker, ply, mv);
+            }
+            if (alpha >= beta) {
+                count_cutoff(thinker, false);
+                if (mp_is_quiet(mv))
+                    mp_reward_quiet(thinker, mv, depth, ply, quiets, num_quiets);
+                break;
+            }
+        }
+        if (mp_is_quiet(mv))
+            quiets[num_quiets++] = mv;
+    }
+    return best;
+}
+
+/**
+ * Shares the moves of a node from first on with the idle thinkers and searches them along
+ * with the helpers. Returns the best score of the node and updates *best_move. quiets holds
+ * the quiet moves the owner searched before the split and must have room for every move.
+ */
+static int split(thinker_t *thinker, const cb_mvlst_t *mvlst, const bool *late, int first,
+                 int alpha, int beta, int best, cb_move_t *best_move, int depth, int ply,
+                 bool pv_node, bool futile, bool lmr, cb_move_t *quiets, int num_quiets)
+{
+    split_point_t sp;
+    bool cut;
+    int k;
+
+    if (sp_open(&sp, thinker, mvlst, late, first, alpha, beta, best, *best_move, depth, ply,
+                pv_node, futile, lmr) != CIBYL_EOK)
+        return search_drained(thinker, mvlst, late, first, alpha, beta, best, best_move, depth,
+                              ply, pv_node, futile, lmr, quiets, num_quiets);
+    cut = work_split(thinker, &sp, true);
+    sp_close(&sp, thinker);
+
+    /* A move found by a helper leaves only itself as the line. */
+    if (sp.best > alpha && (thinker->pv_len[ply] == 0 || thinker->pv[ply][0] != sp.best_move)) {
+        thinker->pv[ply][0] = sp.best_move;
+        thinker->pv_len[ply] = 1;
+    }
+
+    /* The owner learns from a quiet cutoff of a helper too. Every quiet move ahead of it was
+     * handed out first, so count those as tried. */
+    if (!cut && sp.best >= beta && mp_is_quiet(sp.best_move)) {
+        for (k = first; k < cb_mvlst_size(&sp.moves) && sp.moves.moves[k] != sp.best_move; k++) {
+            if (mp_is_quiet(sp.moves.moves[k]))
+                quiets[num_quiets++] = sp.moves.moves[k];
+        }
+        mp_reward_quiet(thinker, sp.best_move, depth, ply, quiets, num_quiets);
+    }
+    *best_move = sp.best_move;
+    return sp.best;
+}
+
+/**
+ * Runs the idle loop of a YBWC helper. Joins split points of the other thinkers until the
+ * search is stopped. The board is at the root between split points.
+ */
+static void help(thinker_t *thinker)
+{
+    engine_t *eng = thinker->eng;
+    cb_board_t *board = &thinker->board;
+    split_point_t *sp;
+    int i;
+
+    while (!atomic_load_explicit(&eng->stop_flag, memory_order_relaxed)) {
+        if ((sp = sp_steal(eng, thinker)) == NULL) {
+            thrd_yield();
+            continue;
+        }
+
+        /* Walk down to the node of the split point. Its path is constant, and may pass. */
+        for (i = 0; i < sp->path_len; i++) {
+            if (sp->path[i] == CB_NULL_MOVE)
+                make_null(thinker);
+            else
+                make_move(thinker, sp->path[i]);
+        }
+        work_split(thinker, sp, false);
+        for (i = sp->path_len - 1; i >= 0; i--) {
+            if (sp->path[i] == CB_NULL_MOVE)
+                cb_unmake_null(board);
+            else
+                cb_unmake(board);
+        }
+        sp_leave(sp);
+    }
+}
+
+/**
+ * Negamax principal variation search. Returns the score of the position from the side to move.
+ */
+static int pvs(thinker_t *thinker, int alpha, int beta, int depth, int ply)
+{
+    cb_board_t *board = &thinker->board;
+    const int64_t *opts = thinker->eng->options;
+    uint64_t key = cb_board_key(board);
+    cb_state_tables_t state;
+    cb_pseudo_tables_t pstate;
+    cb_check_info_t info;
+    move_picker_t mp;
+    cb_mvlst_t rest;
+    bool late[CB_MAX_NUM_MOVES];
+    tt_data_t tte;
+    cb_move_t quiets[CB_MAX_NUM_MOVES];
+    cb_move_t mv, hash_move = CB_INVALID_MOVE, best_move = CB_INVALID_MOVE;
+    bool pv_node = beta - alpha > 1;
+    bool tt_hit, futile = false;
+    bool info_ready = false;
+    bool in_check, lmr;
+    int old_alpha = alpha;
+    int best = -SCORE_INF;
+    int num_quiets = 0;
+    int static_eval = TT_EVAL_NONE;
+    int tt_score = -SCORE_INF;
+    int prune_eval, score, reduction, i;
+
+    if (depth <= 0)
+        return qsearch(thinker, alpha, beta, ply);
+
+    count_node(thinker);
+    thinker->pv_len[ply] = 0;
+    thinker->seldepth = ply > thinker->seldepth ? ply : thinker->seldepth;
+    if (is_draw(board))
+        return 0;
+    if (ply >= THINK_MAX_PLY - 1)
+        return evaluate(thinker);
+
+    /* Cut off on a deep enough entry. Never on a PV node, where the line is wanted. */
+    if ((tt_hit = tt_probe(thinker->ttable, key, &tte))) {
+        tt_score = score_from_tt(tte.score, ply);
+        if (tte.depth >= depth && !pv_node && (tte.bound == TT_BOUND_EXACT
+                    || (tte.bound == TT_BOUND_LOWER && tt_score >= beta)
+                    || (tte.bound == TT_BOUND_UPPER && tt_score <= alpha)))
+            return tt_score;
+        hash_move = tte.move;
+    }
+
+    if (opts[ENG_OPT_MOVEGEN] == ENG_MOVEGEN_PSEUDO) {
+        cb_gen_pseudo_tables(&pstate, board);
+        in_check = pstate.checks != 0;
+    } else {
+        cb_gen_board_tables(&state, board);
+        in_check = state.checks != 0;
+    }
+    if (!in_check)
+        static_eval = tt_hit && tte.eval != TT_EVAL_NONE ? tte.eval : evaluate(thinker);
+
+    /* Prune nodes that the static eval says are decided. Never in check or on the PV. A bound
+     * from the table that is tighter than the static eval is the better guess. */
+    if (!pv_node && !in_check) {
+        prune_eval = static_eval;
+        if (tt_hit && tt_score > -SCORE_MATE_BOUND && tt_score < SCORE_MATE_BOUND
+                && ((tte.bound == TT_BOUND_LOWER && tt_score > prune_eval)
+                    || (tte.bound == TT_BOUND_UPPER && tt_score < prune_eval)))
+            prune_eval = tt_score;
+
+        /* So far above beta that the opponent will not get back. */
+        if (opts[ENG_OPT_RFP] && depth <= opts[ENG_OPT_RFP_DEPTH] && beta < SCORE_MATE_BOUND
+                && prune_eval - opts[ENG_OPT_RFP_MARGIN] * depth >= beta)
+            return prune_eval;
+
+        /* So far below alpha that only a capture could help. */
+        if (opts[ENG_OPT_RAZORING] && depth <= opts[ENG_OPT_RAZOR_DEPTH]
+                && prune_eval + opts[ENG_OPT_RAZOR_MARGIN] * depth <= alpha) {
+            score = qsearch(thinker, alpha, beta, ply);
+            if (score <= alpha)
+                return score;
+        }
+
+        if (opts[ENG_OPT_NULL_MOVE] && depth >= NULL_MOVE_MIN_DEPTH && prune_eval >= beta
+                && ply >= thinker->null_min_ply && beta > -SCORE_MATE_BOUND
+                && has_pieces(board)
+                && board->hist.data[board->hist.count - 1].move != CB_NULL_MOVE) {
+            score = null_move(thinker, beta, depth, ply);
+            if (should_stop(thinker))
+                return 0;
+            if (score >= beta)
+                return score;
+        }
+
+        futile = opts[ENG_OPT_FUTILITY] && depth <= opts[ENG_OPT_FUTILITY_DEPTH]
+            && prune_eval + opts[ENG_OPT_FUTILITY_MARGIN] * depth <= alpha;
+    }
+
+    mp_init(&mp, thinker, opts[ENG_OPT_MOVEGEN] == ENG_MOVEGEN_PSEUDO ? NULL : &state, &pstate,
+            hash_move, ply);
+    lmr = opts[ENG_OPT_LMR] && depth >= LMR_MIN_DEPTH && !in_check;
+
+    for (i = 0; (mv = mp_next(&mp)) != CB_INVALID_MOVE; i++) {
+        reduction = 0;
+
+        /* Late quiet moves that do not give check can be pruned or reduced. Killers, the
+         * countermove and the hash move come out before MP_QUIETS. */
+        if (i > 0 && mp.stage == MP_QUIETS && (futile || lmr)) {
+            reduction = late_move_rule(thinker, &info, &info_ready, mv, i, depth, best, pv_node,
+                                       futile, lmr);
+            if (reduction < 0)
+                continue;
+        }
+
+        score = search_move(thinker, mv, i == 0, alpha, beta, depth, ply, reduction);
+        if (should_stop(thinker))
+            return 0;
+
+        if (score > best) {
+            best = score;
+            best_move = mv;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(thinker, ply, mv);
+            }
+            if (alpha >= beta) {
+                count_cutoff(thinker, i == 0);
+                if (mp_is_quiet(mv))
+                    mp_reward_quiet(thinker, mv, depth, ply, quiets, num_quiets);
+                break;
+            }
+        }
+        if (mp_is_quiet(mv))
+            quiets[num_quiets++] = mv;
+
+        /* The eldest brother is searched. The rest can be shared. */
+        if (i == 0 && thinker->eng->options[ENG_OPT_YBWC] && thinker->eng->num_thinkers > 1
+                && depth >= SPLIT_MIN_DEPTH
+                && mp_size(&mp) > 1 && sp_deque_has_room(&thinker->deque)) {
+            mp_drain(&mp, &rest, late);
+            best = split(thinker, &rest, late, 0, alpha, beta, best, &best_move, depth, ply,
+                         pv_node, futile, lmr, quiets, num_quiets);
+            if (should_stop(thinker))
+                return 0;
+            break;
+        }
+    }
+
+    /* No legal moves is either mate or stalemate. Pseudo-legal ones only show this once they
+     * have all been tested. */
+    if (i == 0 && best == -SCORE_INF)
+        return in_check ? -SCORE_MATE + ply : 0;
+
+    tt_store(thinker->ttable, key, &(tt_data_t) {
+        .move = best_move,
+        .score = score_to_tt(best, ply),
+        .eval = static_eval,
+        .depth = depth,
+        .bound = best >= beta ? TT_BOUND_LOWER : best > old_alpha ? TT_BOUND_EXACT
+            : TT_BOUND_UPPER
+    });
+    return best;
+}
+
+/**
+ * Searches every root move to a depth inside a window. Returns the best score. Sets *best_move
+ * and the root line only when a move lands above alpha.
+ */
+static int search_root(thinker_t *thinker, cb_mvlst_t *root, int depth, int alpha, int beta,
+                       cb_move_t *best_move)
+{
+    cb_board_t *board = &thinker->board;
+    int old_alpha = alpha;
+    int best = -SCORE_INF;
+    int score, i;
+
+    thinker->pv_len[0] = 0;
+    for (i = 0; i < cb_mvlst_size(root); i++) {
+        score = search_move(thinker, root->moves[i], i == 0, alpha, beta, depth, 0, 0);
+        if (should_stop(thinker))
+            return best;
+
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                *best_move = root->moves[i];
+                update_pv(thinker, 0, root->moves[i]);
+            }
+            if (alpha >= beta)
+                break;
+        }
+    }
+
+    tt_store(thinker->ttable, cb_board_key(board), &(tt_data_t) {
+        .move = *best_move,
+        .score = score_to_tt(best, 0),
+        .eval = TT_EVAL_NONE,
+        .depth = depth,
+        .bound = best >= beta ? TT_BOUND_LOWER : best > old_alpha ? TT_BOUND_EXACT
+            : TT_BOUND_UPPER
+    });
+    return best;
+}
+
+/**
+ * Searches the root inside a window around the score of the last iteration. A fail widens the
+ * window on the failing side and searches again.
+ */
+static int aspiration(thinker_t *thinker, cb_mvlst_t *root, int depth, int prev,
+                      cb_move_t *best_move)
+{
+    int delta = ASPIRATION_WINDOW;
+    int alpha = -SCORE_INF;
+    int beta = SCORE_INF;
+    int score;
+
+    if (depth >= ASPIRATION_MIN_DEPTH && prev > -SCORE_MATE_BOUND && prev < SCORE_MATE_BOUND) {
+        alpha = prev - delta;
+        beta = prev + delta;
+    }
+
+    while (true) {
+        score = search_root(thinker, root, depth, alpha, beta, best_move);
+        if (should_stop(thinker))
+            return score;
+
+        if (score <= alpha) {
+            beta = (alpha + beta) / 2;
+            alpha = score - delta > -SCORE_INF ? score - delta : -SCORE_INF;
+        } else if (score >= beta) {
+            beta = score + delta < SCORE_INF ? score + delta : SCORE_INF;
+        } else {
+            return score;
+        }
+        delta *= 2;
+    }
+}
+
+/**
+ * Formats a score for an info line.
+ */
+static void score_to_str(char *buf, size_t len, int score)
+{
+    if (score > SCORE_MATE_BOUND)
+        snprintf(buf, len, "mate %d", (SCORE_MATE - score + 1) / 2);
+    else if (score < -SCORE_MATE_BOUND)
+        snprintf(buf, len, "mate %d", -(SCORE_MATE + score) / 2);
+    else
+        snprintf(buf, len, "cp %d", score);
+}
+
+/**
+ * Sums the quiescence nodes and the cutoffs of every thinker of the engine.
+ */
+static void total_stats(engine_t *eng, uint64_t *qnodes, uint64_t *cutoffs,
+                        uint64_t *first_cutoffs)
+{
+    thinker_t *thinker;
+    int i;
+
+    *qnodes = *cutoffs = *first_cutoffs = 0;
+    for (i = 0; i < eng->num_thinkers; i++) {
+        thinker = &eng->thinkers[i];
+        *qnodes += atomic_load_explicit(&thinker->qnodes, memory_order_relaxed);
+        *cutoffs += atomic_load_explicit(&thinker->cutoffs, memory_order_relaxed);
+        *first_cutoffs += atomic_load_explicit(&thinker->first_cutoffs, memory_order_relaxed);
+    }
+}
+
+/**
+ * Sends the result of a completed depth to the GUI, along with the effective branching factor
+ * of the iteration, its nodes over the nodes of the iteration before it, the share of the nodes
+ * so far that were searched in quiescence and the share of the cutoffs made by the first move.
+ */
+static void report_depth(thinker_t *thinker, uint64_t iter_nodes, uint64_t prev_iter_nodes)
+{
+    engine_t *eng = thinker->eng;
+    uint64_t elapsed = time_ns() - eng->start_ns;
+    uint64_t nodes = total_nodes(eng);
+    uint64_t qnodes, cutoffs, first_cutoffs;
+    char msg[ENG_MSG_LEN];
+    char mv_str[6];
+    int len, i;
+
+    if (eng->quiet)
+        return;
+
+    len = snprintf(msg, sizeof(msg), "info depth %d seldepth %d score ", thinker->depth,
+                   thinker->seldepth);
+    score_to_str(msg + len, sizeof(msg) - len, thinker->best_score);
+    len = strlen(msg);
+    len += snprintf(msg + len, sizeof(msg) - len, " nodes %" PRIu64 " nps %" PRIu64 " time %"
+                    PRIu64 " hashfull %d pv", nodes,
+                    nodes * UINT64_C(1000000000) / (elapsed + 1), elapsed / 1000000,
+                    tt_hashfull(thinker->ttable));
+    for (i = 0; i < thinker->best_pv_len && len < (int)sizeof(msg) - 8; i++) {
+        cb_mv_to_uci_algbr(mv_str, thinker->best_pv[i]);
+        len += snprintf(msg + len, sizeof(msg) - len, " %s", mv_str);
+    }
+    eng_write_msg(eng, "%s\n", msg);
+
+    total_stats(eng, &qnodes, &cutoffs, &first_cutoffs);
+    eng_write_msg(eng, "info string depth %d ebf %.2f qnodes %.1f%% first cutoff %.1f%%\n",
+                  thinker->depth, prev_iter_nodes > 0 ? (double)iter_nodes / prev_iter_nodes : 0.0,
+                  100.0 * qnodes / (nodes + 1), 100.0 * first_cutoffs / (cutoffs + 1));
+}
+
+void thinker_search(thinker_t *thinker)
+{
+    engine_t *eng = thinker->eng;
+    const go_param_t *params = &eng->go_params;
+    cb_board_t *board = &thinker->board;
+    cb_state_tables_t state;
+    cb_mvlst_t root;
+    cb_move_t best_move, tmp;
+    uint64_t iter_start, iter_nodes = 0, prev_iter_nodes;
+    int max_depth = THINK_MAX_PLY - 1;
+    int depth, score = 0, i;
+
+    thinker->root_count = board->hist.count;
+    thinker->sp = NULL;
+    thinker->limit_mask = LIMIT_CHECK_NODES - 1;
+    while (thinker->limit_mask + 1 > LIMIT_CHECK_MIN
+            && (thinker->limit_mask + 1) * eng->num_thinkers > LIMIT_CHECK_NODES)
+        thinker->limit_mask >>= 1;
+    thinker->seldepth = 0;
+    thinker->best_pv_len = 0;
+    thinker->null_min_ply = 0;
+    eval_state_init(&thinker->evals[0], board);
+    mp_age_tables(thinker);
+    if (thinker->id != 0 && eng->options[ENG_OPT_YBWC]) {
+        help(thinker);
+        return;
+    }
+
+    cb_gen_board_tables(&state, board);
+    cb_gen_moves(&root, board, &state);
+    if (cb_mvlst_size(&root) == 0)
+        return;
+
+    /* Only the main thinker stops at the depth limit. The helpers run until they are told to.
+     * A mate in n is seen by a search of 2n plies, the last of which finds no moves. */
+    if (thinker->id == 0 && params->depth > 0)
+        max_depth = params->depth < max_depth ? params->depth : max_depth;
+    if (thinker->id == 0 && params->mate > 0)
+        max_depth = 2 * params->mate < max_depth ? 2 * params->mate : max_depth;
+
+    /* Helpers try the root moves in a different order than the main thinker. */
+    for (i = 0; i < thinker->id % cb_mvlst_size(&root); i++) {
+        tmp = cb_mvlst_pop(&root);
+        memmove(root.moves + 1, root.moves, cb_mvlst_size(&root) * sizeof(cb_move_t));
+        root.moves[0] = tmp;
+        root.head++;
+    }
+
+    for (depth = 1 + thinker->id % 2; depth <= max_depth; depth++) {
+        iter_start = total_nodes(eng);
+        best_move = thinker->best_move;
+        score = aspiration(thinker, &root, depth, score, &best_move);
+        if (should_stop(thinker) || best_move == CB_INVALID_MOVE)
+            break;
+
+        thinker->depth = depth;
+        thinker->best_move = best_move;
+        thinker->best_score = score;
+        memcpy(thinker->best_pv, thinker->pv[0], thinker->pv_len[0] * sizeof(cb_move_t));
+        thinker->best_pv_len = thinker->pv_len[0];
+        move_to_front(&root, best_move);
+
+        prev_iter_nodes = iter_nodes;
+        iter_nodes = total_nodes(eng) - iter_start;
+        if (thinker->id != 0)
+            continue;
+        report_depth(thinker, iter_nodes, prev_iter_nodes);
+
+        /* Out of soft time. The engine stops the helpers once the main thinker returns. The
+         * time spent pondering counts, so a long ponder search is cut short once it is hit. */
+        if (tm_iteration_done(&eng->tm, depth, best_move, score, time_ns() - eng->start_ns)
+                && !atomic_load(&eng->pondering))
+            break;
+    }
+}
+
+void thinker_init_reductions(engine_t *eng)
+{
+    double base = eng->options[ENG_OPT_LMR_BASE] / 100.0;
+    double divisor = eng->options[ENG_OPT_LMR_DIVISOR] / 100.0;
+    int depth, moves;
+
+    for (depth = 0; depth < 64; depth++) {
+        for (moves = 0; moves < 64; moves++) {
+            eng->reductions[depth][moves] = depth == 0 || moves == 0 ? 0
+                : (uint8_t)(base + log(depth) * log(moves) / divisor);
+        }
+    }
+}
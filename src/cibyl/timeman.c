@@ -0,0 +1,82 @@
+
+#include "cb_const.h"
+#include "timeman.h"
+
+/* Iterations shallower than this are too noisy to steer the clock. */
+#define TM_MIN_DEPTH 4
+
+/* A score this far below the first deep iteration doubles the time. */
+#define TM_SCORE_DROP 100
+
+void tm_init(time_manager_t *tm, int64_t time, int64_t inc, int64_t movestogo, int64_t movetime,
+             int64_t overhead)
+{
+    int64_t avail, soft, hard, mtg;
+
+    tm->scale = 100;
+    tm->instability = 0;
+    tm->last_move = CB_INVALID_MOVE;
+    tm->last_score = 0;
+    tm->first_score = 0;
+
+    if (movetime > 0) {
+        hard = movetime - overhead > 1 ? movetime - overhead : 1;
+        tm->active = true;
+        tm->fixed = true;
+        tm->soft_ns = hard * 1000000;
+        tm->hard_ns = hard * 1000000;
+        return;
+    }
+    tm->fixed = false;
+    if (time < 0) {
+        tm->active = false;
+        return;
+    }
+
+    /* Spread what is left over the moves to go, plus most of each increment. The increment of
+     * this move is already on the clock. */
+    avail = time - overhead > 1 ? time - overhead : 1;
+    inc = inc > 0 ? inc : 0;
+    mtg = movestogo > 0 && movestogo < TM_MOVE_HORIZON ? movestogo : TM_MOVE_HORIZON;
+    soft = avail / mtg + inc * 3 / 4;
+
+    hard = soft * TM_HARD_FACTOR;
+    hard = hard < avail * TM_MAX_USE / 100 ? hard : avail * TM_MAX_USE / 100;
+    hard = hard > 1 ? hard : 1;
+    soft = soft < hard ? soft : hard;
+
+    tm->active = true;
+    tm->soft_ns = soft * 1000000;
+    tm->hard_ns = hard * 1000000;
+}
+
+bool tm_iteration_done(time_manager_t *tm, int depth, cb_move_t best_move, int score,
+                       uint64_t elapsed_ns)
+{
+    int drop, scale;
+
+    /* Eighths of a change. An old change counts half as much every iteration. */
+    tm->instability /= 2;
+    if (tm->last_move != CB_INVALID_MOVE && best_move != tm->last_move)
+        tm->instability += 8;
+    if (depth == TM_MIN_DEPTH)
+        tm->first_score = score;
+    tm->last_move = best_move;
+    tm->last_score = score;
+
+    if (!tm->active)
+        return false;
+    if (tm->fixed || depth < TM_MIN_DEPTH)
+        return elapsed_ns >= tm->soft_ns;
+
+    /* A move that has not changed in a while gets less time, an unstable one up to twice. */
+    scale = tm->instability == 0 ? 70 : 100 + (tm->instability > 16 ? 100
+            : tm->instability * 100 / 16);
+    drop = tm->first_score - score;
+    if (drop > 0)
+        scale = scale * (100 + (drop < TM_SCORE_DROP ? drop : TM_SCORE_DROP) * 100 / TM_SCORE_DROP)
+            / 100;
+    tm->scale = scale;
+
+    return elapsed_ns >= tm->soft_ns * scale / 100 || elapsed_ns >= tm->hard_ns;
+}
@@ -0,0 +1,203 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb_const.h"
+#include "ttable.h"
+
+#define TT_HASHFULL_SAMPLE 1000
+
+/*
+ * Layout of the data word of a slot, low bits first.
+ *
+ *     0-15   move
+ *     16-31  score
+ *     32-47  static eval
+ *     48-55  depth
+ *     56-57  bound
+ *     58-63  age
+ */
+
+static inline uint64_t tt_pack(const tt_data_t *data, uint8_t age)
+{
+    return (uint64_t)data->move
+        | (uint64_t)(uint16_t)data->score << 16
+        | (uint64_t)(uint16_t)data->eval << 32
+        | (uint64_t)(uint8_t)data->depth << 48
+        | (uint64_t)(data->bound & 3) << 56
+        | (uint64_t)(age & TT_AGE_MASK) << 58;
+}
+
+static inline void tt_unpack(tt_data_t *data, uint64_t word)
+{
+    data->move = word & 0xFFFF;
+    data->score = (int16_t)(word >> 16);
+    data->eval = (int16_t)(word >> 32);
+    data->depth = (int8_t)(word >> 48);
+    data->bound = (word >> 56) & 3;
+}
+
+static inline uint8_t tt_word_age(uint64_t word)
+{
+    return word >> 58;
+}
+
+static inline int8_t tt_word_depth(uint64_t word)
+{
+    return (int8_t)(word >> 48);
+}
+
+static inline uint8_t tt_word_bound(uint64_t word)
+{
+    return (word >> 56) & 3;
+}
+
+/**
+ * Returns what the key fragment of a slot holding word for key must read.
+ */
+static inline uint32_t tt_fragment(uint64_t key, uint64_t word)
+{
+    return (uint32_t)(key >> 32) ^ (uint32_t)word ^ (uint32_t)(word >> 32);
+}
+
+/**
+ * Returns true if slot i of a bucket holds key. Sets *word to its data word.
+ */
+static inline bool tt_slot_matches(const tt_bucket_t *bucket, int i, uint64_t key,
+                                   uint64_t *word)
+{
+    *word = atomic_load_explicit(&bucket->data[i], memory_order_relaxed);
+    return atomic_load_explicit(&bucket->keys[i], memory_order_relaxed)
+        == tt_fragment(key, *word) && tt_word_bound(*word) != TT_BOUND_NONE;
+}
+
+/**
+ * Returns the number of searches since a slot was written.
+ */
+static inline int tt_word_staleness(const ttable_t *tt, uint64_t word)
+{
+    return (tt->age - tt_word_age(word)) & TT_AGE_MASK;
+}
+
+static cibyl_errno_t tt_alloc(ttable_t *tt, size_t mb)
+{
+    uint64_t count = 1;
+    size_t bytes;
+
+    /* Round down to a power of two so a bucket is picked with a mask. */
+    mb = mb < 1 ? 1 : mb > TT_MAX_MB ? TT_MAX_MB : mb;
+    while (count * 2 * sizeof(tt_bucket_t) <= mb * UINT64_C(1024) * 1024)
+        count *= 2;
+    bytes = count * sizeof(tt_bucket_t);
+
+    if ((tt->buckets = aligned_alloc(sizeof(tt_bucket_t), bytes)) == NULL) {
+        cibyl_write_log("tt_alloc: failed to allocate %zu bytes\n", bytes);
+        return CIBYL_ENOMEM;
+    }
+    tt->mask = count - 1;
+    tt->mb = mb;
+    tt_clear(tt);
+    return CIBYL_EOK;
+}
+
+cibyl_errno_t tt_init(ttable_t *tt, size_t mb)
+{
+    tt->buckets = NULL;
+    tt->age = 0;
+    return tt_alloc(tt, mb);
+}
+
+void tt_free(ttable_t *tt)
+{
+    free(tt->buckets);
+    tt->buckets = NULL;
+    tt->mask = 0;
+}
+
+cibyl_errno_t tt_resize(ttable_t *tt, size_t mb)
+{
+    ttable_t old = *tt;
+
+    if (tt_alloc(tt, mb) != CIBYL_EOK) {
+        *tt = old;
+        return CIBYL_ENOMEM;
+    }
+    free(old.buckets);
+    return CIBYL_EOK;
+}
+
+void tt_clear(ttable_t *tt)
+{
+    /* Nothing is searching, so the slots can be wiped without atomics. */
+    memset(tt->buckets, 0, (tt->mask + 1) * sizeof(tt_bucket_t));
+}
+
+bool tt_probe(const ttable_t *tt, uint64_t key, tt_data_t *out)
+{
+    tt_bucket_t *bucket = &tt->buckets[key & tt->mask];
+    uint64_t word;
+    int i;
+
+    for (i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        if (!tt_slot_matches(bucket, i, key, &word))
+            continue;
+        tt_unpack(out, word);
+        return true;
+    }
+
+    return false;
+}
+
+void tt_store(ttable_t *tt, uint64_t key, const tt_data_t *data)
+{
+    tt_bucket_t *bucket = &tt->buckets[key & tt->mask];
+    tt_data_t merged = *data;
+    uint64_t word, victim_word;
+    int i, victim = 0, worth, victim_worth = INT32_MAX;
+
+    for (i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        /* The same position. Keep a much deeper result from this search. */
+        if (tt_slot_matches(bucket, i, key, &word)) {
+            if (data->bound != TT_BOUND_EXACT && tt_word_staleness(tt, word) == 0
+                    && tt_word_depth(word) > data->depth + 3)
+                return;
+            if (merged.move == CB_INVALID_MOVE)
+                merged.move = word & 0xFFFF;
+            victim = i;
+            break;
+        }
+
+        /* Otherwise replace the slot least worth keeping. Every search of age counts as much
+         * as eight plies of depth. */
+        worth = tt_word_bound(word) == TT_BOUND_NONE ? INT32_MIN
+            : tt_word_depth(word) - 8 * tt_word_staleness(tt, word);
+        if (worth < victim_worth) {
+            victim = i;
+            victim_worth = worth;
+        }
+    }
+
+    victim_word = tt_pack(&merged, tt->age);
+    atomic_store_explicit(&bucket->keys[victim], tt_fragment(key, victim_word),
+                          memory_order_relaxed);
+    atomic_store_explicit(&bucket->data[victim], victim_word, memory_order_relaxed);
+}
+
+int tt_hashfull(const ttable_t *tt)
+{
+    uint64_t buckets = TT_HASHFULL_SAMPLE / TT_BUCKET_ENTRIES;
+    uint64_t word;
+    uint64_t b;
+    int i, count = 0;
+
+    buckets = buckets < tt->mask + 1 ? buckets : tt->mask + 1;
+    for (b = 0; b < buckets; b++) {
+        for (i = 0; i < TT_BUCKET_ENTRIES; i++) {
+            word = atomic_load_explicit(&tt->buckets[b].data[i], memory_order_relaxed);
+            if (tt_word_bound(word) != TT_BOUND_NONE && tt_word_staleness(tt, word) == 0)
+                count++;
+        }
+    }
+
+    return count * 1000 / (buckets * TT_BUCKET_ENTRIES);
+}
@@ -2,9 +2,12 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
 
 #include "cibyl.h"
 #include "uci.h"
+#include "engbench.h"
 
 /* Command strings for matching. */
 const char STR_UCI[] = "uci";
@@ -22,10 +25,13 @@ const char STR_QUIT[] = "quit";
 /* Non-uci command strings. */
 const char STR_DISPLAY[] = "d";
 const char STR_EVAL[] = "eval";
+const char STR_BENCH[] = "bench";
 
 const char ENGINE_NAME[] = "Cibyl";
 const char ENGINE_AUTHOR[] = "Joel Kuehne";
 
+#define UCI_LINE_LEN 16384
+
 uci_engine_t engine;
 
 cibyl_errno_t handle_position(char *opts)
@@ -43,7 +49,7 @@ cibyl_errno_t parse_i64(char *token, int64_t *out)
 {
     char *endp;
 
-    if (token == NULL && *token == '\0') {
+    if (token == NULL || *token == '\0') {
         cibyl_write_log("parse_i64: valid string expected\n");
         return CIBYL_EABORT;
     }
@@ -93,17 +99,12 @@ cibyl_errno_t handle_go(char *opts)
     /* Clear go params. */
     clear_go_params(&go_params);
 
-    /* Handle null input. */
-    if (opts == NULL) {
-        return CIBYL_EABORT;
-    }
-
-    /* Loop through all of the arguments to the go command. */
-    token = strtok(opts, " ");
+    /* Loop through all of the arguments to the go command. A bare go has none. */
+    token = opts == NULL ? NULL : strtok(opts, " ");
     while (token != NULL) {
         /* Handle searchmoves, this will consume all remaining arguments. */
         if (strcmp(token, STR_GO_SEARCHMOVES) == 0) {
-            handle_searchmoves(strtok(opts, " "));
+            handle_searchmoves(strtok(NULL, ""));
             break;
         }
 
@@ -116,34 +117,34 @@ cibyl_errno_t handle_go(char *opts)
 
         /* Handle time information. */
         else if (strcmp(token, STR_GO_WTIME) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.wtime) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.wtime) < 0)
                 return CIBYL_EABORT;
         } else if (strcmp(token, STR_GO_BTIME) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.btime) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.btime) < 0)
                 return CIBYL_EABORT;
         } else if (strcmp(token, STR_GO_WINC) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.winc) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.winc) < 0)
                 return CIBYL_EABORT;
         } else if (strcmp(token, STR_GO_BINC) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.binc) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.binc) < 0)
                 return CIBYL_EABORT;
         }
 
         /* Handle move stopping. */
         else if (strcmp(token, STR_GO_MOVESTOGO) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.movestogo) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.movestogo) < 0)
                 return CIBYL_EABORT;
         } else if (strcmp(token, STR_GO_DEPTH) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.depth) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.depth) < 0)
                 return CIBYL_EABORT;
         } else if (strcmp(token, STR_GO_NODES) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.nodes) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.nodes) < 0)
                 return CIBYL_EABORT;
         } else if (strcmp(token, STR_GO_MATE) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.mate) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.mate) < 0)
                 return CIBYL_EABORT;
         } else if (strcmp(token, STR_GO_MOVETIME) == 0) {
-            if (parse_i64(strtok(opts, " "), &go_params.movetime) < 0)
+            if (parse_i64(strtok(NULL, " "), &go_params.movetime) < 0)
                 return CIBYL_EABORT;
         }
 
@@ -162,65 +163,175 @@ void hanlde_display()
 
 }
 
+void handle_uci()
+{
+    const eng_option_t *opt;
+    int i, j;
+
+    printf("id name %s\n", ENGINE_NAME);
+    printf("id author %s\n", ENGINE_AUTHOR);
+
+    /* Advertise every option of the engine. */
+    for (i = 0; i < ENG_OPT_COUNT; i++) {
+        opt = &ENG_OPTIONS[i];
+        if (opt->type == ENG_OPT_SPIN) {
+            printf("option name %s type spin default %" PRId64 " min %" PRId64 " max %" PRId64
+                   "\n", opt->name, opt->def, opt->min, opt->max);
+        } else if (opt->type == ENG_OPT_CHECK) {
+            printf("option name %s type check default %s\n", opt->name,
+                   opt->def ? "true" : "false");
+        } else if (opt->type == ENG_OPT_COMBO) {
+            printf("option name %s type combo default %s", opt->name, opt->vars[opt->def]);
+            for (j = 0; j <= opt->max; j++)
+                printf(" var %s", opt->vars[j]);
+            printf("\n");
+        } else {
+            printf("option name %s type button\n", opt->name);
+        }
+    }
+
+    printf("uciok\n");
+}
+
+cibyl_errno_t handle_bench()
+{
+    int64_t depth = ENGBENCH_DEFAULT_DEPTH;
+    int64_t threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool ybwc = false;
+    int64_t iterations = ENGBENCH_EVAL_ITERATIONS;
+    bool prune = false;
+    bool movegen = false;
+    char *token = strtok(NULL, " \n");
+
+    /* bench [counters] followed by [smp|ybwc] [depth] [threads], prune [depth],
+     * movegen [depth] or eval [iterations], or bench draw [depth] */
+    engbench_counters = token != NULL && strcmp(token, "counters") == 0;
+    if (engbench_counters)
+        token = strtok(NULL, " \n");
+    if (token != NULL && strcmp(token, "draw") == 0) {
+        depth = ENGBENCH_DRAW_DEPTH;
+        token = strtok(NULL, " \n");
+        if ((token != NULL && parse_i64(token, &depth) < 0) || depth < 1) {
+            cibyl_write_log("bench: usage: bench draw [depth]\n");
+            return CIBYL_EABORT;
+        }
+        if (eng_await_isready(&engine.eng) != CIBYL_EOK)
+            return CIBYL_EABORT;
+        return engbench_draws(&engine.eng, depth);
+    } else if (token != NULL && strcmp(token, "eval") == 0) {
+        token = strtok(NULL, " \n");
+        if ((token != NULL && parse_i64(token, &iterations) < 0) || iterations < 1) {
+            cibyl_write_log("bench: usage: bench [counters] eval [iterations]\n");
+            return CIBYL_EABORT;
+        }
+        if (eng_await_isready(&engine.eng) != CIBYL_EOK)
+            return CIBYL_EABORT;
+        return engbench_eval(&engine.eng, iterations);
+    } else if (token != NULL && strcmp(token, "prune") == 0) {
+        prune = true;
+        token = strtok(NULL, " \n");
+    } else if (token != NULL && strcmp(token, "movegen") == 0) {
+        movegen = true;
+        token = strtok(NULL, " \n");
+    } else if (token != NULL && (strcmp(token, "smp") == 0 || strcmp(token, "ybwc") == 0)) {
+        ybwc = strcmp(token, "ybwc") == 0;
+        token = strtok(NULL, " \n");
+    }
+    if (token != NULL && parse_i64(token, &depth) < 0)
+        return CIBYL_EABORT;
+    if ((token = strtok(NULL, " \n")) != NULL && parse_i64(token, &threads) < 0)
+        return CIBYL_EABORT;
+    if (depth < 1 || threads < 1) {
+        cibyl_write_log("bench: usage: bench [counters] [smp|ybwc] [depth] [threads], "
+                        "bench [counters] prune [depth], bench [counters] movegen [depth]\n");
+        return CIBYL_EABORT;
+    }
+
+    if (eng_await_isready(&engine.eng) != CIBYL_EOK)
+        return CIBYL_EABORT;
+    if (prune)
+        return engbench_pruning(&engine.eng, depth);
+    if (movegen)
+        return engbench_movegen(&engine.eng, depth);
+    return engbench_threads(&engine.eng, depth, threads, ybwc);
+}
+
+cibyl_errno_t handle_setoption(char *opts)
+{
+    char *name;
+    char *value;
+
+    /* The name may hold spaces, so split on the value keyword. */
+    if (opts == NULL || strncmp(opts, "name ", 5) != 0) {
+        cibyl_write_log("setoption: expected name\n");
+        return CIBYL_EABORT;
+    }
+    name = opts + 5;
+    if ((value = strstr(name, " value ")) != NULL) {
+        *value = '\0';
+        value += 7;
+    }
+
+    return eng_set_option(&engine.eng, name, value);
+}
+
 cibyl_errno_t handle_cmd(char *cmd)
 {
     cibyl_errno_t result = CIBYL_EOK;
 
     char *token = strtok(cmd, " \n");
-    char *opts;
     bool token_accepted = false;
 
-    while (token_accepted && token != NULL) {
+    while (!token_accepted && token != NULL) {
         token_accepted = true;
 
         /* Initialization commands. */
-        if (strcmp(cmd, STR_UCI) == 0) {
-            /* Respond to the UCI command. */
-            printf("id name %s\n", ENGINE_NAME);
-            printf("id author %s\n", ENGINE_AUTHOR);
-            printf("uciok\n");
-
-            /* Begin asynchronous initialization. */
-            eng_begin_init(&engine.eng);
-        } else if (strcmp(cmd, STR_DEBUG) == 0) {
-            engine.debug = true;
-        } else if (strcmp(cmd, STR_ISREADY) == 0) {
+        if (strcmp(token, STR_UCI) == 0) {
+            /* Respond to the UCI command. Initialization was begun by uci_init. */
+            handle_uci();
+        } else if (strcmp(token, STR_DEBUG) == 0) {
+            token = strtok(NULL, " \n");
+            engine.debug = token == NULL || strcmp(token, "off") != 0;
+        } else if (strcmp(token, STR_ISREADY) == 0) {
             /* Wait for initialization to be complete. */
             eng_await_isready(&engine.eng);
             printf("readyok\n");
-        } else if (strcmp(cmd, STR_SETOPTION) == 0) {
-            /* TODO: Implement me. */
-        } else if (strcmp(cmd, STR_REGISTER) == 0) {
+        } else if (strcmp(token, STR_SETOPTION) == 0) {
+            result = handle_setoption(strtok(NULL, "\n"));
+        } else if (strcmp(token, STR_REGISTER) == 0) {
             /* Do nothing as this is not password protected. */
         }
 
         /* Board setup commands. */
-        else if (strcmp(cmd, STR_UCINEWGAME) == 0) {
-            /* TODO: Implement me. */
-            eng_set_ucifen(&engine.eng, "startpos");
-        } else if (strcmp(cmd, STR_POSITION) == 0) {
-            eng_set_ucifen(&engine.eng, strtok(cmd, "\n"));
+        else if (strcmp(token, STR_UCINEWGAME) == 0) {
+            eng_newgame(&engine.eng);
+            result = eng_set_ucifen(&engine.eng, "startpos");
+        } else if (strcmp(token, STR_POSITION) == 0) {
+            if ((token = strtok(NULL, "\n")) != NULL)
+                result = eng_set_ucifen(&engine.eng, token);
         }
 
         /* Functions for controlling thinking. */
-        else if (strcmp(cmd, STR_GO) == 0) {
-            result = handle_go(strtok(NULL, ""));   /* Slice off the rest of the cmd. */
-        } else if (strcmp(cmd, STR_STOP) == 0) {
+        else if (strcmp(token, STR_GO) == 0) {
+            result = handle_go(strtok(NULL, "\n"));   /* Slice off the rest of the cmd. */
+        } else if (strcmp(token, STR_STOP) == 0) {
             eng_notify_stop(&engine.eng);
-        } else if (strcmp(cmd, STR_PONDERHIT) == 0) {
+        } else if (strcmp(token, STR_PONDERHIT) == 0) {
             eng_notify_ponderhit(&engine.eng);
         }
 
         /* Miscelaneous functions. */
-        else if (strcmp(cmd, STR_QUIT) == 0) {
-            eng_cleanup(&engine.eng);
-        } else if (strcmp(cmd, STR_DISPLAY) == 0) {
+        else if (strcmp(token, STR_QUIT) == 0) {
+            engine.quit = true;
+        } else if (strcmp(token, STR_DISPLAY) == 0) {
             /* TODO: Implement me. */
+        } else if (strcmp(token, STR_BENCH) == 0) {
+            result = handle_bench();
         }
 
         /* If the first word is invalid, then parse starting with the next as per the spec. */
         else {
-            token = strtok(NULL, " ");
+            token = strtok(NULL, " \n");
             token_accepted = false;
         }
     }
@@ -228,13 +339,53 @@ cibyl_errno_t handle_cmd(char *cmd)
     return result;
 }
 
+/**
+ * @breif Copies every message of the engine to stdout until the engine closes the pipe.
+ */
+int msg_entry(void *engine_addr)
+{
+    uci_engine_t *engine = (uci_engine_t *)engine_addr;
+    char buf[ENG_MSG_LEN];
+    ssize_t len;
+
+    while ((len = read(engine->eng.msg_pipe[0], buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, len, stdout);
+        fflush(stdout);
+    }
+
+    return CIBYL_EOK;
+}
+
 cibyl_errno_t uci_init(uci_engine_t *engine)
 {
-    /* TODO: Implement me. */
+    cibyl_errno_t result;
+
+    engine->debug = false;
+    engine->quit = false;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    /* Initialization runs in the background until the first command that needs it. */
+    if ((result = eng_begin_init(&engine->eng)) != CIBYL_EOK)
+        return result;
+    if (thrd_create(&engine->mgr, msg_entry, engine) != thrd_success) {
+        cibyl_write_log("uci_init: failed to spawn the message thread\n");
+        return CIBYL_EABORT;
+    }
+
+    return CIBYL_EOK;
 }
 
 cibyl_errno_t uci_process(uci_engine_t *engine)
 {
-    /* TODO: Implement me. */
-}
+    char line[UCI_LINE_LEN];
+    cibyl_errno_t result;
 
+    while (!engine->quit && fgets(line, sizeof(line), stdin) != NULL)
+        handle_cmd(line);
+
+    /* Stop the engine and let the message thread drain what is left of the pipe. */
+    result = eng_cleanup(&engine->eng);
+    thrd_join(engine->mgr, NULL);
+    close(engine->eng.msg_pipe[0]);
+    return result;
+}
@@ -4,15 +4,23 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "cb_lib.h"
 #include "cb_dbg.h"
+#include "cb_zobrist.h"
 #include "perft.h"
+#include "epd.h"
+#include "uniq.h"
+#include "perfcnt.h"
 
 #define MAX_COMMAND_LEN 512
 #define DEFAULT_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 #define MODDED_FEN "rnbqkbnr/pppppppp/p7/1p6/2p5/3p4/PPPPpPPP/RNBQKpNR w KQkq - 0 1"
 
+/* Set by the perfcnt command. Wraps every perft in hardware performance counters. */
+bool perfcnt_enabled = false;
+
 int handle_position(cb_board_t *board)
 {
     /* Slice the next word off the command. */
@@ -111,7 +119,7 @@ int handle_debug(cb_board_t *board)
     /* Error handling. */
     if (token == NULL) {
         printf("Invalid move command. Usage:\n"
-               "dbg <state/board/moves>\n");
+               "dbg <state/board/moves/key>\n");
         return 1;
     }
 
@@ -124,6 +132,9 @@ int handle_debug(cb_board_t *board)
         cb_print_bitboard(stdout, board);
     else if (strcmp(token, "moves") == 0)
         cb_print_moves(stdout, &mvlst);
+    else if (strcmp(token, "key") == 0)
+        printf("key: %016" PRIx64 " scratch: %016" PRIx64 "\n", cb_board_key(board),
+               cb_hash_board(board));
     else 
         printf("Invalid command\n");
     
@@ -136,12 +147,15 @@ int handle_board(cb_board_t *board)
     return 0;
 }
 
-int handle_perft(cb_board_t *board)
+int handle_perft(cb_board_t *board, int (*run)(cb_board_t *, int, uint64_t *))
 {
     /* Slice off the algebraic part of the move. */
     char *token = strtok(NULL, " \n");
     char *endptr;
     int depth;
+    int result;
+    uint64_t nodes = 0;
+    perfcnt_t pc;
 
     /* Verify the command. */
     if (token == NULL) {
@@ -156,7 +170,72 @@ int handle_perft(cb_board_t *board)
         printf("Depth must be a base 10 integer");
     }
 
-    return perft_cheat(board, depth);
+    if (!perfcnt_enabled)
+        return run(board, depth, &nodes);
+
+    /* Run the perft inside of the hardware counters. */
+    if (perfcnt_open(&pc) == 0)
+        printf("No hardware performance counters are available\n");
+    perfcnt_start(&pc);
+    result = run(board, depth, &nodes);
+    perfcnt_stop(&pc);
+    perfcnt_print(stdout, &pc, nodes);
+    perfcnt_close(&pc);
+    printf("\n");
+
+    return result;
+}
+
+int handle_perfcnt(cb_board_t *board)
+{
+    /* Slice off the on/off switch. */
+    char *token = strtok(NULL, " \n");
+
+    (void)board;
+
+    if (token != NULL && strcmp(token, "on") == 0) {
+        perfcnt_enabled = true;
+    } else if (token != NULL && strcmp(token, "off") == 0) {
+        perfcnt_enabled = false;
+    } else {
+        printf("Invalid perfcnt command. Usage:\n"
+               "perfcnt <on/off>\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int handle_epd(cb_board_t *board)
+{
+    /* Slice off the path and the optional thread count and depth limit. */
+    char *path = strtok(NULL, " \n");
+    char *threads = strtok(NULL, " \n");
+    char *depth = strtok(NULL, " \n");
+
+    (void)board;
+    if (path == NULL) {
+        printf("Invalid epd command. Usage:\n"
+               "epd <file> [threads] [max_depth]\n");
+        return 1;
+    }
+
+    return epd_perft(path, threads ? atoi(threads) : 0, depth ? atoi(depth) : 0) != 0;
+}
+
+int handle_uniq(cb_board_t *board)
+{
+    /* Slice off the depth and the optional memory limit. */
+    char *depth = strtok(NULL, " \n");
+    char *mem = strtok(NULL, " \n");
+
+    if (depth == NULL) {
+        printf("Invalid uniq command. Usage:\n"
+               "go uniq <depth> [mem_mb]\n");
+        return 1;
+    }
+
+    return uniq_count(board, atoi(depth), mem ? strtoul(mem, NULL, 10) : UNIQ_DEFAULT_MB);
 }
 
 int handle_go(cb_board_t *board)
@@ -165,7 +244,15 @@ int handle_go(cb_board_t *board)
     char *token = strtok(NULL, " \n");
 
     if (strcmp(token, "perft") == 0)
-        return handle_perft(board);
+        return handle_perft(board, perft_cheat);
+    if (strcmp(token, "perftstats") == 0)
+        return handle_perft(board, perft_stats);
+    if (strcmp(token, "perftpseudo") == 0)
+        return handle_perft(board, perft_pseudo);
+    if (strcmp(token, "perftnoisy") == 0)
+        return handle_perft(board, perft_noisy);
+    if (strcmp(token, "uniq") == 0)
+        return handle_uniq(board);
     
     printf("Invalid go command\n");
     return 0;
@@ -189,6 +276,10 @@ int parse_input(char *command, cb_board_t *board)
         return handle_board(board);
     if (strcmp(token, "go") == 0)
         return handle_go(board);
+    if (strcmp(token, "perfcnt") == 0)
+        return handle_perfcnt(board);
+    if (strcmp(token, "epd") == 0)
+        return handle_epd(board);
     if (strcmp(token, "quit") == 0)
         return -1;
     
@@ -0,0 +1,258 @@
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "epd.h"
+#include "perft.h"
+#include "crosstime.h"
+#include "cb_lib.h"
+
+/**
+ * @breif State shared between the workers of one EPD run.
+ */
+typedef struct {
+    epd_entry_t *entries;   /**< The parsed suite. */
+    size_t num_entries;     /**< The number of entries in the suite. */
+    atomic_size_t next;     /**< The index of the next entry that has not been claimed. */
+    int max_depth;          /**< The deepest depth to verify. */
+} epd_pool_t;
+
+/**
+ * Parses one EPD line. Returns 1 for lines that hold no position, 0 on success and -1 on a
+ * malformed line. A count with no digits or with anything but spaces after it is malformed.
+ */
+int parse_epd_line(epd_entry_t *entry, char *line)
+{
+    char *field;
+    char *save;
+    char *endp;
+    long depth;
+    size_t len;
+
+    /* Skip blank lines and comments. */
+    line += strspn(line, " \t");
+    if (*line == '\0' || *line == '\n' || *line == '#')
+        return 1;
+
+    /* The fen runs up to the first field separator. */
+    memset(entry, 0, sizeof(*entry));
+    len = strcspn(line, ";\n");
+    while (len > 0 && line[len - 1] == ' ')
+        len--;
+    if (len == 0 || len >= EPD_FEN_LEN)
+        return -1;
+    memcpy(entry->fen, line, len);
+
+    /* Parse the ";D<depth> <nodes>" fields. Any other operations are ignored. */
+    for (field = strtok_r(line + strcspn(line, ";"), ";\n", &save); field != NULL;
+         field = strtok_r(NULL, ";\n", &save)) {
+        field += strspn(field, " \t");
+        if (field[0] != 'D')
+            continue;
+        errno = 0;
+        depth = strtol(field + 1, &endp, 10);
+        if (errno || endp == field + 1 || depth < 1 || depth > EPD_MAX_DEPTH)
+            return -1;
+        field = endp + strspn(endp, " \t");
+        if (*field < '0' || *field > '9')
+            return -1;
+        entry->expected[depth - 1] = strtoull(field, &endp, 10);
+        if (errno || endp[strspn(endp, " \t\r")] != '\0')
+            return -1;
+        entry->has_expected[depth - 1] = true;
+        entry->max_depth = depth > entry->max_depth ? depth : entry->max_depth;
+    }
+
+    return entry->max_depth > 0 ? 0 : -1;
+}
+
+/**
+ * Reads every position of an EPD file. Malformed lines are reported, counted in *malformed
+ * and skipped.
+ */
+int load_epd(epd_entry_t **entries, size_t *num_entries, int *malformed, const char *path)
+{
+    FILE *f;
+    char *line = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    int line_num = 0;
+    int result = 0;
+    epd_entry_t *new_entries;
+
+    *entries = NULL;
+    *num_entries = 0;
+    *malformed = 0;
+    if ((f = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "fopen: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (getline(&line, &len, f) >= 0) {
+        line_num++;
+        if (*num_entries == cap) {
+            cap = cap == 0 ? 256 : cap * 2;
+            if ((new_entries = realloc(*entries, cap * sizeof(epd_entry_t))) == NULL) {
+                fprintf(stderr, "realloc: %s\n", strerror(errno));
+                result = -1;
+                break;
+            }
+            *entries = new_entries;
+        }
+
+        switch (parse_epd_line(&(*entries)[*num_entries], line)) {
+            case 0:
+                (*entries)[(*num_entries)++].line = line_num;
+                break;
+            case 1:
+                break;
+            default:
+                printf("MALFORMED line %d\n", line_num);
+                fprintf(stderr, "%s:%d: malformed EPD line\n", path, line_num);
+                (*malformed)++;
+                break;
+        }
+    }
+
+    free(line);
+    fclose(f);
+    return result;
+}
+
+void run_entry(cb_board_t *board, epd_entry_t *entry, int max_depth)
+{
+    cb_error_t err;
+    char fen[EPD_FEN_LEN];
+    uint64_t start_time;
+    int depth;
+
+    for (depth = 1; depth <= entry->max_depth && depth <= max_depth; depth++) {
+        if (!entry->has_expected[depth - 1])
+            continue;
+
+        /* The fen parser modifies its input so hand it a fresh copy for every depth. */
+        memcpy(fen, entry->fen, EPD_FEN_LEN);
+        if (cb_board_from_fen(&err, board, fen) != 0
+                || cb_reserve_for_make(&err, board, depth) != 0) {
+            fprintf(stderr, "line %d: %s\n", entry->line, err.desc);
+            entry->error = true;
+            return;
+        }
+
+        start_time = time_ns();
+        entry->nodes[depth - 1] = perft_count(board, depth);
+        entry->time_ns[depth - 1] = time_ns() - start_time;
+    }
+}
+
+int epd_worker(void *pool_addr)
+{
+    epd_pool_t *pool = (epd_pool_t *)pool_addr;
+    cb_board_t board;
+    cb_error_t err;
+    size_t idx;
+
+    if (cb_board_init(&err, &board) != 0) {
+        fprintf(stderr, "cb_board_init: %s\n", err.desc);
+        return -1;
+    }
+
+    /* Claim entries until there are none left. */
+    while ((idx = atomic_fetch_add(&pool->next, 1)) < pool->num_entries)
+        run_entry(&board, &pool->entries[idx], pool->max_depth);
+
+    cb_board_free(&board);
+    return 0;
+}
+
+int epd_perft(const char *path, int num_threads, int max_depth)
+{
+    epd_pool_t pool;
+    thrd_t *threads;
+    epd_entry_t *entry;
+    uint64_t start_time, wall_ns;
+    uint64_t total_nodes = 0;
+    uint64_t total_ns = 0;
+    int failures = 0;
+    int malformed = 0;
+    int errors = 0;
+    int result;
+    int spawned;
+    size_t i;
+    int d;
+
+    if (load_epd(&pool.entries, &pool.num_entries, &malformed, path) != 0) {
+        free(pool.entries);
+        return -1;
+    }
+    if (num_threads <= 0)
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    pool.max_depth = max_depth > 0 ? max_depth : EPD_MAX_DEPTH;
+    atomic_init(&pool.next, 0);
+
+    if ((threads = malloc(num_threads * sizeof(thrd_t))) == NULL) {
+        fprintf(stderr, "malloc: %s\n", strerror(errno));
+        free(pool.entries);
+        return -1;
+    }
+
+    /* Spawn the workers and wait for them to drain the suite. */
+    printf("Running %zu positions on %d threads\n", pool.num_entries, num_threads);
+    start_time = time_ns();
+    for (spawned = 0; spawned < num_threads; spawned++) {
+        if (thrd_create(&threads[spawned], epd_worker, &pool) != thrd_success) {
+            fprintf(stderr, "thrd_create: failed to spawn worker %d\n", spawned);
+            break;
+        }
+    }
+    if (spawned == 0)
+        epd_worker(&pool);
+    for (d = 0; d < spawned; d++)
+        thrd_join(threads[d], &result);
+    wall_ns = time_ns() - start_time;
+
+    /* Summarize the failures. */
+    for (i = 0; i < pool.num_entries; i++) {
+        entry = &pool.entries[i];
+        if (entry->error) {
+            printf("ERROR line %d: %s\n", entry->line, entry->fen);
+            errors++;
+            continue;
+        }
+        for (d = 0; d < entry->max_depth && d < pool.max_depth; d++) {
+            if (!entry->has_expected[d])
+                continue;
+            total_nodes += entry->nodes[d];
+            total_ns += entry->time_ns[d];
+            if (entry->nodes[d] == entry->expected[d])
+                continue;
+            printf("FAIL line %d depth %d: expected %" PRIu64 " got %" PRIu64 ": %s\n",
+                   entry->line, d + 1, entry->expected[d], entry->nodes[d], entry->fen);
+            failures++;
+        }
+    }
+
+    printf("\n");
+    printf("Positions: %zu\n", pool.num_entries);
+    printf("Malformed: %d\n", malformed);
+    printf("Failures: %d\n", failures + malformed);
+    printf("Errors: %d\n", errors);
+    printf("Nodes searched: %" PRIu64 "\n", total_nodes);
+    printf("Time: %" PRIu64 "ms\n", wall_ns / 1000000);
+    printf("Aggregate NPS: %" PRIu64 "\n",
+           wall_ns == 0 ? 0 : (uint64_t)(total_nodes * 1.0e9 / wall_ns));
+    printf("Per-thread NPS: %" PRIu64 "\n",
+           total_ns == 0 ? 0 : (uint64_t)(total_nodes * 1.0e9 / total_ns));
+    printf("\n");
+
+    free(threads);
+    free(pool.entries);
+    return errors ? -1 : failures + malformed != 0;
+}
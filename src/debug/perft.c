@@ -1,10 +1,16 @@
 
 #include <time.h>
+#include <string.h>
+#include <stdlib.h>
 
 #include "perft.h"
 #include "crosstime.h"
 #include "cb_lib.h"
 #include "cb_move.h"
+#include "cb_board.h"
+#include "cb_tables.h"
+#include "cb_bitutil.h"
+#include "cb_visit.h"
 #include <inttypes.h>
 
 uint64_t perfting(cb_board_t *board, cb_state_tables_t *state, int depth)
@@ -39,39 +45,101 @@ uint64_t perfting(cb_board_t *board, cb_state_tables_t *state, int depth)
     return cnt;
 }
 
-uint64_t perft_cheating(cb_board_t *board, cb_state_tables_t *state, int depth)
+/**
+ * What the bulk counting perft visitors need to walk one level of the tree.
+ */
+typedef struct {
+    cb_board_t *board;  /**< The board the moves are made on. */
+    int depth;          /**< The depth left below the moves being visited. */
+    uint64_t cnt;       /**< The leaf nodes counted so far. */
+} perft_ctx_t;
+
+uint64_t perft_cheating(cb_board_t *board, int depth);
+
+static bool count_visitor(void *ctx, cb_move_t mv)
+{
+    (void)mv;
+    ((perft_ctx_t *)ctx)->cnt++;
+    return false;
+}
+
+static bool descend_visitor(void *ctx, cb_move_t mv)
+{
+    perft_ctx_t *pctx = ctx;
+
+    /* This function can fail, but only when a reservation is needed.
+     * As perft does a manual reservation, there is no need to reserve here and no error. */
+    cb_make(pctx->board, mv);
+    pctx->cnt += perft_cheating(pctx->board, pctx->depth);
+    cb_unmake(pctx->board);
+    return false;
+}
+
+uint64_t perft_cheating(cb_board_t *board, int depth)
+{
+    cb_state_tables_t state;
+    perft_ctx_t ctx = { .board = board, .depth = depth - 1, .cnt = 0 };
+
+    /* The moves are made while the generator is still running, so every level keeps its own
+     * state tables. */
+    cb_gen_board_tables(&state, board);
+
+    /* Base case. */
+    if (depth <= 1)
+        cb_visit_moves(board, &state, count_visitor, &ctx);
+    else
+        cb_visit_moves(board, &state, descend_visitor, &ctx);
+
+    return ctx.cnt;
+}
+
+uint64_t perft_pseudoing(cb_board_t *board, int depth)
 {
     uint64_t cnt = 0;
     int i;
     cb_move_t mv;
     cb_mvlst_t mvlst;
+    cb_pseudo_tables_t pstate;
 
-    /* Generate the moves. */
-    cb_gen_board_tables(state, board);
-    cb_gen_moves(&mvlst, board, state);
-
-    /* Base case. */
-    if (depth <= 1)
-        return cb_mvlst_size(&mvlst);
+    /* Generate the moves. Legality is only tested once a move is about to be used. */
+    cb_gen_pseudo_tables(&pstate, board);
+    cb_gen_pseudo_moves(&mvlst, board, &pstate);
 
-    /* Make moves and move down the tree. */
     for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
         mv = cb_mvlst_at(&mvlst, i);
-        /* This function can fail, but only when a reservation is needed.
-         * As perft does a manual reservation, there is no need to reserve here and no error. */
-        cb_make(board, mv);
+        if (!cb_is_legal(board, &pstate, mv))
+            continue;
 
-        /*cb_print_bitboard(stdout, board);
-        cb_print_mv_hist(stdout, board);*/
+        /* Base case. */
+        if (depth <= 1) {
+            cnt++;
+            continue;
+        }
 
-        cnt += perft_cheating(board, state, depth - 1);
+        cb_make(board, mv);
+        cnt += perft_pseudoing(board, depth - 1);
         cb_unmake(board);
     }
 
     return cnt;
 }
 
-int perft(cb_board_t *board, int depth)
+uint64_t perft_count_pseudo(cb_board_t *board, int depth)
+{
+    if (depth < 1)
+        return 1;
+    return perft_pseudoing(board, depth);
+}
+
+uint64_t perft_count(cb_board_t *board, int depth)
+{
+    /* The bulk counting perft only works for depths of at least one. */
+    if (depth < 1)
+        return 1;
+    return perft_cheating(board, depth);
+}
+
+int perft(cb_board_t *board, int depth, uint64_t *nodes)
 {
     cb_errno_t result;
     cb_error_t err;
@@ -114,6 +182,7 @@ int perft(cb_board_t *board, int depth)
         cb_unmake(board);
     }
     end_time = time_ns();
+    *nodes = total;
     printf("\n");
     printf("Nodes searched: %" PRIu64 "\n", total);
     printf("Time: %.3fms\n", (end_time - start_time) / 1000000.0);
@@ -122,7 +191,7 @@ int perft(cb_board_t *board, int depth)
     return 0;
 }
 
-int perft_cheat(cb_board_t *board, int depth)
+int perft_cheat(cb_board_t *board, int depth, uint64_t *nodes)
 {
     cb_errno_t result;
     cb_error_t err;
@@ -158,13 +227,67 @@ int perft_cheat(cb_board_t *board, int depth)
     for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
         mv = cb_mvlst_at(&mvlst, i);
         cb_make(board, mv);
-        cnt = perft_cheating(board, &state, depth - 1);
+        cnt = perft_count(board, depth - 1);
+        total += cnt;
+        cb_mv_to_uci_algbr(buf, mv);
+        printf("%s: %" PRIu64 "\n", buf, cnt);
+        cb_unmake(board);
+    }
+    end_time = time_ns();
+    *nodes = total;
+    printf("\n");
+    printf("Nodes searched: %" PRIu64 "\n", total);
+    printf("Time: %" PRIu64 "ms\n", (end_time - start_time) / 1000000);
+    printf("\n");
+
+    return 0;
+}
+
+int perft_pseudo(cb_board_t *board, int depth, uint64_t *nodes)
+{
+    cb_errno_t result;
+    cb_error_t err;
+    cb_mvlst_t mvlst;
+    cb_move_t mv;
+    cb_pseudo_tables_t pstate;
+    uint64_t cnt = 0;
+    uint64_t total = 0;
+    char buf[6];
+    int i;
+
+    uint64_t start_time;
+    uint64_t end_time;
+
+    /* Exit early if depth is less than 1. */
+    if (depth < 1) {
+        printf("No pseudo-legal perft with a depth below 1\n");
+        return 0;
+    }
+
+    /* Reserve the board history. This line guarantees that make will never write
+     * past its proper bounds. */
+    if ((result = cb_reserve_for_make(&err, board, depth)) != 0) {
+        fprintf(stderr, "cb_reserve_for_make: %s\n", err.desc);
+        return result;
+    }
+
+    /* Loop through all of the first levels and calculate the number of moves. */
+    start_time = time_ns();
+    cb_gen_pseudo_tables(&pstate, board);
+    cb_gen_pseudo_moves(&mvlst, board, &pstate);
+    for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
+        mv = cb_mvlst_at(&mvlst, i);
+        if (!cb_is_legal(board, &pstate, mv))
+            continue;
+        cb_make(board, mv);
+        cnt = perft_count_pseudo(board, depth - 1);
         total += cnt;
         cb_mv_to_uci_algbr(buf, mv);
         printf("%s: %" PRIu64 "\n", buf, cnt);
         cb_unmake(board);
     }
     end_time = time_ns();
+    *nodes = total;
     printf("\n");
     printf("Nodes searched: %" PRIu64 "\n", total);
     printf("Time: %" PRIu64 "ms\n", (end_time - start_time) / 1000000);
@@ -172,3 +295,292 @@ int perft_cheat(cb_board_t *board, int depth)
 
     return 0;
 }
+
+/**
+ * @breif Running totals of a cb_gen_noisy_and_checks verification.
+ */
+typedef struct {
+    uint64_t nodes;         /**< Positions checked. */
+    uint64_t noisy;         /**< Captures and promotions emitted. */
+    uint64_t checks;        /**< Quiet checks emitted. */
+    uint64_t mismatches;    /**< Positions where the generator and the filter disagreed. */
+    int root;               /**< History count at the root, for printing the line. */
+} noisy_check_t;
+
+static int cmp_move(const void *a, const void *b)
+{
+    return (int)*(const cb_move_t *)a - (int)*(const cb_move_t *)b;
+}
+
+/**
+ * Sorts both lists and returns true if they hold the same moves.
+ */
+static bool same_moves(cb_mvlst_t *a, cb_mvlst_t *b)
+{
+    if (cb_mvlst_size(a) != cb_mvlst_size(b))
+        return false;
+    qsort(a->moves, cb_mvlst_size(a), sizeof(cb_move_t), cmp_move);
+    qsort(b->moves, cb_mvlst_size(b), sizeof(cb_move_t), cmp_move);
+    return memcmp(a->moves, b->moves, cb_mvlst_size(a) * sizeof(cb_move_t)) == 0;
+}
+
+/**
+ * Builds the expected output of cb_gen_noisy_and_checks from the full move list. Checks are
+ * found by making each quiet move.
+ */
+static void filter_noisy(cb_mvlst_t *out, cb_board_t *board, cb_mvlst_t *all, bool quiet_checks)
+{
+    cb_state_tables_t state;
+    cb_move_t mv;
+    int i;
+
+    cb_mvlst_clear(out);
+    for (i = 0; i < cb_mvlst_size(all); i++) {
+        mv = cb_mvlst_at(all, i);
+        if (cb_mv_get_flags(mv) & (CB_MV_CAPTURE | CB_MV_KNIGHT_PROMO)) {
+            cb_mvlst_push(out, mv);
+            continue;
+        }
+        if (!quiet_checks)
+            continue;
+        cb_make(board, mv);
+        cb_gen_board_tables(&state, board);
+        cb_unmake(board);
+        if (state.checks)
+            cb_mvlst_push(out, mv);
+    }
+}
+
+static void report_noisy_mismatch(cb_board_t *board, noisy_check_t *res, bool quiet_checks)
+{
+    char buf[6];
+    int i;
+
+    printf("Mismatch (%s) after:", quiet_checks ? "with checks" : "without checks");
+    for (i = res->root; i < board->hist.count; i++) {
+        cb_mv_to_uci_algbr(buf, board->hist.data[i].move);
+        printf(" %s", buf);
+    }
+    printf("\n");
+}
+
+void perft_noisying(cb_board_t *board, noisy_check_t *res, int depth)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t all, expected, actual;
+    bool mismatch = false;
+    int i;
+
+    cb_gen_board_tables(&state, board);
+    cb_gen_moves(&all, board, &state);
+    res->nodes++;
+
+    /* Verify both flavors of the generator against the filtered full list. */
+    filter_noisy(&expected, board, &all, false);
+    cb_gen_noisy_and_checks(&actual, board, &state, false);
+    if (!same_moves(&expected, &actual)) {
+        report_noisy_mismatch(board, res, false);
+        mismatch = true;
+    }
+    res->noisy += cb_mvlst_size(&actual);
+
+    filter_noisy(&expected, board, &all, true);
+    cb_gen_noisy_and_checks(&actual, board, &state, true);
+    if (!same_moves(&expected, &actual)) {
+        report_noisy_mismatch(board, res, true);
+        mismatch = true;
+    }
+    res->checks += cb_mvlst_size(&actual);
+    res->mismatches += mismatch;
+
+    /* Base case. */
+    if (depth <= 1)
+        return;
+
+    for (i = 0; i < cb_mvlst_size(&all); i++) {
+        cb_make(board, cb_mvlst_at(&all, i));
+        perft_noisying(board, res, depth - 1);
+        cb_unmake(board);
+    }
+}
+
+int perft_noisy(cb_board_t *board, int depth, uint64_t *nodes)
+{
+    cb_errno_t result;
+    cb_error_t err;
+    noisy_check_t res = { 0 };
+    uint64_t start_time;
+    uint64_t end_time;
+
+    /* Exit early if depth is less than 1. */
+    if (depth < 1) {
+        printf("No noisy move verification with a depth below 1\n");
+        return 0;
+    }
+
+    /* Reserve the board history. One extra slot is needed for the check filter. */
+    if ((result = cb_reserve_for_make(&err, board, depth + 1)) != 0) {
+        fprintf(stderr, "cb_reserve_for_make: %s\n", err.desc);
+        return result;
+    }
+
+    start_time = time_ns();
+    res.root = board->hist.count;
+    perft_noisying(board, &res, depth);
+    end_time = time_ns();
+    *nodes = res.nodes;
+
+    /* The quiet checks are the difference between the two flavors. */
+    printf("Positions checked: %" PRIu64 "\n", res.nodes);
+    printf("Captures and promotions: %" PRIu64 "\n", res.noisy);
+    printf("Quiet checks: %" PRIu64 "\n", res.checks - res.noisy);
+    printf("Mismatches: %" PRIu64 "\n", res.mismatches);
+    printf("Time: %" PRIu64 "ms\n", (end_time - start_time) / 1000000);
+    printf("\n");
+
+    return res.mismatches != 0;
+}
+
+/**
+ * Returns true if the move might give check. This is exact for quiet moves, double pushes and
+ * plain captures. Castles, enpassant and promotions change more than one square of the occupancy
+ * so they are always reported as candidates and resolved by making the move.
+ */
+static inline bool may_give_check(cb_board_t *board, cb_check_info_t *info, cb_move_t mv)
+{
+    uint8_t from = cb_mv_get_from(mv);
+    uint8_t to = cb_mv_get_to(mv);
+    uint16_t flag = cb_mv_get_flags(mv);
+
+    if (flag != CB_MV_QUIET && flag != CB_MV_DOUBLE_PAWN_PUSH && flag != CB_MV_CAPTURE)
+        return true;
+    if (info->check_sqs[cb_ptype_at_sq(board, from)] & (UINT64_C(1) << to))
+        return true;
+    return (info->discoverers & (UINT64_C(1) << from))
+        && cb_get_ray_direction(info->king_sq, from) != cb_get_ray_direction(info->king_sq, to);
+}
+
+/**
+ * Makes a checking move candidate and classifies the check it gives, if any.
+ */
+static void tally_check(cb_board_t *board, perft_stats_t *stats, cb_move_t mv)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    uint16_t flag = cb_mv_get_flags(mv);
+    uint64_t moved = UINT64_C(1) << cb_mv_get_to(mv);
+
+    /* The rook is the piece that moved into place when castling. */
+    if (flag == CB_MV_KING_SIDE_CASTLE)
+        moved |= UINT64_C(1) << (board->turn ? M_WHITE_KING_SIDE_ROOK_TARGET :
+                M_BLACK_KING_SIDE_ROOK_TARGET);
+    else if (flag == CB_MV_QUEEN_SIDE_CASTLE)
+        moved |= UINT64_C(1) << (board->turn ? M_WHITE_QUEEN_SIDE_ROOK_TARGET :
+                M_BLACK_QUEEN_SIDE_ROOK_TARGET);
+
+    cb_make(board, mv);
+    cb_gen_board_tables(&state, board);
+    if (state.checks) {
+        stats->checks++;
+        if (popcnt(state.checks) > 1)
+            stats->double_checks++;
+        else if (state.checks & ~moved)
+            stats->disc_checks++;
+        cb_gen_moves(&mvlst, board, &state);
+        stats->mates += cb_mvlst_size(&mvlst) == 0;
+    }
+    cb_unmake(board);
+}
+
+/**
+ * Accumulates the statistics for all of the children of a node into stats.
+ */
+static inline void tally_moves(cb_board_t *board, cb_mvlst_t *mvlst, perft_stats_t *stats)
+{
+    cb_check_info_t info;
+    cb_move_t mv;
+    uint16_t flag;
+    int i;
+
+    cb_gen_check_info(&info, board);
+    stats->nodes += cb_mvlst_size(mvlst);
+    for (i = 0; i < cb_mvlst_size(mvlst); i++) {
+        mv = cb_mvlst_at(mvlst, i);
+        flag = cb_mv_get_flags(mv);
+        stats->captures += (flag & CB_MV_CAPTURE) != 0;
+        stats->enps += flag == CB_MV_ENPASSANT;
+        stats->castles += flag == CB_MV_KING_SIDE_CASTLE || flag == CB_MV_QUEEN_SIDE_CASTLE;
+        stats->promos += (flag & CB_MV_KNIGHT_PROMO) != 0;
+        if (may_give_check(board, &info, mv))
+            tally_check(board, stats, mv);
+    }
+}
+
+void perft_statsing(cb_board_t *board, perft_stats_t *stats, int depth)
+{
+    cb_state_tables_t state;
+    cb_mvlst_t mvlst;
+    int i;
+
+    /* Generate the moves and record the statistics for the next ply. */
+    cb_gen_board_tables(&state, board);
+    cb_gen_moves(&mvlst, board, &state);
+    tally_moves(board, &mvlst, stats);
+
+    /* Base case. */
+    if (depth <= 1)
+        return;
+
+    /* Make moves and move down the tree. */
+    for (i = 0; i < cb_mvlst_size(&mvlst); i++) {
+        cb_make(board, cb_mvlst_at(&mvlst, i));
+        perft_statsing(board, stats + 1, depth - 1);
+        cb_unmake(board);
+    }
+}
+
+int perft_stats(cb_board_t *board, int depth, uint64_t *nodes)
+{
+    cb_errno_t result;
+    cb_error_t err;
+    perft_stats_t stats[PERFT_STATS_MAX_DEPTH];
+    uint64_t start_time;
+    uint64_t end_time;
+    int i;
+
+    /* Exit early if depth is out of range. */
+    if (depth < 1 || depth > PERFT_STATS_MAX_DEPTH) {
+        printf("Perft stats depth must be between 1 and %d\n", PERFT_STATS_MAX_DEPTH);
+        return 0;
+    }
+
+    /* Reserve the board history. One extra slot is needed for the check classification. */
+    if ((result = cb_reserve_for_make(&err, board, depth + 1)) != 0) {
+        fprintf(stderr, "cb_reserve_for_make: %s\n", err.desc);
+        return result;
+    }
+
+    /* Walk the tree once, collecting every depth at the same time. */
+    memset(stats, 0, sizeof(stats));
+    start_time = time_ns();
+    perft_statsing(board, stats, depth);
+    end_time = time_ns();
+    *nodes = stats[depth - 1].nodes;
+
+    /* Print the results in the same layout as the standard perft tables. */
+    printf("%5s %14s %12s %8s %10s %10s %10s %8s %8s %10s\n", "Depth", "Nodes", "Captures",
+           "E.p.", "Castles", "Promotions", "Checks", "Disc", "Double", "Checkmates");
+    for (i = 0; i < depth; i++) {
+        printf("%5d %14" PRIu64 " %12" PRIu64 " %8" PRIu64 " %10" PRIu64 " %10" PRIu64
+               " %10" PRIu64 " %8" PRIu64 " %8" PRIu64 " %10" PRIu64 "\n", i + 1,
+               stats[i].nodes, stats[i].captures, stats[i].enps, stats[i].castles,
+               stats[i].promos, stats[i].checks, stats[i].disc_checks, stats[i].double_checks,
+               stats[i].mates);
+    }
+    printf("\n");
+    printf("Nodes searched: %" PRIu64 "\n", stats[depth - 1].nodes);
+    printf("Time: %" PRIu64 "ms\n", (end_time - start_time) / 1000000);
+    printf("\n");
+
+    return 0;
+}
@@ -0,0 +1,348 @@
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "uniq.h"
+#include "crosstime.h"
+#include "cb_lib.h"
+#include "cb_move.h"
+#include "cb_visit.h"
+#include "cb_zobrist.h"
+
+#define DEPTH_MASK UINT64_C(0xF)
+#define MIN_SLOTS 1024
+#define RUN_BUF_LEN 4096
+
+/**
+ * @breif A memory bounded set of keys that spills sorted runs to disk.
+ *
+ * Each entry is a zobrist key with its low four bits replaced by the depth it was reached at, so
+ * an entry is never zero and zero marks an empty slot.
+ */
+typedef struct {
+    uint64_t *slots;                            /**< Open addressed with linear probing. */
+    size_t mask;                                /**< The number of slots minus one. */
+    size_t count;                               /**< Entries currently in the slots. */
+    size_t limit;                               /**< Spill once count reaches this. */
+    FILE **runs;                                /**< Sorted runs on disk. */
+    size_t num_runs;                            /**< The number of runs. */
+    size_t runs_cap;                            /**< Allocated length of runs. */
+    uint64_t resident[UNIQ_MAX_DEPTH + 1];      /**< Entries per depth in the slots. */
+    uint64_t peak[UNIQ_MAX_DEPTH + 1];          /**< Most entries per depth ever resident. */
+    uint64_t spilled[UNIQ_MAX_DEPTH + 1];       /**< Entries per depth written to disk. */
+    bool failed;                                /**< Set when a spill could not be written. */
+} uniq_set_t;
+
+/**
+ * @breif What the walk needs at every level of the tree.
+ */
+typedef struct {
+    uniq_set_t *set;    /**< The set to insert the children into. */
+    cb_board_t *board;  /**< The board the moves are made on. */
+    int ply;            /**< The depth of the children. */
+    int depth;          /**< The deepest depth to walk to. */
+} uniq_ctx_t;
+
+/**
+ * @breif Reads one sorted run back in blocks.
+ */
+typedef struct {
+    FILE *f;                    /**< The run. */
+    uint64_t buf[RUN_BUF_LEN];  /**< The current block. */
+    size_t len;                 /**< Entries in the block. */
+    size_t pos;                 /**< The next entry of the block. */
+} run_reader_t;
+
+int uniq_set_init(uniq_set_t *set, size_t mem_mb)
+{
+    size_t slots = MIN_SLOTS;
+
+    /* Use the largest power of two that fits in the limit. */
+    while (slots * 2 * sizeof(uint64_t) <= mem_mb << 20)
+        slots *= 2;
+
+    memset(set, 0, sizeof(*set));
+    if ((set->slots = calloc(slots, sizeof(uint64_t))) == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    set->mask = slots - 1;
+    set->limit = slots / 4 * 3;
+    return 0;
+}
+
+void uniq_set_free(uniq_set_t *set)
+{
+    size_t i;
+
+    for (i = 0; i < set->num_runs; i++)
+        fclose(set->runs[i]);
+    free(set->runs);
+    free(set->slots);
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sorts the resident entries, writes them out as a new run and empties the slots.
+ */
+int uniq_spill(uniq_set_t *set)
+{
+    FILE **new_runs;
+    FILE *f;
+    size_t n = 0;
+    size_t i;
+
+    if (set->count == 0)
+        return 0;
+
+    /* Grow the list of runs. */
+    if (set->num_runs == set->runs_cap) {
+        set->runs_cap = set->runs_cap ? set->runs_cap * 2 : 8;
+        if ((new_runs = realloc(set->runs, set->runs_cap * sizeof(FILE *))) == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        set->runs = new_runs;
+    }
+
+    /* Pack the entries to the front of the slots and sort them there. */
+    for (i = 0; i <= set->mask; i++) {
+        if (set->slots[i] != 0)
+            set->slots[n++] = set->slots[i];
+    }
+    qsort(set->slots, n, sizeof(uint64_t), cmp_entry);
+
+    if ((f = tmpfile()) == NULL) {
+        perror("tmpfile");
+        return -1;
+    }
+    if (fwrite(set->slots, sizeof(uint64_t), n, f) != n) {
+        perror("fwrite");
+        fclose(f);
+        return -1;
+    }
+    set->runs[set->num_runs++] = f;
+
+    /* Move the resident counts over to the spilled counts. */
+    for (i = 0; i <= UNIQ_MAX_DEPTH; i++) {
+        set->spilled[i] += set->resident[i];
+        set->resident[i] = 0;
+    }
+    memset(set->slots, 0, (set->mask + 1) * sizeof(uint64_t));
+    set->count = 0;
+    return 0;
+}
+
+/**
+ * Returns 1 if the entry was added, 0 if it was already resident and -1 on errors.
+ */
+static inline int uniq_insert(uniq_set_t *set, uint64_t entry)
+{
+    size_t i = (entry >> 4) & set->mask;
+    uint8_t depth = entry & DEPTH_MASK;
+
+    while (set->slots[i] != 0) {
+        if (set->slots[i] == entry)
+            return 0;
+        i = (i + 1) & set->mask;
+    }
+
+    set->slots[i] = entry;
+    set->count++;
+    if (++set->resident[depth] > set->peak[depth])
+        set->peak[depth] = set->resident[depth];
+
+    if (set->count >= set->limit && uniq_spill(set) != 0)
+        return -1;
+    return 1;
+}
+
+void uniq_walk(uniq_set_t *set, cb_board_t *board, int ply, int depth);
+
+static bool uniq_visitor(void *ctx, cb_move_t mv)
+{
+    uniq_ctx_t *uctx = ctx;
+    int added;
+
+    cb_make(uctx->board, mv);
+    added = uniq_insert(uctx->set, (cb_board_key(uctx->board) & ~DEPTH_MASK) | uctx->ply);
+    if (added < 0)
+        uctx->set->failed = true;
+
+    /* A position that was already seen at this depth has had its subtree walked. */
+    if (added > 0 && uctx->ply < uctx->depth)
+        uniq_walk(uctx->set, uctx->board, uctx->ply + 1, uctx->depth);
+    cb_unmake(uctx->board);
+
+    return uctx->set->failed;
+}
+
+void uniq_walk(uniq_set_t *set, cb_board_t *board, int ply, int depth)
+{
+    cb_state_tables_t state;
+    uniq_ctx_t ctx = { .set = set, .board = board, .ply = ply, .depth = depth };
+
+    cb_gen_board_tables(&state, board);
+    cb_visit_moves(board, &state, uniq_visitor, &ctx);
+}
+
+static bool run_next(run_reader_t *r, uint64_t *entry)
+{
+    if (r->pos == r->len) {
+        r->len = fread(r->buf, sizeof(uint64_t), RUN_BUF_LEN, r->f);
+        r->pos = 0;
+        if (r->len == 0)
+            return false;
+    }
+    *entry = r->buf[r->pos++];
+    return true;
+}
+
+/**
+ * Restores the min-heap order of the run readers below slot i.
+ */
+static void sift_down(run_reader_t **heap, uint64_t *heads, size_t len, size_t i)
+{
+    run_reader_t *r = heap[i];
+    uint64_t head = heads[i];
+    size_t child;
+
+    while ((child = 2 * i + 1) < len) {
+        if (child + 1 < len && heads[child + 1] < heads[child])
+            child++;
+        if (head <= heads[child])
+            break;
+        heap[i] = heap[child];
+        heads[i] = heads[child];
+        i = child;
+    }
+    heap[i] = r;
+    heads[i] = head;
+}
+
+/**
+ * Merges the sorted runs, counting each distinct entry once per depth.
+ */
+int uniq_merge(uniq_set_t *set, uint64_t unique[UNIQ_MAX_DEPTH + 1])
+{
+    run_reader_t *readers;
+    run_reader_t **heap;
+    uint64_t *heads;
+    uint64_t last = 0;
+    size_t len = 0;
+    size_t i;
+    int result = 0;
+
+    readers = calloc(set->num_runs, sizeof(run_reader_t));
+    heap = calloc(set->num_runs, sizeof(run_reader_t *));
+    heads = calloc(set->num_runs, sizeof(uint64_t));
+    if (readers == NULL || heap == NULL || heads == NULL) {
+        perror("calloc");
+        result = -1;
+        goto out_free;
+    }
+
+    /* Heap the runs on their smallest entry. */
+    for (i = 0; i < set->num_runs; i++) {
+        readers[i].f = set->runs[i];
+        rewind(readers[i].f);
+        if (run_next(&readers[i], &heads[len]))
+            heap[len++] = &readers[i];
+    }
+    for (i = len / 2; i-- > 0;)
+        sift_down(heap, heads, len, i);
+
+    /* Pop entries in order. Equal entries come out back to back. */
+    while (len > 0) {
+        if (heads[0] != last)
+            unique[heads[0] & DEPTH_MASK]++;
+        last = heads[0];
+        if (!run_next(heap[0], &heads[0])) {
+            heap[0] = heap[--len];
+            heads[0] = heads[len];
+        }
+        sift_down(heap, heads, len, 0);
+    }
+
+    for (i = 0; i < set->num_runs; i++) {
+        if (ferror(readers[i].f)) {
+            perror("fread");
+            result = -1;
+        }
+    }
+
+out_free:
+    free(heads);
+    free(heap);
+    free(readers);
+    return result;
+}
+
+int uniq_count(cb_board_t *board, int depth, size_t mem_mb)
+{
+    uniq_set_t set;
+    cb_errno_t result;
+    cb_error_t err;
+    uint64_t unique[UNIQ_MAX_DEPTH + 1] = { 0 };
+    uint64_t start_time;
+    uint64_t end_time;
+    size_t i;
+    int ret = 0;
+
+    /* Exit early if depth is out of range. */
+    if (depth < 1 || depth > UNIQ_MAX_DEPTH) {
+        printf("Unique position depth must be between 1 and %d\n", UNIQ_MAX_DEPTH);
+        return 0;
+    }
+
+    /* Reserve the board history. This line guarantees that make will never write
+     * past its proper bounds. */
+    if ((result = cb_reserve_for_make(&err, board, depth)) != 0) {
+        fprintf(stderr, "cb_reserve_for_make: %s\n", err.desc);
+        return result;
+    }
+    if (uniq_set_init(&set, mem_mb) != 0)
+        return -1;
+
+    start_time = time_ns();
+    uniq_walk(&set, board, 1, depth);
+    if (set.failed) {
+        ret = -1;
+        goto out_free_set;
+    }
+
+    /* Count straight from the slots unless something had to be spilled. */
+    if (set.num_runs == 0) {
+        for (i = 0; i <= set.mask; i++)
+            unique[set.slots[i] & DEPTH_MASK] += set.slots[i] != 0;
+    } else if (uniq_spill(&set) != 0 || uniq_merge(&set, unique) != 0) {
+        ret = -1;
+        goto out_free_set;
+    }
+    end_time = time_ns();
+
+    printf("%5s %14s %12s %12s\n", "Depth", "Unique", "Peak RAM", "Spilled");
+    for (i = 1; i <= (size_t)depth; i++) {
+        printf("%5zu %14" PRIu64 " %10.1fKB %10.1fKB\n", i, unique[i],
+               set.peak[i] * sizeof(uint64_t) / 1024.0,
+               set.spilled[i] * sizeof(uint64_t) / 1024.0);
+    }
+    printf("\n");
+    printf("Set: %zu slots (%.1fMB), %zu runs spilled\n", set.mask + 1,
+           (set.mask + 1) * sizeof(uint64_t) / (1024.0 * 1024.0), set.num_runs);
+    printf("Time: %" PRIu64 "ms\n", (end_time - start_time) / 1000000);
+    printf("\n");
+
+out_free_set:
+    uniq_set_free(&set);
+    return ret;
+}
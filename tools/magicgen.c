@@ -0,0 +1,366 @@
+
+/*
+ * Searches for dense sliding attack magics and emits include/cblib/cb_magics.h.
+ *
+ * The magics use the "black magic" hash, where the bits outside of the relevant occupancy mask
+ * are set before multiplying:
+ *
+ *      idx = ((occ | ~mask) * magic) >> shift
+ *
+ * Three things make the tables smaller than the plain one table per square layout:
+ *
+ *  - Constructive collisions. Two occupancies may share a slot as long as they produce the same
+ *    attack set, so a magic is often found with fewer index bits than the mask has.
+ *  - Reduced bits. For every square the search first tries to drop bits from the index before
+ *    settling for the full count.
+ *  - Overlapping placement. All of the per-square tables live in one array. Each one is placed
+ *    at the lowest offset where every slot it uses is either free or already holds the same
+ *    attack set.
+ *
+ * In practice only the last one pays off. With the default budget of 1000000 tries and the
+ * default seed no square drops a bit, and the overlap takes the 107648 entries (841KB) of the
+ * plain tables down to 106925 (835KB). Half the budget leaves 107221 (837KB). Reduced-bit
+ * magics need far longer searches with -t.
+ *
+ * The header records the tries, the reduction and the seed it was made with, so running
+ * magicgen with them again gives the same header.
+ *
+ * Usage: magicgen [-o <header>] [-t <tries>] [-r <bits>] [-s <seed>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define DEFAULT_TRIES 1000000
+#define DEFAULT_REDUCE 1
+#define MAX_MASK_BITS 12
+
+/**
+ * @breif Every occupancy of one square's mask with the matching attack set.
+ */
+typedef struct {
+    uint64_t mask;                          /**< The relevant occupancy mask. */
+    int num_bits;                           /**< The number of bits in mask. */
+    uint64_t occ[1 << MAX_MASK_BITS];       /**< All subsets of mask. */
+    uint64_t atk[1 << MAX_MASK_BITS];       /**< The attack set for each subset. */
+} square_set_t;
+
+/**
+ * @breif A found magic and its placement in the shared table.
+ */
+typedef struct {
+    uint64_t magic;     /**< The multiplier. */
+    int bits;           /**< The number of index bits. */
+    int32_t offset;     /**< Added to the index to find the slot in the shared table. */
+} magic_t;
+
+uint64_t rng_state = UINT64_C(0x2545F4914F6CDD1D);
+
+static inline uint64_t rng()
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * UINT64_C(0x2545F4914F6CDD1D);
+}
+
+/* Magics with few set bits are found much faster. */
+static inline uint64_t sparse_rng()
+{
+    return rng() & rng() & rng();
+}
+
+/**
+ * Walks each direction from a square. When edges is set the walk stops before the last square,
+ * which gives the relevant occupancy mask. Otherwise it stops on the first occupied square,
+ * which gives the attack set.
+ */
+uint64_t slide(int sq, uint64_t occ, const int dirs[4][2], bool edges)
+{
+    uint64_t result = 0;
+    int rank, file, next_rank, next_file;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        rank = sq / 8;
+        file = sq % 8;
+        for (;;) {
+            next_rank = rank + dirs[i][0];
+            next_file = file + dirs[i][1];
+            if (next_rank < 0 || next_rank > 7 || next_file < 0 || next_file > 7)
+                break;
+            if (edges) {
+                if (next_rank + dirs[i][0] < 0 || next_rank + dirs[i][0] > 7
+                        || next_file + dirs[i][1] < 0 || next_file + dirs[i][1] > 7)
+                    break;
+            }
+            rank = next_rank;
+            file = next_file;
+            result |= UINT64_C(1) << (rank * 8 + file);
+            if (!edges && (occ & (UINT64_C(1) << (rank * 8 + file))))
+                break;
+        }
+    }
+
+    return result;
+}
+
+void build_square_set(square_set_t *set, int sq, const int dirs[4][2])
+{
+    uint64_t subset = 0;
+    int i = 0;
+
+    set->mask = slide(sq, 0, dirs, true);
+    set->num_bits = __builtin_popcountll(set->mask);
+
+    /* Carry-rippler enumeration of every subset of the mask. */
+    do {
+        set->occ[i] = subset;
+        set->atk[i] = slide(sq, subset, dirs, false);
+        i++;
+        subset = (subset - set->mask) & set->mask;
+    } while (subset != 0);
+}
+
+static inline uint32_t magic_index(uint64_t occ, uint64_t mask, uint64_t magic, int bits)
+{
+    return ((occ | ~mask) * magic) >> (64 - bits);
+}
+
+/**
+ * Tries random magics with the given number of index bits.
+ *
+ * Every candidate that works is scored by the span of slots that it uses. The slots outside of
+ * the span are free for the tables of other squares, so short spans let the placement overlap
+ * neighbouring tables.
+ *
+ * @return True and sets *magic to the best candidate if any was found within the tries.
+ */
+bool find_magic(uint64_t *magic, const square_set_t *set, int bits, long tries)
+{
+    static uint64_t used[1 << MAX_MASK_BITS];
+    static uint32_t epoch[1 << MAX_MASK_BITS];
+    static uint32_t cur_epoch = 0;
+    int size = 1 << set->num_bits;
+    uint32_t best_span = UINT32_MAX;
+    uint32_t lo, hi;
+    uint64_t candidate;
+    uint32_t idx;
+    long t;
+    int i;
+
+    for (t = 0; t < tries || (best_span == UINT32_MAX && bits == set->num_bits); t++) {
+        candidate = sparse_rng();
+
+        /* Stamping slots with an epoch avoids clearing the table between candidates. */
+        cur_epoch++;
+        lo = UINT32_MAX;
+        hi = 0;
+        for (i = 0; i < size; i++) {
+            idx = magic_index(set->occ[i], set->mask, candidate, bits);
+            if (epoch[idx] != cur_epoch) {
+                epoch[idx] = cur_epoch;
+                used[idx] = set->atk[i];
+                lo = idx < lo ? idx : lo;
+                hi = idx > hi ? idx : hi;
+            } else if (used[idx] != set->atk[i]) {
+                break;
+            }
+        }
+        if (i == size && hi - lo < best_span) {
+            best_span = hi - lo;
+            *magic = candidate;
+        }
+    }
+
+    return best_span != UINT32_MAX;
+}
+
+/**
+ * Places a square's table at the lowest offset where it agrees with what is already there.
+ * @return The offset, with the shared table updated.
+ */
+int32_t place(uint64_t *table, uint32_t *len, const square_set_t *set, const magic_t *m)
+{
+    static uint64_t local[1 << MAX_MASK_BITS];
+    static uint32_t slots[1 << MAX_MASK_BITS];
+    static uint64_t values[1 << MAX_MASK_BITS];
+    int size = 1 << set->num_bits;
+    int num_slots = 0;
+    uint32_t lo = UINT32_MAX;
+    uint32_t off, idx;
+    int i;
+
+    /* Collapse the subsets onto the slots that the square actually uses. */
+    memset(local, 0, sizeof(uint64_t) << m->bits);
+    for (i = 0; i < size; i++) {
+        idx = magic_index(set->occ[i], set->mask, m->magic, m->bits);
+        if (local[idx] == 0)
+            slots[num_slots++] = idx;
+        local[idx] = set->atk[i];
+        lo = idx < lo ? idx : lo;
+    }
+
+    /* Slide the used slots down so that the lowest one can land on the start of the table. */
+    for (i = 0; i < num_slots; i++) {
+        values[i] = local[slots[i]];
+        slots[i] -= lo;
+    }
+
+    /* An attack set is never empty, so zero marks a free slot. */
+    for (off = 0;; off++) {
+        for (i = 0; i < num_slots; i++) {
+            idx = off + slots[i];
+            if (idx < *len && table[idx] != 0 && table[idx] != values[i])
+                break;
+        }
+        if (i == num_slots)
+            break;
+    }
+
+    for (i = 0; i < num_slots; i++) {
+        idx = off + slots[i];
+        table[idx] = values[i];
+        if (idx + 1 > *len)
+            *len = idx + 1;
+    }
+
+    return (int32_t)off - (int32_t)lo;
+}
+
+void emit_array(FILE *f, const char *type, const char *name, const magic_t magics[64], int field)
+{
+    int sq;
+
+    fprintf(f, "static const %s %s[64] = {\n", type, name);
+    for (sq = 0; sq < 64; sq++) {
+        fprintf(f, "    ");
+        if (field == 0)
+            fprintf(f, "UINT64_C(0x%016" PRIx64 ")", magics[sq].magic);
+        else if (field == 1)
+            fprintf(f, "%d", 64 - magics[sq].bits);
+        else
+            fprintf(f, "%" PRId32, magics[sq].offset);
+        fprintf(f, "%s\n", sq == 63 ? "" : ",");
+    }
+    fprintf(f, "};\n\n");
+}
+
+void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-o <header>] [-t <tries>] [-r <bits>] [-s <seed>]\n"
+            "  -o    Header to write (default: stdout).\n"
+            "  -t    Random candidates per square and bit count (default %d).\n"
+            "  -r    Most index bits to try to drop per square (default %d).\n"
+            "  -s    Seed for the candidate generator.\n", prog, DEFAULT_TRIES, DEFAULT_REDUCE);
+}
+
+int main(int argc, char *argv[])
+{
+    const int ROOK_DIRS[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+    const int BISHOP_DIRS[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+    static square_set_t sets[2][64];
+    magic_t magics[2][64];
+    uint64_t *table;
+    uint32_t len = 0;
+    uint64_t plain_entries = 0;
+    const char *out_path = NULL;
+    long tries = DEFAULT_TRIES;
+    int reduce = DEFAULT_REDUCE;
+    int saved_bits[2] = { 0, 0 };
+    int order[128];
+    uint64_t seed;
+    FILE *out = stdout;
+    int piece, sq, bits, i, j, tmp;
+
+    /* Parse the arguments. */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tries = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            reduce = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng_state = strtoull(argv[++i], NULL, 0) | 1;
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    seed = rng_state;
+
+    /* Find a magic for every square, trying the fewest bits first. Index 0 holds the rooks. */
+    for (piece = 0; piece < 2; piece++) {
+        for (sq = 0; sq < 64; sq++) {
+            build_square_set(&sets[piece][sq], sq, piece == 0 ? ROOK_DIRS : BISHOP_DIRS);
+            plain_entries += 1 << sets[piece][sq].num_bits;
+            for (bits = sets[piece][sq].num_bits - reduce; bits <= sets[piece][sq].num_bits;
+                    bits++) {
+                if (bits < 1)
+                    continue;
+                /* The full bit count keeps going until something is found. */
+                if (find_magic(&magics[piece][sq].magic, &sets[piece][sq], bits, tries)
+                        || bits == sets[piece][sq].num_bits)
+                    break;
+            }
+            magics[piece][sq].bits = bits;
+            saved_bits[piece] += sets[piece][sq].num_bits - bits;
+        }
+    }
+    fprintf(stderr, "\n");
+
+    /* Place the biggest tables first so the small ones can fill in the gaps. */
+    if ((table = calloc(plain_entries, sizeof(uint64_t))) == NULL) {
+        perror("calloc");
+        return 2;
+    }
+    for (i = 0; i < 128; i++)
+        order[i] = i;
+    for (i = 1; i < 128; i++) {
+        for (j = i; j > 0 && magics[order[j - 1] / 64][order[j - 1] % 64].bits
+                < magics[order[j] / 64][order[j] % 64].bits; j--) {
+            tmp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+        }
+    }
+    for (i = 0; i < 128; i++) {
+        piece = order[i] / 64;
+        sq = order[i] % 64;
+        magics[piece][sq].offset = place(table, &len, &sets[piece][sq], &magics[piece][sq]);
+    }
+
+    fprintf(stderr, "Bits saved: rook %d, bishop %d\n", saved_bits[0], saved_bits[1]);
+    fprintf(stderr, "Plain tables: %" PRIu64 " entries, %" PRIu64 "KB\n", plain_entries,
+            plain_entries * 8 / 1024);
+    fprintf(stderr, "Shared table: %" PRIu32 " entries, %" PRIu32 "KB\n", len, len * 8 / 1024);
+
+    /* Write the header. */
+    if (out_path != NULL && (out = fopen(out_path, "w")) == NULL) {
+        perror(out_path);
+        return 2;
+    }
+    fprintf(out, "\n/* Generated by tools/magicgen -t %ld -r %d -s 0x%016" PRIx64 ". "
+            "Do not edit. */\n\n", tries, reduce, seed);
+    fprintf(out, "#ifndef CB_MAGICS_H\n#define CB_MAGICS_H\n\n#include <stdint.h>\n\n");
+    fprintf(out, "/* Number of entries in the table shared by every square of both pieces. */\n");
+    fprintf(out, "#define CB_MAGIC_TABLE_LEN %" PRIu32 "\n\n", len);
+    emit_array(out, "uint64_t", "ROOK_MAGICS", magics[0], 0);
+    emit_array(out, "uint8_t", "ROOK_SHIFTS", magics[0], 1);
+    emit_array(out, "int32_t", "ROOK_OFFSETS", magics[0], 2);
+    emit_array(out, "uint64_t", "BISHOP_MAGICS", magics[1], 0);
+    emit_array(out, "uint8_t", "BISHOP_SHIFTS", magics[1], 1);
+    emit_array(out, "int32_t", "BISHOP_OFFSETS", magics[1], 2);
+    fprintf(out, "#endif /* CB_MAGICS_H */\n");
+
+    if (out != stdout)
+        fclose(out);
+    free(table);
+    return 0;
+}